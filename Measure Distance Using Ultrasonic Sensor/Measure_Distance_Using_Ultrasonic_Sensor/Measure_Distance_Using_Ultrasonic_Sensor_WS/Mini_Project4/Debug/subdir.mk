@@ -4,24 +4,39 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../board_config.c \
 ../gpio.c \
 ../icu.c \
 ../lcd.c \
 ../mini_project4.c \
+../perf.c \
+../trace.c \
+../uart.c \
+../twi.c \
 ../ultrasonic.c 
 
 OBJS += \
+./board_config.o \
 ./gpio.o \
 ./icu.o \
 ./lcd.o \
 ./mini_project4.o \
+./perf.o \
+./trace.o \
+./uart.o \
+./twi.o \
 ./ultrasonic.o 
 
 C_DEPS += \
+./board_config.d \
 ./gpio.d \
 ./icu.d \
 ./lcd.d \
 ./mini_project4.d \
+./perf.d \
+./trace.d \
+./uart.d \
+./twi.d \
 ./ultrasonic.d 
 
 
@@ -29,7 +44,7 @@ C_DEPS += \
 %.o: ../%.c subdir.mk
 	@echo 'Building file: $<'
 	@echo 'Invoking: AVR Compiler'
-	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=1000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
+	avr-gcc -Wall -g2 -gstabs -O0 -fpack-struct -fshort-enums -ffunction-sections -fdata-sections -std=gnu99 -funsigned-char -funsigned-bitfields -mmcu=atmega16 -DF_CPU=8000000UL -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -c -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
@@ -0,0 +1,77 @@
+/****************************************************************************************
+ *
+ * Module: Benchmark
+ *
+ * File Name: bench_main.c
+ *
+ * Discretion: Entry of the ATmega16 benchmark image, calls the measured functions then runs the application
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include <avr/io.h>
+#include "ultrasonic.h"
+#include "lcd.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/* Calls of every measured driver function before the application starts */
+#define BENCH_CALLS					16
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static const Ultrasonic_SensorConfigType g_benchSensors[ULTRASONIC_SENSOR_COUNT] = {
+	BOARD_ULTRASONIC_SENSORS(ULTRASONIC_SENSOR_CONFIG)
+};
+
+/* Values of the LCD_intgerToString calls, one to five digits and a negative number */
+static const int g_benchNumbers[] = {0, 7, 42, 399, 4000, 32767, -123};
+
+/* The application of mini_project4.c, built with main renamed */
+int app_main(void);
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description:
+ * The simulator measures the functions by their addresses in the image, so the calls here are what
+ * it sees for Ultrasonic_readDistance, LCD_displayCharacter and LCD_intgerToString.
+ * The application runs after them and gives the interrupt and the sample to display latencies.
+ */
+int main(void)
+{
+	uint8 i;
+
+	SREG |= (1<<7); /* Activate interrupt */
+
+	LCD_init();
+	Ultrasonic_init(g_benchSensors);
+
+	for(i = 0; i < BENCH_CALLS; i++)
+	{
+		(void)Ultrasonic_readDistance(i % ULTRASONIC_SENSOR_COUNT);
+	}
+
+	LCD_clearScreen();
+	for(i = 0; i < BENCH_CALLS; i++)
+	{
+		LCD_moveCursor(0,0);
+		LCD_intgerToString(g_benchNumbers[i % (sizeof(g_benchNumbers) / sizeof(g_benchNumbers[0]))]);
+	}
+
+	LCD_clearScreen();
+	for(i = 0; i < BENCH_CALLS; i++)
+	{
+		LCD_displayCharacter('0' + (i % 10));
+	}
+
+	LCD_clearScreen();
+	return app_main();
+}
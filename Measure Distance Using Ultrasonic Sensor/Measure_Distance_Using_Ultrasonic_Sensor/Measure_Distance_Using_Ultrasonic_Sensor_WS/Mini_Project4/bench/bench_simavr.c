@@ -0,0 +1,616 @@
+/****************************************************************************************
+ *
+ * Module: Benchmark
+ *
+ * File Name: bench_simavr.c
+ *
+ * Discretion: Runs the ATmega16 benchmark image in simavr with a scripted HC-SR04 echo and
+ *             reports the cycles of the functions, the latencies and the memory of the image
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+#define BENCH_MCU					"atmega16"
+#define BENCH_F_CPU					8000000UL
+#define BENCH_FLASH_SIZE			0x4000 /* Bytes of the ATmega16 flash */
+#define BENCH_RAMEND				0x045F
+
+#define BENCH_MAX_FUNCTIONS			32
+#define BENCH_MAX_DEPTH				32
+#define BENCH_MAX_SCRIPT			256
+#define BENCH_NAME_SIZE				64
+
+/* HC-SR04 timing, the same as the host model of host/sim_hcsr04.c */
+#define BENCH_TRIGGER_MIN_US		10
+#define BENCH_BURST_US				460
+#define BENCH_NO_ECHO_US			38000
+#define BENCH_SOUND_SPEED			343000UL /* mm per second */
+#define BENCH_NO_TARGET				0xFFFF
+
+#define BENCH_US_TO_CYCLES(us)		((avr_cycle_count_t)(us) * (BENCH_F_CPU / 1000000UL))
+#define BENCH_ECHO_CYCLES(mm)		(((avr_cycle_count_t)(mm) * 2UL * BENCH_F_CPU) / BENCH_SOUND_SPEED)
+
+/* A cost is a regression when it grows more than this percentage over the baseline */
+#define BENCH_DEFAULT_TOLERANCE		5
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+typedef struct{
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+}Bench_StatsType;
+
+typedef struct{
+	char name[BENCH_NAME_SIZE];
+	uint32_t address;       /* Byte address of the first instruction, 0 when the symbol is not in the image */
+	int isr;                /* Interrupt vector, its cycles are not counted in the functions it interrupts */
+	Bench_StatsType cycles;
+}Bench_FunctionType;
+
+typedef struct{
+	int function;
+	uint16_t sp;            /* SP after the call pushed the return address */
+	avr_cycle_count_t start;
+	avr_cycle_count_t isrCycles; /* Interrupt cycles counted when the function was entered */
+}Bench_FrameType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static avr_t * g_avr = NULL;
+
+static Bench_FunctionType g_functions[BENCH_MAX_FUNCTIONS];
+static int g_functionCount = 0;
+static uint8_t g_functionAt[BENCH_FLASH_SIZE]; /* Index + 1 of the function that starts at a byte address */
+
+static Bench_FrameType g_frames[BENCH_MAX_DEPTH];
+static int g_depth = 0;
+static avr_cycle_count_t g_isrCycles = 0;
+
+/* Echo script: distance in mm of every ping, BENCH_NO_TARGET for no echo */
+static uint16_t g_script[BENCH_MAX_SCRIPT];
+static int g_scriptLength = 0;
+static uint32_t g_pings = 0;
+
+static avr_irq_t * g_echoIrq = NULL;
+static avr_cycle_count_t g_triggerRise = 0;
+static int g_sensorBusy = 0;
+static uint16_t g_pingDistance = BENCH_NO_TARGET;
+
+/* ICP1 edge to the first instruction of the capture ISR */
+static int g_captureIsr = -1;
+static avr_cycle_count_t g_edgeCycle = 0;
+static int g_edgePending = 0;
+static Bench_StatsType g_isrLatency;
+
+/* End of an echo to the return of the display function that started after it, in the application only */
+static int g_appFunction = -1;
+static int g_displayFunction = -1;
+static int g_appStarted = 0;
+static avr_cycle_count_t g_sampleCycle = 0;
+static int g_samplePending = 0;
+static Bench_StatsType g_sampleToDisplay;
+
+static uint16_t g_minSp = BENCH_RAMEND;
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+static void Bench_addSample(Bench_StatsType * Stats_Ptr, uint64_t value)
+{
+	if((Stats_Ptr->count == 0) || (value < Stats_Ptr->min))
+	{
+		Stats_Ptr->min = value;
+	}
+	if(value > Stats_Ptr->max)
+	{
+		Stats_Ptr->max = value;
+	}
+	Stats_Ptr->sum += value;
+	Stats_Ptr->count++;
+}
+
+static uint64_t Bench_mean(const Bench_StatsType * Stats_Ptr)
+{
+	return (Stats_Ptr->count != 0) ? (Stats_Ptr->sum / Stats_Ptr->count) : 0;
+}
+
+static uint16_t Bench_getSp(void)
+{
+	return (uint16_t)(g_avr->data[R_SPL] | (g_avr->data[R_SPH] << 8));
+}
+
+/*
+ * Description: Read the echo script, one distance in mm per line or "-" for a ping without a target.
+ */
+static int Bench_readScript(const char * path)
+{
+	char line[BENCH_NAME_SIZE];
+	FILE * file = fopen(path, "r");
+
+	if(file == NULL)
+	{
+		perror(path);
+		return -1;
+	}
+
+	while((fgets(line, sizeof(line), file) != NULL) && (g_scriptLength < BENCH_MAX_SCRIPT))
+	{
+		if((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r'))
+		{
+			continue;
+		}
+		g_script[g_scriptLength++] = (line[0] == '-') ? BENCH_NO_TARGET : (uint16_t)strtoul(line, NULL, 10);
+	}
+	fclose(file);
+
+	if(g_scriptLength == 0)
+	{
+		fprintf(stderr, "%s: no distances\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Description: Find the measured functions in the "address type name" lines of avr-nm.
+ */
+static int Bench_readSymbols(const char * path)
+{
+	char line[256];
+	char name[BENCH_NAME_SIZE];
+	char type;
+	unsigned long address;
+	FILE * file = fopen(path, "r");
+	int i;
+
+	if(file == NULL)
+	{
+		perror(path);
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		if((sscanf(line, "%lx %c %63s", &address, &type, name) != 3) || ((type != 'T') && (type != 't')))
+		{
+			continue;
+		}
+		for(i = 0; i < g_functionCount; i++)
+		{
+			if((strcmp(name, g_functions[i].name) == 0) && (address < BENCH_FLASH_SIZE))
+			{
+				g_functions[i].address = (uint32_t)address;
+				g_functionAt[address] = (uint8_t)(i + 1);
+			}
+		}
+	}
+	fclose(file);
+	return 0;
+}
+
+static int Bench_findFunction(const char * name)
+{
+	int i;
+
+	for(i = 0; i < g_functionCount; i++)
+	{
+		if(strcmp(g_functions[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int Bench_addFunction(const char * name)
+{
+	int index = Bench_findFunction(name);
+
+	if(index >= 0)
+	{
+		return index;
+	}
+	if(g_functionCount == BENCH_MAX_FUNCTIONS)
+	{
+		fprintf(stderr, "too many functions\n");
+		exit(EXIT_FAILURE);
+	}
+
+	index = g_functionCount++;
+	snprintf(g_functions[index].name, BENCH_NAME_SIZE, "%s", name);
+	g_functions[index].isr = (strncmp(name, "__vector_", 9) == 0);
+	return index;
+}
+
+/*******************************************************************************
+ *                      	HC-SR04 Echo Script                                *
+ *******************************************************************************/
+static void Bench_driveEcho(uint32_t level)
+{
+	if(g_edgePending == 0)
+	{
+		g_edgeCycle = g_avr->cycle;
+		g_edgePending = 1;
+	}
+	avr_raise_irq(g_echoIrq, level);
+}
+
+static avr_cycle_count_t Bench_echoEnd(avr_t * avr, avr_cycle_count_t when, void * param)
+{
+	(void)avr; (void)when; (void)param;
+
+	Bench_driveEcho(0);
+	g_sensorBusy = 0;
+	if((g_appStarted != 0) && (g_samplePending == 0))
+	{
+		g_sampleCycle = g_avr->cycle;
+		g_samplePending = 1;
+	}
+	return 0;
+}
+
+static avr_cycle_count_t Bench_echoStart(avr_t * avr, avr_cycle_count_t when, void * param)
+{
+	avr_cycle_count_t width;
+	(void)when; (void)param;
+
+	width = (g_pingDistance == BENCH_NO_TARGET) ? BENCH_US_TO_CYCLES(BENCH_NO_ECHO_US) : BENCH_ECHO_CYCLES(g_pingDistance);
+	Bench_driveEcho(1);
+	avr_cycle_timer_register(avr, width, Bench_echoEnd, NULL);
+	return 0;
+}
+
+/*
+ * Description: Trigger pin of the sensor, a pulse of at least 10 us sends a ping of the next scripted distance.
+ */
+static void Bench_triggerChanged(struct avr_irq_t * irq, uint32_t value, void * param)
+{
+	(void)irq; (void)param;
+
+	if(value != 0)
+	{
+		g_triggerRise = g_avr->cycle;
+	}
+	else if((g_sensorBusy == 0) && ((g_avr->cycle - g_triggerRise) >= BENCH_US_TO_CYCLES(BENCH_TRIGGER_MIN_US)))
+	{
+		g_pingDistance = g_script[g_pings % g_scriptLength];
+		g_pings++;
+		g_sensorBusy = 1;
+		avr_cycle_timer_register(g_avr, BENCH_US_TO_CYCLES(BENCH_BURST_US), Bench_echoStart, NULL);
+	}
+}
+
+/*******************************************************************************
+ *                      	Function Tracing                                   *
+ *******************************************************************************/
+/*
+ * Description: Called before every instruction.
+ * A function returns when SP is above the SP it was entered with, an interrupt inside it only goes below.
+ */
+static void Bench_trace(void)
+{
+	uint16_t sp = Bench_getSp();
+	uint32_t pc = g_avr->pc;
+	Bench_FrameType * frame;
+	Bench_FunctionType * function;
+	avr_cycle_count_t cycles;
+	int index;
+
+	if(sp < g_minSp)
+	{
+		g_minSp = sp;
+	}
+
+	while((g_depth > 0) && (sp > g_frames[g_depth - 1].sp))
+	{
+		frame = &g_frames[--g_depth];
+		function = &g_functions[frame->function];
+		cycles = g_avr->cycle - frame->start;
+		if(function->isr)
+		{
+			g_isrCycles += cycles;
+		}
+		else
+		{
+			cycles -= (g_isrCycles - frame->isrCycles);
+		}
+		Bench_addSample(&function->cycles, cycles);
+
+		if((frame->function == g_displayFunction) && (g_samplePending != 0) && (frame->start > g_sampleCycle))
+		{
+			Bench_addSample(&g_sampleToDisplay, g_avr->cycle - g_sampleCycle);
+			g_samplePending = 0;
+		}
+	}
+
+	if((pc >= BENCH_FLASH_SIZE) || (g_functionAt[pc] == 0))
+	{
+		return;
+	}
+
+	index = g_functionAt[pc] - 1;
+	if((index == g_captureIsr) && (g_edgePending != 0))
+	{
+		Bench_addSample(&g_isrLatency, g_avr->cycle - g_edgeCycle);
+		g_edgePending = 0;
+	}
+	if(index == g_appFunction)
+	{
+		g_appStarted = 1;
+		g_samplePending = 0;
+	}
+
+	if(g_depth < BENCH_MAX_DEPTH)
+	{
+		frame = &g_frames[g_depth++];
+		frame->function = index;
+		frame->sp = sp;
+		frame->start = g_avr->cycle;
+		frame->isrCycles = g_isrCycles;
+	}
+}
+
+/*******************************************************************************
+ *                      	Report and Baseline                                *
+ *******************************************************************************/
+static void Bench_printStats(const char * name, const Bench_StatsType * Stats_Ptr)
+{
+	if(Stats_Ptr->count == 0)
+	{
+		printf("  %-32s %8s\n", name, "-");
+		return;
+	}
+	printf("  %-32s %8llu %10llu %10llu %10llu\n", name, (unsigned long long)Stats_Ptr->count,
+			(unsigned long long)Stats_Ptr->min, (unsigned long long)Stats_Ptr->max,
+			(unsigned long long)Bench_mean(Stats_Ptr));
+}
+
+static void Bench_writeStats(FILE * file, const char * name, const Bench_StatsType * Stats_Ptr)
+{
+	if(Stats_Ptr->count != 0)
+	{
+		fprintf(file, "%s.min %llu\n%s.max %llu\n%s.mean %llu\n", name, (unsigned long long)Stats_Ptr->min,
+				name, (unsigned long long)Stats_Ptr->max, name, (unsigned long long)Bench_mean(Stats_Ptr));
+	}
+}
+
+static void Bench_writeResults(FILE * file, unsigned long flash, unsigned long sram, unsigned long stack)
+{
+	int i;
+
+	fprintf(file, "flash %lu\nsram %lu\nstack %lu\n", flash, sram, stack);
+	for(i = 0; i < g_functionCount; i++)
+	{
+		Bench_writeStats(file, g_functions[i].name, &g_functions[i].cycles);
+	}
+	Bench_writeStats(file, "isr_latency", &g_isrLatency);
+	Bench_writeStats(file, "sample_to_display", &g_sampleToDisplay);
+}
+
+/*
+ * Description: Compare the results written to current with the baseline, return the number of regressions.
+ * A key that is not in the baseline or is zero there is not compared.
+ */
+static int Bench_compare(const char * baseline, const char * current, unsigned tolerance)
+{
+	char key[BENCH_NAME_SIZE + 8];
+	char baseKey[BENCH_NAME_SIZE + 8];
+	unsigned long long value;
+	unsigned long long baseValue;
+	FILE * currentFile = fopen(current, "r");
+	FILE * baseFile;
+	int regressions = 0;
+
+	if(currentFile == NULL)
+	{
+		perror(current);
+		return 1;
+	}
+
+	while(fscanf(currentFile, "%71s %llu", key, &value) == 2)
+	{
+		baseFile = fopen(baseline, "r");
+		if(baseFile == NULL)
+		{
+			perror(baseline);
+			fclose(currentFile);
+			return 1;
+		}
+		while(fscanf(baseFile, "%71s %llu", baseKey, &baseValue) == 2)
+		{
+			if((strcmp(key, baseKey) == 0) && (baseValue != 0) && ((value * 100) > (baseValue * (100 + tolerance))))
+			{
+				printf("  REGRESSION %-32s %llu -> %llu\n", key, baseValue, value);
+				regressions++;
+			}
+		}
+		fclose(baseFile);
+	}
+	fclose(currentFile);
+	return regressions;
+}
+
+static void Bench_usage(const char * program)
+{
+	fprintf(stderr,
+			"usage: %s -e image.elf -s symbols.txt -x echo.txt [options] function...\n"
+			"  -t PIN      trigger pin watched for pings (default B5, D5 for the OC1A trigger)\n"
+			"  -p PIN      echo pin (default D6, ICP1)\n"
+			"  -c MS       simulated milliseconds to run (default 3000)\n"
+			"  -i NAME     capture ISR for the interrupt latency (default __vector_5, TIMER1_CAPT_vect)\n"
+			"  -a NAME     application entry, the sample to display latency is measured after it (default app_main)\n"
+			"  -d NAME     function that puts a sample on the display (default LCD_flush)\n"
+			"  -w FILE     write the results as \"key value\" lines\n"
+			"  -b FILE     compare with a baseline written by -w, exit 2 on a regression\n"
+			"  -T PERCENT  regression tolerance (default %d)\n"
+			"  -l LABEL    label of the report, e.g. the optimisation level\n"
+			"  -F BYTES    flash of the image (.text and .data, from avr-size)\n"
+			"  -R BYTES    static SRAM of the image (.data, .bss and .noinit, from avr-size)\n",
+			program, BENCH_DEFAULT_TOLERANCE);
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+int main(int argc, char * argv[])
+{
+	const char * elfPath = NULL;
+	const char * symbolPath = NULL;
+	const char * scriptPath = NULL;
+	const char * writePath = NULL;
+	const char * baselinePath = NULL;
+	const char * label = "";
+	const char * triggerPin = "B5";
+	const char * echoPin = "D6";
+	const char * captureIsr = "__vector_5";
+	const char * appEntry = "app_main";
+	const char * displayFunction = "LCD_flush";
+	unsigned long runMs = 3000;
+	unsigned tolerance = BENCH_DEFAULT_TOLERANCE;
+	unsigned long flash = 0;
+	unsigned long sram = 0;
+	unsigned long stack;
+	elf_firmware_t firmware;
+	avr_cycle_count_t endCycle;
+	FILE * file;
+	int state;
+	int i;
+
+	for(i = 1; i < argc; i++)
+	{
+		if((argv[i][0] == '-') && (argv[i][1] != '\0') && (argv[i][2] == '\0') && ((i + 1) < argc))
+		{
+			switch(argv[i][1])
+			{
+			case 'e': elfPath = argv[++i]; break;
+			case 's': symbolPath = argv[++i]; break;
+			case 'x': scriptPath = argv[++i]; break;
+			case 't': triggerPin = argv[++i]; break;
+			case 'p': echoPin = argv[++i]; break;
+			case 'c': runMs = strtoul(argv[++i], NULL, 10); break;
+			case 'i': captureIsr = argv[++i]; break;
+			case 'a': appEntry = argv[++i]; break;
+			case 'd': displayFunction = argv[++i]; break;
+			case 'w': writePath = argv[++i]; break;
+			case 'b': baselinePath = argv[++i]; break;
+			case 'T': tolerance = (unsigned)strtoul(argv[++i], NULL, 10); break;
+			case 'l': label = argv[++i]; break;
+			case 'F': flash = strtoul(argv[++i], NULL, 10); break;
+			case 'R': sram = strtoul(argv[++i], NULL, 10); break;
+			default: Bench_usage(argv[0]); return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			(void)Bench_addFunction(argv[i]);
+		}
+	}
+
+	if((elfPath == NULL) || (symbolPath == NULL) || (scriptPath == NULL) ||
+			(strlen(triggerPin) != 2) || (strlen(echoPin) != 2))
+	{
+		Bench_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	g_captureIsr = Bench_addFunction(captureIsr);
+	g_appFunction = Bench_addFunction(appEntry);
+	g_displayFunction = Bench_addFunction(displayFunction);
+	if((Bench_readScript(scriptPath) != 0) || (Bench_readSymbols(symbolPath) != 0))
+	{
+		return EXIT_FAILURE;
+	}
+
+	memset(&firmware, 0, sizeof(firmware));
+	if(elf_read_firmware(elfPath, &firmware) != 0)
+	{
+		fprintf(stderr, "%s: cannot read the image\n", elfPath);
+		return EXIT_FAILURE;
+	}
+	strcpy(firmware.mmcu, BENCH_MCU);
+	firmware.frequency = BENCH_F_CPU;
+
+	g_avr = avr_make_mcu_by_name(firmware.mmcu);
+	if(g_avr == NULL)
+	{
+		fprintf(stderr, "simavr has no %s\n", BENCH_MCU);
+		return EXIT_FAILURE;
+	}
+	avr_init(g_avr);
+	avr_load_firmware(g_avr, &firmware);
+
+	/* The echo drives the pin, the ICP1 input of Timer1 follows the port pin in simavr */
+	g_echoIrq = avr_io_getirq(g_avr, AVR_IOCTL_IOPORT_GETIRQ(echoPin[0]), echoPin[1] - '0');
+	avr_irq_register_notify(avr_io_getirq(g_avr, AVR_IOCTL_IOPORT_GETIRQ(triggerPin[0]), triggerPin[1] - '0'),
+			Bench_triggerChanged, NULL);
+	avr_raise_irq(g_echoIrq, 0);
+	g_edgePending = 0;
+
+	endCycle = (avr_cycle_count_t)runMs * (BENCH_F_CPU / 1000UL);
+	do
+	{
+		Bench_trace();
+		state = avr_run(g_avr);
+	}while((state != cpu_Done) && (state != cpu_Crashed) && (g_avr->cycle < endCycle));
+
+	stack = BENCH_RAMEND - g_minSp;
+
+	printf("== %s %s: %.0f ms simulated, %lu pings%s\n", label, elfPath, (double)g_avr->cycle * 1000.0 / BENCH_F_CPU,
+			(unsigned long)g_pings, (state == cpu_Crashed) ? ", CRASHED" : "");
+	printf("  flash %lu bytes, sram %lu bytes static + %lu bytes stack peak\n", flash, sram, stack);
+	printf("  %-32s %8s %10s %10s %10s\n", "cycles (interrupts excluded)", "calls", "min", "max", "mean");
+	for(i = 0; i < g_functionCount; i++)
+	{
+		if(g_functions[i].address == 0)
+		{
+			printf("  %-32s %8s\n", g_functions[i].name, "inlined or not in the image");
+		}
+		else if(i != g_appFunction)
+		{
+			Bench_printStats(g_functions[i].name, &g_functions[i].cycles);
+		}
+	}
+	printf("  %-32s %8s %10s %10s %10s\n", "latency (cycles)", "samples", "min", "max", "mean");
+	Bench_printStats("ICP1 edge to capture ISR", &g_isrLatency);
+	Bench_printStats("echo end to display", &g_sampleToDisplay);
+
+	if(writePath != NULL)
+	{
+		file = fopen(writePath, "w");
+		if(file == NULL)
+		{
+			perror(writePath);
+			return EXIT_FAILURE;
+		}
+		Bench_writeResults(file, flash, sram, stack);
+		fclose(file);
+
+		if((baselinePath != NULL) && (Bench_compare(baselinePath, writePath, tolerance) != 0))
+		{
+			return 2;
+		}
+	}
+
+	return (state == cpu_Crashed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/****************************************************************************************
+ *
+ * Module: Board Configuration
+ *
+ * File Name: board_config.c
+ *
+ * Discretion: Build time check of the pins and timers used by the drivers
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "board_config.h"
+#include "lcd.h"
+#include "ultrasonic.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/*
+ * Every pin and timer the drivers use in the current configuration is one CLAIM(group, mask) of BOARD_CLAIMS,
+ * the group is a port ID or BOARD_TIMERS_GROUP. For every group the preprocessor adds the masks of the claims
+ * and ORs them, the sum is bigger than the OR only if two claims share a bit, then the build fails.
+ * Nothing of this file is compiled into the program.
+ */
+#define BOARD_TIMERS_GROUP					NUM_OF_PORTS
+
+#define BOARD_PIN(CLAIM, signal)			BOARD_PIN_CLAIM(CLAIM, signal)
+#define BOARD_PIN_CLAIM(CLAIM, port_num, pin_num)	CLAIM(port_num, (1 << (pin_num)))
+#define BOARD_TIMER(CLAIM, timer)			CLAIM(BOARD_TIMERS_GROUP, (1 << (timer)))
+
+/* LCD */
+#if (LCD_BACKEND == LCD_BACKEND_PARALLEL)
+#if (LCD_BACKGROUND_WRITE == TRUE)
+#define BOARD_LCD_QUEUE_CLAIMS(CLAIM)		BOARD_TIMER(CLAIM, BOARD_LCD_QUEUE_TIMER)
+#else
+#define BOARD_LCD_QUEUE_CLAIMS(CLAIM)
+#endif
+#define BOARD_LCD_CLAIMS(CLAIM) \
+	BOARD_PIN(CLAIM, BOARD_LCD_RS) \
+	BOARD_PIN(CLAIM, BOARD_LCD_RW) \
+	BOARD_PIN(CLAIM, BOARD_LCD_E) \
+	CLAIM(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK) \
+	BOARD_LCD_QUEUE_CLAIMS(CLAIM)
+#else
+#define BOARD_LCD_CLAIMS(CLAIM) \
+	BOARD_PIN(CLAIM, BOARD_TWI_SCL) \
+	BOARD_PIN(CLAIM, BOARD_TWI_SDA)
+#endif
+
+/* Ultrasonic sensors and the ICU */
+#define BOARD_SUM_TRIGGER(trigger_port, trigger_pin, echo_select, priority)	BOARD_SUM(trigger_port, (1 << (trigger_pin)))
+#define BOARD_OR_TRIGGER(trigger_port, trigger_pin, echo_select, priority)	BOARD_OR(trigger_port, (1 << (trigger_pin)))
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+#define BOARD_TRIGGER_CLAIMS(CLAIM)			BOARD_PIN(CLAIM, BOARD_ICU_OC1A)
+#else
+#define BOARD_TRIGGER_CLAIMS(CLAIM)			BOARD_ULTRASONIC_SENSORS(CLAIM##_TRIGGER) /* Every sensor has its own trigger */
+#endif
+#define BOARD_ULTRASONIC_CLAIMS(CLAIM) \
+	BOARD_PIN(CLAIM, BOARD_ICU_ICP1) \
+	BOARD_TIMER(CLAIM, BOARD_ICU_TIMER) \
+	CLAIM(ULTRASONIC_MUX_PORT_ID, (((1 << ULTRASONIC_MUX_SELECT_BITS) - 1) << ULTRASONIC_MUX_FIRST_PIN_ID)) \
+	BOARD_TRIGGER_CLAIMS(CLAIM)
+
+/* Telemetry of the ultrasonic driver */
+#if (ULTRASONIC_TELEMETRY == TRUE)
+#define BOARD_UART_CLAIMS(CLAIM)			BOARD_PIN(CLAIM, BOARD_UART_TXD)
+#else
+#define BOARD_UART_CLAIMS(CLAIM)
+#endif
+
+/* All the claims of the board */
+#define BOARD_CLAIMS(CLAIM) \
+	BOARD_LCD_CLAIMS(CLAIM) \
+	BOARD_ULTRASONIC_CLAIMS(CLAIM) \
+	BOARD_UART_CLAIMS(CLAIM)
+
+/* Sum and OR of the masks of the claims of BOARD_CHECKED_GROUP */
+#define BOARD_SUM(group, mask)				+ (((group) == BOARD_CHECKED_GROUP) ? (mask) : 0)
+#define BOARD_OR(group, mask)				| (((group) == BOARD_CHECKED_GROUP) ? (mask) : 0)
+#define BOARD_CONFLICT						((0 BOARD_CLAIMS(BOARD_SUM)) != (0 BOARD_CLAIMS(BOARD_OR)))
+
+/*******************************************************************************
+ *                      		Build Time Checks                              *
+ *******************************************************************************/
+#define BOARD_CHECKED_GROUP		PORTA_ID
+#if BOARD_CONFLICT
+#error "Two drivers use the same pin of PORTA, check board_config.h"
+#endif
+#undef BOARD_CHECKED_GROUP
+
+#define BOARD_CHECKED_GROUP		PORTB_ID
+#if BOARD_CONFLICT
+#error "Two drivers use the same pin of PORTB, check board_config.h"
+#endif
+#undef BOARD_CHECKED_GROUP
+
+#define BOARD_CHECKED_GROUP		PORTC_ID
+#if BOARD_CONFLICT
+#error "Two drivers use the same pin of PORTC, check board_config.h"
+#endif
+#undef BOARD_CHECKED_GROUP
+
+#define BOARD_CHECKED_GROUP		PORTD_ID
+#if BOARD_CONFLICT
+#error "Two drivers use the same pin of PORTD, check board_config.h"
+#endif
+#undef BOARD_CHECKED_GROUP
+
+#define BOARD_CHECKED_GROUP		BOARD_TIMERS_GROUP
+#if BOARD_CONFLICT
+#error "Two drivers use the same timer, check board_config.h"
+#endif
+#undef BOARD_CHECKED_GROUP
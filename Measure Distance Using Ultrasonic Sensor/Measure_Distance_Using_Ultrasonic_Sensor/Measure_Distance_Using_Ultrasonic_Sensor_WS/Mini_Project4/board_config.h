@@ -0,0 +1,76 @@
+/****************************************************************************************
+ *
+ * Module: Board Configuration
+ *
+ * File Name: board_config.h
+ *
+ * Discretion: Pins and peripherals of the board used by all the drivers
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef BOARD_CONFIG_H_
+#define BOARD_CONFIG_H_
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "gpio.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/*
+ * Every signal of the board is one "port, pin" pair, the drivers take their constants from these pairs by
+ * BOARD_PORT_ID and BOARD_PIN_ID, so the pins are known at compile time and can use the static GPIO macros.
+ * board_config.c fails the build if two drivers of the current configuration use the same pin or timer.
+ * The ports and pins should be the PORTx_ID and PINx_ID macros.
+ */
+
+/* LCD parallel bus (LCD_BACKEND_PARALLEL), D0 --> D7 on the data port or 4 of its pins in 4-bit mode */
+#define BOARD_LCD_RS						PORTB_ID, PIN0_ID
+#define BOARD_LCD_RW						PORTB_ID, PIN1_ID
+#define BOARD_LCD_E							PORTB_ID, PIN2_ID
+#define BOARD_LCD_DATA_PORT_ID				PORTA_ID
+
+/* TWI pins (LCD_BACKEND_PCF8574), fixed by the ATmega16 */
+#define BOARD_TWI_SCL						PORTC_ID, PIN0_ID
+#define BOARD_TWI_SDA						PORTC_ID, PIN1_ID
+
+/* Timer1 pins, fixed by the ATmega16: the echo input and the hardware trigger output */
+#define BOARD_ICU_ICP1						PORTD_ID, PIN6_ID
+#define BOARD_ICU_OC1A						PORTD_ID, PIN5_ID
+
+/* USART transmit pin (ULTRASONIC_TELEMETRY), fixed by the ATmega16 */
+#define BOARD_UART_TXD						PORTD_ID, PIN1_ID
+
+/* Select lines of the echo multiplexer, as many as the sensors need starting at the first pin */
+#define BOARD_ULTRASONIC_MUX_PORT_ID		PORTC_ID
+#define BOARD_ULTRASONIC_MUX_FIRST_PIN_ID	PIN2_ID
+
+/*
+ * Sensors in their mounting order, one SENSOR(trigger port, trigger pin, echo select, priority) for every sensor.
+ * The number of lines is ULTRASONIC_SENSOR_COUNT. The trigger pins are used in ULTRASONIC_TRIGGER_SOFTWARE mode only,
+ * in ULTRASONIC_TRIGGER_HARDWARE mode all the sensors are triggered by OC1A through the demultiplexer.
+ * A build can give its own list before this header (the host bench variants do).
+ */
+#ifndef BOARD_ULTRASONIC_SENSORS
+#define BOARD_ULTRASONIC_SENSORS(SENSOR) \
+	SENSOR(PORTB_ID, PIN5_ID, 0, 1)
+#endif
+
+#define BOARD_COUNT_SENSOR(trigger_port, trigger_pin, echo_select, priority)	+ 1
+#define BOARD_ULTRASONIC_SENSOR_COUNT		(0 BOARD_ULTRASONIC_SENSORS(BOARD_COUNT_SENSOR))
+
+/* Timers, the drivers are written for these timers */
+#define BOARD_ICU_TIMER						1 /* Input capture of Timer1 */
+#define BOARD_LCD_QUEUE_TIMER				0 /* Compare match of Timer0 (LCD_BACKGROUND_WRITE) */
+
+/* Port and pin of a signal */
+#define BOARD_PORT_ID(signal)				BOARD_PORT_OF(signal)
+#define BOARD_PIN_ID(signal)				BOARD_PIN_OF(signal)
+#define BOARD_PORT_OF(port_num, pin_num)	port_num
+#define BOARD_PIN_OF(port_num, pin_num)		pin_num
+
+#endif /* BOARD_CONFIG_H_ */
@@ -38,5 +38,14 @@
 /* Get the value of a certain bit*/
 #define GET_BIT(REG,BIT_NUM) ((REG & (1<<BIT_NUM))>>BIT_NUM)
 
+/*
+ * Body of a loop that waits for a variable written by an interrupt. It is empty on the AVR, where the
+ * interrupt comes while the loop spins. The host bench (host/avr/io.h) defines it to advance the time of its
+ * peripheral model, which runs only on register accesses, so a loop that reads only RAM would never end there.
+ */
+#ifndef POLL_WAIT
+#define POLL_WAIT()
+#endif
+
 
 #endif
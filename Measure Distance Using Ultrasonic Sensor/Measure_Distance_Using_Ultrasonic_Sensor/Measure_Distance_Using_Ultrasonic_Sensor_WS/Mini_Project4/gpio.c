@@ -14,6 +14,7 @@
  *                      		Include Header	                               *
  *******************************************************************************/
 #include<avr/io.h> /* To use the IO Ports Registers */
+#include<avr/interrupt.h> /* To protect the read-modify-write of the registers */
 #include"common_macros.h" /* To use Macros as SET_BIT */
 #include"gpio.h"
 
@@ -25,15 +26,19 @@
  * Description:
  * Setup the direction of the required pin input/output.
  * If the input port number or pin number are not correct, The function will not handle the request.
+ * The register is changed with the interrupts disabled, so interrupts may use other pins of the same port.
  */
 void GPIO_setupPinDirection(uint8 port_num, uint8 pin_num, GPIO_PinDirectionType direction)
 {
+	uint8 sreg = SREG;
+
 	if((port_num >= NUM_OF_PORTS) || (pin_num >= NUM_OF_PINS_PER_PORT))
 	{
 		/* DO NOTHING */
 	}
 	else
 	{
+		cli();
 		switch(port_num)
 		{
 		case PORTA_ID:
@@ -77,6 +82,7 @@ void GPIO_setupPinDirection(uint8 port_num, uint8 pin_num, GPIO_PinDirectionType
 			}
 			break;
 		}
+		SREG = sreg;
 	}
 }
 
@@ -85,15 +91,19 @@ void GPIO_setupPinDirection(uint8 port_num, uint8 pin_num, GPIO_PinDirectionType
  * Write the value logic high or logic low on the required pin.
  * if the input port number or pin number are not correct, the function will not handle the request.
  * if the pin input, this function will enable/disable the internal pull-up resistor.
+ * The register is changed with the interrupts disabled, so interrupts may use other pins of the same port.
  */
 void GPIO_writePin(uint8 port_num, uint8 pin_num, uint8 value)
 {
+	uint8 sreg = SREG;
+
 	if((port_num >= NUM_OF_PORTS) || (pin_num >= NUM_OF_PINS_PER_PORT))
 	{
 		/* DO NOTHING */
 	}
 	else
 	{
+		cli();
 		switch(port_num)
 		{
 		case PORTA_ID:
@@ -137,6 +147,7 @@ void GPIO_writePin(uint8 port_num, uint8 pin_num, uint8 value)
 			}
 			break;
 		}
+		SREG = sreg;
 	}
 }
 
@@ -299,3 +310,75 @@ uint8 GPIO_readPort(uint8 port_num)
 	}
 	return port_value;
 }
+
+/*
+ * Description:
+ * Setup the direction of the pins selected by mask, the other pins of the port keep their direction.
+ * if the input port number is not correct, the function will not handle the request.
+ */
+void GPIO_setupPortDirectionMasked(uint8 port_num, uint8 mask, GPIO_PortDirectionType direction)
+{
+	uint8 sreg = SREG;
+
+	if(port_num >= NUM_OF_PORTS)
+	{
+		/* DO NOTHING */
+	}
+	else
+	{
+		cli();
+		switch(port_num)
+		{
+		case PORTA_ID:
+			DDRA = (DDRA & ~mask) | (direction & mask);
+			break;
+		case PORTB_ID:
+			DDRB = (DDRB & ~mask) | (direction & mask);
+			break;
+		case PORTC_ID:
+			DDRC = (DDRC & ~mask) | (direction & mask);
+			break;
+		case PORTD_ID:
+			DDRD = (DDRD & ~mask) | (direction & mask);
+			break;
+		}
+		SREG = sreg;
+	}
+}
+
+/*
+ * Description:
+ * Write the value on the pins selected by mask, the other pins of the port keep their value.
+ * The port register is written once with the interrupts disabled, so other drivers and interrupts may use
+ * the other pins of the same port.
+ * if the input port number is not correct, the function will not handle the request.
+ */
+void GPIO_writePortMasked(uint8 port_num, uint8 mask, uint8 value)
+{
+	uint8 sreg = SREG;
+
+	if(port_num >= NUM_OF_PORTS)
+	{
+		/* Do nothing */
+	}
+	else
+	{
+		cli();
+		switch(port_num)
+		{
+		case PORTA_ID:
+			PORTA = (PORTA & ~mask) | (value & mask);
+			break;
+		case PORTB_ID:
+			PORTB = (PORTB & ~mask) | (value & mask);
+			break;
+		case PORTC_ID:
+			PORTC = (PORTC & ~mask) | (value & mask);
+			break;
+		case PORTD_ID:
+			PORTD = (PORTD & ~mask) | (value & mask);
+			break;
+		}
+		SREG = sreg;
+	}
+}
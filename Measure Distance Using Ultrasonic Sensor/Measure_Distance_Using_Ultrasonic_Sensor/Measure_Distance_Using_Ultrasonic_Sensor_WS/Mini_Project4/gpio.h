@@ -18,6 +18,7 @@
  *  						(1) Include Header					   *
  *******************************************************************/
 #include "std_types.h"
+#include <avr/io.h> /* For the registers of the static access macros */
 
 /*******************************************************************
  *  						(2) Definitions						   *
@@ -51,6 +52,76 @@ typedef enum
 	PORT_INPUT,PORT_OUTPUT=0xFF
 }GPIO_PortDirectionType;
 
+/*******************************************************************
+ *  						(4) Static Access Macros			   *
+ *******************************************************************/
+/*
+ * Access to a pin known at compile time, as the LCD control pins. The port should be one of the PORTx_ID
+ * macros and the pin a constant, the preprocessor selects the register so there is no switch and no range
+ * check at run time. A wrong port is an unknown register name and a wrong pin is an array of negative size,
+ * so both fail the build. On AVR a pin write is one sbi/cbi instruction at every optimization level, which is
+ * atomic, so no interrupt protection is needed. The functions below stay for ports and pins known at run time.
+ */
+#define GPIO_PORT_REG_0			PORTA
+#define GPIO_PORT_REG_1			PORTB
+#define GPIO_PORT_REG_2			PORTC
+#define GPIO_PORT_REG_3			PORTD
+#define GPIO_DDR_REG_0			DDRA
+#define GPIO_DDR_REG_1			DDRB
+#define GPIO_DDR_REG_2			DDRC
+#define GPIO_DDR_REG_3			DDRD
+#define GPIO_PIN_REG_0			PINA
+#define GPIO_PIN_REG_1			PINB
+#define GPIO_PIN_REG_2			PINC
+#define GPIO_PIN_REG_3			PIND
+
+/* Register of the type (PORT, DDR or PIN) of the port, the port ID is expanded before it is pasted */
+#define GPIO_REG(type, port_num)			GPIO_REG_PASTE(type, port_num)
+#define GPIO_REG_PASTE(type, port_num)		GPIO_##type##_REG_##port_num
+
+#define GPIO_CHECK_PIN(pin_num)				((void)sizeof(char[((pin_num) < NUM_OF_PINS_PER_PORT) ? 1 : -1]))
+
+#ifdef __AVR__
+#define GPIO_SET_BIT_STATIC(reg, pin_num) \
+	__asm__ __volatile__ ("sbi %0, %1" : : "I" (_SFR_IO_ADDR(reg)), "I" (pin_num))
+#define GPIO_CLEAR_BIT_STATIC(reg, pin_num) \
+	__asm__ __volatile__ ("cbi %0, %1" : : "I" (_SFR_IO_ADDR(reg)), "I" (pin_num))
+#else
+#define GPIO_SET_BIT_STATIC(reg, pin_num)	((reg) |= (uint8)(1<<(pin_num)))
+#define GPIO_CLEAR_BIT_STATIC(reg, pin_num)	((reg) &= (uint8)~(1<<(pin_num)))
+#endif
+
+/*
+ * Description:
+ * Setup the direction of a pin known at compile time, as GPIO_setupPinDirection.
+ */
+#define GPIO_SETUP_PIN_DIRECTION_STATIC(port_num, pin_num, direction) \
+	do{ \
+		GPIO_CHECK_PIN(pin_num); \
+		if((direction) == PIN_OUTPUT) { GPIO_SET_BIT_STATIC(GPIO_REG(DDR, port_num), pin_num); } \
+		else { GPIO_CLEAR_BIT_STATIC(GPIO_REG(DDR, port_num), pin_num); } \
+	}while(0)
+
+/*
+ * Description:
+ * Write logic high or logic low on a pin known at compile time, as GPIO_writePin.
+ * The value may be known at run time only, then one of the two instructions is selected by a branch.
+ */
+#define GPIO_WRITE_PIN_STATIC(port_num, pin_num, value) \
+	do{ \
+		GPIO_CHECK_PIN(pin_num); \
+		if((value) == LOGIC_HIGH) { GPIO_SET_BIT_STATIC(GPIO_REG(PORT, port_num), pin_num); } \
+		else { GPIO_CLEAR_BIT_STATIC(GPIO_REG(PORT, port_num), pin_num); } \
+	}while(0)
+
+/*
+ * Description:
+ * Read a pin known at compile time, as GPIO_readPin.
+ */
+#define GPIO_READ_PIN_STATIC(port_num, pin_num) \
+	(GPIO_CHECK_PIN(pin_num), \
+	((GPIO_REG(PIN, port_num) & (1<<(pin_num))) ? LOGIC_HIGH : LOGIC_LOW))
+
 /*******************************************************************
  *  						(5) Function Prototypes				   *
  *******************************************************************/
@@ -102,4 +173,20 @@ void GPIO_writePort(uint8 port_num, uint8 value);
  */
 uint8 GPIO_readPort(uint8 port_num);
 
+/*
+ * Description:
+ * Setup the direction of the pins selected by mask, the other pins of the port keep their direction.
+ * if the input port number is not correct, the function will not handle the request.
+ */
+void GPIO_setupPortDirectionMasked(uint8 port_num, uint8 mask, GPIO_PortDirectionType direction);
+
+/*
+ * Description:
+ * Write the value on the pins selected by mask, the other pins of the port keep their value.
+ * The port register is written once with the interrupts disabled, so other drivers and interrupts may use
+ * the other pins of the same port.
+ * if the input port number is not correct, the function will not handle the request.
+ */
+void GPIO_writePortMasked(uint8 port_num, uint8 mask, uint8 value);
+
 #endif /* GPIO_ */
@@ -0,0 +1,31 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: interrupt.h
+ *
+ * Discretion: Interrupt macros of the host build, the ISRs are called by the model of sim.c
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef SIM_AVR_INTERRUPT_H_
+#define SIM_AVR_INTERRUPT_H_
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include <avr/io.h>
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/* An ISR is a normal function, sim.c calls it when its flag and its enable bit are set and SREG.I is set */
+#define ISR(vector)			void vector(void); void vector(void)
+
+/* The I bit is changed through SREG, so the model sees it like any register write */
+#define sei()				(SREG |= (1<<SREG_I))
+#define cli()				(SREG &= (uint8_t)~(1<<SREG_I))
+
+#endif /* SIM_AVR_INTERRUPT_H_ */
@@ -0,0 +1,231 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: io.h
+ *
+ * Discretion: ATmega16 register names of the host build, every register is backed by the model of sim.c
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef SIM_AVR_IO_H_
+#define SIM_AVR_IO_H_
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include <stdint.h>
+#include "sim.h"
+
+/*******************************************************************************
+ *                      		Registers	 	                               *
+ *******************************************************************************/
+#define SIM_REG8(reg)		(*(volatile uint8_t *)Sim_io(reg))
+#define SIM_REG16(reg)		(*(volatile uint16_t *)Sim_io(reg))
+
+/* One pass of a loop that polls a variable written by an interrupt (common_macros.h) */
+#undef POLL_WAIT
+#define POLL_WAIT()			Sim_delayCycles(SIM_POLL_CYCLES)
+
+/* Ports */
+#define PINA				SIM_REG8(SIM_PINA)
+#define DDRA				SIM_REG8(SIM_DDRA)
+#define PORTA				SIM_REG8(SIM_PORTA)
+#define PINB				SIM_REG8(SIM_PINB)
+#define DDRB				SIM_REG8(SIM_DDRB)
+#define PORTB				SIM_REG8(SIM_PORTB)
+#define PINC				SIM_REG8(SIM_PINC)
+#define DDRC				SIM_REG8(SIM_DDRC)
+#define PORTC				SIM_REG8(SIM_PORTC)
+#define PIND				SIM_REG8(SIM_PIND)
+#define DDRD				SIM_REG8(SIM_DDRD)
+#define PORTD				SIM_REG8(SIM_PORTD)
+
+/* Status and interrupts, TIFR is 16-bit in the model so a write of its own value is seen (see sim.h) */
+#define SREG				SIM_REG8(SIM_SREG)
+#define TIMSK				SIM_REG8(SIM_TIMSK)
+#define TIFR				SIM_REG16(SIM_TIFR)
+#define GICR				SIM_REG8(SIM_GICR)
+
+/* Timer0 */
+#define TCCR0				SIM_REG8(SIM_TCCR0)
+#define TCNT0				SIM_REG8(SIM_TCNT0)
+#define OCR0				SIM_REG8(SIM_OCR0)
+
+/* Timer1 */
+#define TCCR1A				SIM_REG8(SIM_TCCR1A)
+#define TCCR1B				SIM_REG8(SIM_TCCR1B)
+#define TCNT1				SIM_REG16(SIM_TCNT1)
+#define OCR1A				SIM_REG16(SIM_OCR1A)
+#define OCR1B				SIM_REG16(SIM_OCR1B)
+#define ICR1				SIM_REG16(SIM_ICR1)
+
+/* TWI, the master transmitter is modelled, TWCR is 16-bit like TIFR */
+#define TWBR				SIM_REG8(SIM_TWBR)
+#define TWSR				SIM_REG8(SIM_TWSR)
+#define TWAR				SIM_REG8(SIM_TWAR)
+#define TWDR				SIM_REG8(SIM_TWDR)
+#define TWCR				SIM_REG16(SIM_TWCR)
+
+/* USART, the transmitter is modelled, UDR and UCSRA are 16-bit like TIFR */
+#define UDR					SIM_REG16(SIM_UDR)
+#define UCSRA				SIM_REG16(SIM_UCSRA)
+#define UCSRB				SIM_REG8(SIM_UCSRB)
+#define UCSRC				SIM_REG8(SIM_UCSRC)
+#define UBRRH				SIM_REG8(SIM_UBRRH)
+#define UBRRL				SIM_REG8(SIM_UBRRL)
+
+/*******************************************************************************
+ *                      		Bits		 	                               *
+ *******************************************************************************/
+/* Port pins */
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+/* SREG */
+#define SREG_I	7
+#define SREG_T	6
+#define SREG_H	5
+#define SREG_S	4
+#define SREG_V	3
+#define SREG_N	2
+#define SREG_Z	1
+#define SREG_C	0
+
+/* GICR */
+#define INT1	7
+#define INT0	6
+#define INT2	5
+#define IVSEL	1
+#define IVCE	0
+
+/* TIMSK */
+#define OCIE2	7
+#define TOIE2	6
+#define TICIE1	5
+#define OCIE1A	4
+#define OCIE1B	3
+#define TOIE1	2
+#define OCIE0	1
+#define TOIE0	0
+
+/* TIFR */
+#define OCF2	7
+#define TOV2	6
+#define ICF1	5
+#define OCF1A	4
+#define OCF1B	3
+#define TOV1	2
+#define OCF0	1
+#define TOV0	0
+
+/* TCCR0 */
+#define FOC0	7
+#define WGM00	6
+#define COM01	5
+#define COM00	4
+#define WGM01	3
+#define CS02	2
+#define CS01	1
+#define CS00	0
+
+/* TCCR1A */
+#define COM1A1	7
+#define COM1A0	6
+#define COM1B1	5
+#define COM1B0	4
+#define FOC1A	3
+#define FOC1B	2
+#define WGM11	1
+#define WGM10	0
+
+/* TCCR1B */
+#define ICNC1	7
+#define ICES1	6
+#define WGM13	4
+#define WGM12	3
+#define CS12	2
+#define CS11	1
+#define CS10	0
+
+/* TWCR */
+#define TWINT	7
+#define TWEA	6
+#define TWSTA	5
+#define TWSTO	4
+#define TWWC	3
+#define TWEN	2
+#define TWIE	0
+
+/* TWSR */
+#define TWS7	7
+#define TWS6	6
+#define TWS5	5
+#define TWS4	4
+#define TWS3	3
+#define TWPS1	1
+#define TWPS0	0
+
+/* UCSRA */
+#define RXC		7
+#define TXC		6
+#define UDRE	5
+#define FE		4
+#define DOR		3
+#define PE		2
+#define U2X		1
+#define MPCM	0
+
+/* UCSRB */
+#define RXCIE	7
+#define TXCIE	6
+#define UDRIE	5
+#define RXEN	4
+#define TXEN	3
+#define UCSZ2	2
+#define RXB8	1
+#define TXB8	0
+
+/* UCSRC */
+#define URSEL	7
+#define UMSEL	6
+#define UPM1	5
+#define UPM0	4
+#define USBS	3
+#define UCSZ1	2
+#define UCSZ0	1
+#define UCPOL	0
+
+#endif /* SIM_AVR_IO_H_ */
@@ -0,0 +1,24 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: pgmspace.h
+ *
+ * Discretion: Program memory macros of the host build, the constants stay in the normal memory
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef SIM_AVR_PGMSPACE_H_
+#define SIM_AVR_PGMSPACE_H_
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+#define PROGMEM
+#define PSTR(string)		(string)
+#define pgm_read_byte(address_ptr)	(*(const unsigned char *)(address_ptr))
+#define pgm_read_word(address_ptr)	(*(const unsigned short *)(address_ptr))
+
+#endif /* SIM_AVR_PGMSPACE_H_ */
@@ -0,0 +1,793 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: bench.c
+ *
+ * Discretion: Benchmark of the drivers and of the application on the host model
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "sim.h"
+#include "ultrasonic.h"
+#include "lcd.h"
+#include "perf.h"
+#include "trace.h"
+#include "uart.h"
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+#include "twi.h"
+#endif
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include <util/delay.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/* Scripted targets: a sweep over the range of the sensor and one ping without a target every BENCH_NO_TARGET_EVERY pings */
+#define BENCH_MIN_MM				30
+#define BENCH_MAX_MM				3800
+#define BENCH_STEP_MM				137
+#define BENCH_NO_TARGET_EVERY		16
+
+#define BENCH_MEASUREMENTS			200  /* Ultrasonic_readDistance calls of the driver benchmark */
+#define BENCH_LCD_CHARACTERS		1000 /* LCD_displayCharacter calls of the LCD benchmark */
+#define BENCH_LCD_LOCKED_CHARACTERS	(2 * LCD_QUEUE_SIZE) /* Characters written with the interrupts disabled */
+#define BENCH_APPLICATION_MS		3000 /* Simulated run time of the application */
+#define BENCH_SCHEDULE_PINGS		600  /* Ultrasonic_startMeasurement calls of the scheduler benchmark */
+#define BENCH_SCHEDULE_TOLERANCE	2    /* Pings a sensor may be away from its share of the priorities */
+#define BENCH_TIME_LIMIT_MS			60000 /* A driver benchmark that takes longer failed */
+#define BENCH_PULSE_START_TICKS		100  /* Timer1 ticks (1 us at F_CPU_8) from ICU_schedulePulse to the pulse */
+#define BENCH_PULSE_WIDTH_TICKS		20
+#define BENCH_PULSE_LOCK_US			200  /* Interrupts disabled over the start and the end of the pulse */
+#define BENCH_PULSE_MARGIN_US		50   /* The pulse ends this long after the interrupts are enabled again at most */
+#define BENCH_NACK_EVERY			97   /* Expander bytes between two NACK bursts of the retry benchmark */
+#define BENCH_DROP_BYTES			8    /* Bytes queued for an expander that never answers */
+
+/* Measured distance expected for a target in mm, one unit of error is the rounding of the echo ticks */
+#if (ULTRASONIC_DISTANCE_UNIT == ULTRASONIC_UNIT_MM)
+#define BENCH_EXPECTED(mm)			(mm)
+#define BENCH_UNIT					"mm"
+#else
+#define BENCH_EXPECTED(mm)			(((mm) + 5) / 10)
+#define BENCH_UNIT					"cm"
+#endif
+#define BENCH_TOLERANCE				1
+
+#define BENCH_TRACE_FILE			"trace_dump.txt" /* Trace_dump output after the application run, see tools/trace2perfetto.py */
+#define BENCH_TELEMETRY_FILE		"telemetry.bin"  /* TXD bytes of the application run, see tools/telemetry_decode.py */
+
+#define BENCH_MS_TO_CYCLES(ms)		((uint64)(ms) * (F_CPU / 1000UL))
+#define BENCH_PER_SECOND(count, cycles)	((cycles) ? ((double)(count) * (double)F_CPU / (double)(cycles)) : 0.0)
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static const Ultrasonic_SensorConfigType g_benchSensors[ULTRASONIC_SENSOR_COUNT] = {
+	BOARD_ULTRASONIC_SENSORS(ULTRASONIC_SENSOR_CONFIG)
+};
+
+/* Results checked by the call back of the ultrasonic driver */
+static uint32 g_results = 0;
+static uint32 g_wrongResults = 0;
+static uint32 g_noTargets = 0;
+static uint16 g_maxError = 0;
+
+static int g_failures = 0;
+
+/* Pulse call back of the late pulse benchmark */
+static volatile boolean g_pulseDone = FALSE;
+static uint64 g_pulseScheduled = 0;
+static uint64 g_pulseEnd = 0;
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+/* Expander bytes counted by the drop benchmark */
+static uint32 g_dropBytesBefore = 0;
+static uint32 g_dropBytesAfter = 0;
+static uint16 g_dropErrors = 0;
+#endif
+
+#if (TRACE_ENABLE == TRUE)
+static FILE * g_traceFile = NULL;
+#endif
+
+#if (ULTRASONIC_TELEMETRY == TRUE)
+/* Telemetry frames received on TXD, every frame is checked against the result of its ping */
+static Ultrasonic_ResultType g_sentResults[ULTRASONIC_SENSOR_COUNT][256]; /* Result of every sensor and sequence number, from the call back */
+static uint8 g_frame[ULTRASONIC_FRAME_SIZE];
+static uint8 g_frameLength = 0;
+static boolean g_frameSequenceValid[ULTRASONIC_SENSOR_COUNT];
+static uint8 g_frameSequence[ULTRASONIC_SENSOR_COUNT]; /* Last sequence number received of every sensor */
+static uint32 g_frames = 0;
+static uint32 g_frameGaps = 0;   /* Frames missing from the sequence numbers */
+static uint32 g_wrongFrames = 0; /* CRC errors and frames that differ from the result of their ping */
+static FILE * g_telemetryFile = NULL;
+#endif
+
+/* The application of mini_project4.c, built with main renamed */
+int app_main(void);
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+static uint16 Bench_distance(uint8 sensor, uint32 ping)
+{
+	if((ping % BENCH_NO_TARGET_EVERY) == (BENCH_NO_TARGET_EVERY - 1))
+	{
+		return SIM_HCSR04_NO_TARGET;
+	}
+	return (uint16)(BENCH_MIN_MM + (((ping * BENCH_STEP_MM) + (sensor * 251UL)) % (BENCH_MAX_MM - BENCH_MIN_MM)));
+}
+
+/*
+ * Description: Compare every result of the driver with the distance of the ping that produced it.
+ */
+static void Bench_checkResult(const Ultrasonic_ResultType * Result_Ptr)
+{
+	uint16 mm = Sim_hcsr04GetLastDistance(Result_Ptr->sensor);
+	uint16 error;
+
+	g_results++;
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	g_sentResults[Result_Ptr->sensor][Result_Ptr->sequence] = *Result_Ptr;
+#endif
+	if(mm == SIM_HCSR04_NO_TARGET)
+	{
+		g_noTargets++;
+		if(Result_Ptr->status != ULTRASONIC_NO_TARGET)
+		{
+			g_wrongResults++;
+		}
+		return;
+	}
+
+	if(Result_Ptr->status != ULTRASONIC_OK)
+	{
+		g_wrongResults++;
+		return;
+	}
+
+	error = (Result_Ptr->distance > BENCH_EXPECTED(mm)) ? (uint16)(Result_Ptr->distance - BENCH_EXPECTED(mm)) :
+			(uint16)(BENCH_EXPECTED(mm) - Result_Ptr->distance);
+	if(error > g_maxError)
+	{
+		g_maxError = error;
+	}
+	if(error > BENCH_TOLERANCE)
+	{
+		g_wrongResults++;
+	}
+}
+
+#if (ULTRASONIC_TELEMETRY == TRUE)
+static uint32 Bench_frameField(uint8 offset, uint8 size)
+{
+	uint32 value = 0;
+
+	while(size != 0)
+	{
+		size--;
+		value = (value << 8) | g_frame[offset + size];
+	}
+	return value;
+}
+
+/*
+ * Description: Check the CRC of a complete frame and compare its fields with the result of the same sensor and sequence number.
+ */
+static void Bench_checkFrame(void)
+{
+	const Ultrasonic_ResultType * result;
+	uint8 sensor = g_frame[3] >> 4;
+	uint16 crc = 0;
+	uint8 i;
+
+	g_frames++;
+	for(i = 2; i < (ULTRASONIC_FRAME_SIZE - 2); i++)
+	{
+		crc = _crc_xmodem_update(crc, g_frame[i]);
+	}
+	if(crc != (uint16)Bench_frameField(ULTRASONIC_FRAME_SIZE - 2, 2))
+	{
+		g_wrongFrames++;
+		return;
+	}
+
+	if(sensor >= ULTRASONIC_SENSOR_COUNT)
+	{
+		g_wrongFrames++;
+		return;
+	}
+	result = &g_sentResults[sensor][g_frame[2]];
+
+	if((g_frame[3] != (uint8)((result->sensor << 4) | (result->prescaler << 1) | result->status)) ||
+			(Bench_frameField(4, 4) != result->timestamp) || (Bench_frameField(8, 4) != result->ticks) ||
+			(Bench_frameField(12, 2) != result->distance))
+	{
+		g_wrongFrames++;
+	}
+
+	if(g_frameSequenceValid[sensor] == TRUE)
+	{
+		g_frameGaps += (uint8)(g_frame[2] - g_frameSequence[sensor] - 1);
+	}
+	g_frameSequence[sensor] = g_frame[2];
+	g_frameSequenceValid[sensor] = TRUE;
+}
+
+/*
+ * Description: Receiver of the TXD line, it finds the frames by their sync bytes.
+ */
+static void Bench_receiveByte(uint8 data)
+{
+	if(g_telemetryFile != NULL)
+	{
+		fputc(data, g_telemetryFile);
+	}
+
+	if(((g_frameLength == 0) && (data != ULTRASONIC_FRAME_SYNC1)) ||
+			((g_frameLength == 1) && (data != ULTRASONIC_FRAME_SYNC2)))
+	{
+		g_frameLength = 0;
+		if(data != ULTRASONIC_FRAME_SYNC1)
+		{
+			return;
+		}
+	}
+
+	g_frame[g_frameLength] = data;
+	g_frameLength++;
+	if(g_frameLength == ULTRASONIC_FRAME_SIZE)
+	{
+		g_frameLength = 0;
+		Bench_checkFrame();
+	}
+}
+#endif
+
+static double Bench_hostSeconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+/*
+ * Description: Power on the MCU and the external parts of the board.
+ */
+static void Bench_powerOn(void)
+{
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	uint8 i;
+#endif
+
+	Sim_init();
+	Sim_hcsr04Init(Bench_distance);
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+	Sim_pcf8574Init(); /* Before the LCD, its pins are the LCD lines */
+#endif
+	Sim_hd44780Init();
+
+	g_results = 0;
+	g_wrongResults = 0;
+	g_noTargets = 0;
+	g_maxError = 0;
+
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	Sim_uartConnect(Bench_receiveByte);
+	g_frameLength = 0;
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		g_frameSequenceValid[i] = FALSE;
+	}
+	g_frames = 0;
+	g_frameGaps = 0;
+	g_wrongFrames = 0;
+#endif
+}
+
+static void Bench_measure(void)
+{
+	uint16 i;
+
+	sei();
+	Ultrasonic_init(g_benchSensors);
+	for(i = 0; i < BENCH_MEASUREMENTS; i++)
+	{
+		(void)Ultrasonic_readDistance(i % ULTRASONIC_SENSOR_COUNT);
+	}
+}
+
+#if (ULTRASONIC_SENSOR_COUNT > 1)
+static void Bench_schedule(void)
+{
+	Ultrasonic_ResultType result;
+	uint16 i;
+
+	sei();
+	Ultrasonic_init(g_benchSensors);
+	for(i = 0; i < BENCH_SCHEDULE_PINGS; i++)
+	{
+		while(Ultrasonic_startMeasurement() == FALSE); /* The scheduler chooses the sensor */
+		while(Ultrasonic_getResult(&result) == FALSE);
+	}
+}
+#endif
+
+static void Bench_lcd(void)
+{
+	uint16 i;
+
+	sei();
+	LCD_init();
+	for(i = 0; i < BENCH_LCD_CHARACTERS; i++)
+	{
+		LCD_displayCharacter((uint8)('0' + (i % 10)));
+	}
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+	while(TWI_isIdle() == FALSE); /* The TWI interrupt sends the rest */
+#endif
+}
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+/*
+ * Description: Queue bytes for an expander that NACKs more times than TWI_MAX_RETRIES, then one byte it takes.
+ * The bytes of the expander keep E low, so the LCD does not see them.
+ */
+static void Bench_twiDrop(void)
+{
+	Sim_Pcf8574StatsType stats;
+	uint8 i;
+
+	sei();
+	LCD_init();
+	while(TWI_isIdle() == FALSE);
+	Sim_pcf8574GetStats(&stats);
+	g_dropBytesBefore = stats.bytes;
+	g_dropErrors = TWI_getErrorCount();
+
+	Sim_pcf8574SetNacks(0, TWI_MAX_RETRIES + 1);
+	cli(); /* All the bytes are queued before the first NACK */
+	for(i = 0; i < BENCH_DROP_BYTES; i++)
+	{
+		TWI_writeByte(LCD_PCF8574_ADDRESS, LCD_PCF8574_BACKLIGHT);
+	}
+	sei();
+	while(TWI_isIdle() == FALSE);
+	g_dropErrors = TWI_getErrorCount() - g_dropErrors;
+
+	TWI_writeByte(LCD_PCF8574_ADDRESS, LCD_PCF8574_BACKLIGHT); /* The expander answers again */
+	while(TWI_isIdle() == FALSE);
+	Sim_pcf8574GetStats(&stats);
+	g_dropBytesAfter = stats.bytes;
+}
+#endif
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+/*
+ * Description: Fill the LCD queue with the interrupts disabled, LCD_writeByte writes the oldest bytes itself.
+ */
+static void Bench_lcdLocked(void)
+{
+	uint16 i;
+
+	sei();
+	LCD_init();
+	cli();
+	for(i = 0; i < BENCH_LCD_LOCKED_CHARACTERS; i++)
+	{
+		LCD_displayCharacter((uint8)('0' + (i % 10)));
+	}
+	sei();
+	while(LCD_getQueueDepth() != 0); /* The ISR writes the rest */
+}
+#endif
+
+static void Bench_pulseEnd(void)
+{
+	g_pulseEnd = Sim_getCycles();
+	g_pulseDone = TRUE;
+}
+
+/*
+ * Description: Schedule an OC1A pulse with the interrupts disabled longer than the pulse, so the compare ISR
+ * comes after the end of the pulse and has to end it itself.
+ */
+static void Bench_pulseLate(void)
+{
+	ICU_ConfigType config = {F_CPU_8, RISING};
+
+	g_pulseDone = FALSE;
+	sei();
+	ICU_init(&config);
+	ICU_setPulseCallBack(Bench_pulseEnd);
+	GPIO_setupPinDirection(BOARD_PORT_ID(BOARD_ICU_OC1A), BOARD_PIN_ID(BOARD_ICU_OC1A), PIN_OUTPUT);
+
+	cli();
+	g_pulseScheduled = Sim_getCycles();
+	ICU_schedulePulse(ICU_getTimerValue() + BENCH_PULSE_START_TICKS, BENCH_PULSE_WIDTH_TICKS);
+	_delay_us(BENCH_PULSE_LOCK_US);
+	sei();
+
+	while(g_pulseDone == FALSE)
+	{
+		Sim_delayCycles(SIM_POLL_CYCLES);
+	}
+}
+
+static void Bench_application(void)
+{
+	(void)app_main();
+}
+
+/*
+ * Description: Run one program on a board that was just powered on and print its time and the LCD counters.
+ */
+static boolean Bench_run(const char * name, void (*entry_ptr)(void), uint64 cycles, uint64 * Cycles_Ptr)
+{
+	double hostStart = Bench_hostSeconds();
+	boolean completed;
+	double hostTime;
+
+	completed = Sim_runProgram(entry_ptr, cycles);
+	hostTime = Bench_hostSeconds() - hostStart;
+	*Cycles_Ptr = Sim_getCycles();
+
+	printf("\n%s: %.1f ms simulated in %.2f s (%.1fx real time)%s\n", name,
+			(double)Sim_getCycles() * 1000.0 / (double)F_CPU, hostTime,
+			(hostTime > 0) ? ((double)Sim_getCycles() / (double)F_CPU) / hostTime : 0.0,
+			(completed == TRUE) ? "" : " -- stopped");
+	return completed;
+}
+
+static void Bench_printResults(uint64 cycles)
+{
+	printf("  results            %lu (%.1f per second), %lu without target\n", (unsigned long)g_results,
+			BENCH_PER_SECOND(g_results, cycles), (unsigned long)g_noTargets);
+	printf("  wrong results      %lu, biggest error %u " BENCH_UNIT "\n", (unsigned long)g_wrongResults, g_maxError);
+	if(g_wrongResults != 0)
+	{
+		g_failures++;
+	}
+}
+
+#if (ULTRASONIC_SENSOR_COUNT > 1)
+/*
+ * Description: Print the pings of every sensor, each one should get the share of its priority.
+ */
+static void Bench_printSchedule(void)
+{
+	uint32 total = 0;
+	uint32 pings;
+	uint32 expected;
+	uint8 i;
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		total += g_benchSensors[i].priority;
+	}
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		pings = Sim_hcsr04GetPingCount(i);
+		expected = ((uint32)BENCH_SCHEDULE_PINGS * g_benchSensors[i].priority + (total / 2)) / total;
+		printf("  sensor %u           priority %u, %lu pings, %lu expected\n", i, g_benchSensors[i].priority,
+				(unsigned long)pings, (unsigned long)expected);
+		if((pings + BENCH_SCHEDULE_TOLERANCE < expected) || (pings > expected + BENCH_SCHEDULE_TOLERANCE))
+		{
+			g_failures++;
+		}
+	}
+}
+#endif
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE) && (ULTRASONIC_SCHEDULE == ULTRASONIC_SCHEDULE_FIXED)
+/*
+ * Description: Print the pings of the periodic pinging, Timer1 should send one every ULTRASONIC_PING_PERIOD_US.
+ */
+static void Bench_printPingRate(uint64 cycles)
+{
+	uint32 expected = (uint32)(cycles / SIM_US_TO_CYCLES(ULTRASONIC_PING_PERIOD_US));
+	uint32 pings = 0;
+	uint8 i;
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		pings += Sim_hcsr04GetPingCount(i);
+	}
+
+	printf("  pings              %lu, %lu expected at the fixed rate\n", (unsigned long)pings, (unsigned long)expected);
+	if((pings + 1 < expected) || (pings > expected + 1))
+	{
+		g_failures++;
+	}
+}
+#endif
+
+/*
+ * Description: Print the end of the late pulse, the call back should come right after the interrupts are enabled.
+ */
+static void Bench_printPulseLate(void)
+{
+	uint64 latency = SIM_CYCLES_TO_US(g_pulseEnd - g_pulseScheduled);
+	uint8 level = (Sim_getPortOutput(BOARD_PORT_ID(BOARD_ICU_OC1A)) >> BOARD_PIN_ID(BOARD_ICU_OC1A)) & 0x01;
+
+	printf("  pulse end          %llu us after ICU_schedulePulse (interrupts enabled after %u us), OC1A %u\n",
+			(unsigned long long)latency, BENCH_PULSE_LOCK_US, level);
+	if((g_pulseDone == FALSE) || (latency > (BENCH_PULSE_LOCK_US + BENCH_PULSE_MARGIN_US)) || (level != 0))
+	{
+		g_failures++;
+	}
+}
+
+#if (ULTRASONIC_TELEMETRY == TRUE)
+/*
+ * Description: Print the frames received on TXD, a frame is missing only if UART_send dropped it.
+ */
+static void Bench_printTelemetry(uint64 cycles)
+{
+	printf("  telemetry frames   %lu (%.1f per second), %u dropped, %lu missing, %lu wrong\n", (unsigned long)g_frames,
+			BENCH_PER_SECOND(g_frames, cycles), UART_getDropCount(), (unsigned long)g_frameGaps,
+			(unsigned long)g_wrongFrames);
+	if((g_wrongFrames != 0) || (g_frameGaps > UART_getDropCount()) || ((g_frames == 0) && (g_results != 0)))
+	{
+		g_failures++;
+	}
+}
+#endif
+
+static void Bench_printLcd(uint64 cycles)
+{
+	Sim_Hd44780StatsType stats;
+	char row[LCD_COLS + 1];
+	uint8 i;
+
+	Sim_hd44780GetStats(&stats);
+	printf("  lcd bytes          %lu (%.1f per second), %lu characters, %lu busy flag reads\n",
+			(unsigned long)stats.bytes, BENCH_PER_SECOND(stats.bytes, cycles),
+			(unsigned long)stats.characters, (unsigned long)stats.reads);
+	if(stats.minCyclesBetweenBytes != 0xFFFFFFFFUL)
+	{
+		printf("  lcd byte interval  %.1f us at least\n", (double)stats.minCyclesBetweenBytes * 1e6 / (double)F_CPU);
+	}
+	printf("  lcd bus problems   %lu timing, %lu busy writes, %lu contentions\n", (unsigned long)stats.timingViolations,
+			(unsigned long)stats.busyWrites, (unsigned long)stats.contentions);
+	for(i = 0; i < LCD_ROWS; i++)
+	{
+		Sim_hd44780GetRow(i, row);
+		printf("  lcd row %u          |%s|\n", i, row);
+	}
+
+	if((stats.timingViolations != 0) || (stats.busyWrites != 0) || (stats.contentions != 0))
+	{
+		g_failures++;
+	}
+}
+
+#if (LCD_BACKGROUND_WRITE == TRUE) || (LCD_BACKEND == LCD_BACKEND_PCF8574)
+/*
+ * Description: Check that every character the program wrote reached the LCD.
+ */
+static void Bench_checkLcdCharacters(uint32 characters)
+{
+	Sim_Hd44780StatsType stats;
+
+	Sim_hd44780GetStats(&stats);
+	if(stats.characters != characters)
+	{
+		printf("  lcd characters     %lu of %lu written\n", (unsigned long)stats.characters, (unsigned long)characters);
+		g_failures++;
+	}
+}
+#endif
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+/*
+ * Description: Print the counters of the TWI bus, every NACK of the expander is one error of the TWI driver.
+ */
+static void Bench_printTwi(void)
+{
+	Sim_Pcf8574StatsType stats;
+
+	Sim_pcf8574GetStats(&stats);
+	printf("  twi expander bytes %lu, %lu NACKs, %u driver errors\n", (unsigned long)stats.bytes,
+			(unsigned long)stats.nacks, TWI_getErrorCount());
+	if(stats.nacks != TWI_getErrorCount())
+	{
+		g_failures++;
+	}
+}
+
+/*
+ * Description: Print the result of the drop benchmark, the queued bytes are dropped and the next byte is sent.
+ */
+static void Bench_printTwiDrop(void)
+{
+	printf("  twi dropped bytes  %u queued, %u errors, %lu bytes taken after the drop\n", BENCH_DROP_BYTES,
+			g_dropErrors, (unsigned long)(g_dropBytesAfter - g_dropBytesBefore));
+	if((g_dropErrors != (TWI_MAX_RETRIES + 1)) || ((g_dropBytesAfter - g_dropBytesBefore) != 1) || (TWI_getQueueDepth() != 0))
+	{
+		g_failures++;
+	}
+}
+#endif
+
+#if (PERF_ENABLE == TRUE)
+/*
+ * Description: Print the statistics table of perf.c, the cycles are the model time and not the AVR cycles.
+ */
+static void Bench_printPerf(void)
+{
+	static const char * const names[PERF_POINT_COUNT] = {
+		"TIMER1_CAPT ISR", "Ultrasonic_edgeProcessing", "LCD_writeByte", "LCD_flush"
+	};
+	Perf_StatsType stats;
+	uint8 i;
+
+	for(i = 0; i < PERF_POINT_COUNT; i++)
+	{
+		Perf_getStats((Perf_PointType)i, &stats);
+		printf("  perf %-26s %7lu calls, cycles min %lu max %lu mean %lu\n", names[i], (unsigned long)stats.count,
+				(unsigned long)stats.min, (unsigned long)stats.max, (unsigned long)stats.mean);
+	}
+	printf("  perf missed echoes %lu, stray edges %lu\n", (unsigned long)Perf_getCounter(PERF_MISSED_ECHO),
+			(unsigned long)Perf_getCounter(PERF_STRAY_EDGE));
+}
+#endif
+
+#if (TRACE_ENABLE == TRUE)
+static void Bench_traceByte(uint8 byte)
+{
+	fputc(byte, g_traceFile);
+}
+
+/*
+ * Description: Write the trace ring as the serial port would send it.
+ */
+static void Bench_dumpTrace(void)
+{
+	g_traceFile = fopen(BENCH_TRACE_FILE, "w");
+	if(g_traceFile == NULL)
+	{
+		perror(BENCH_TRACE_FILE);
+		g_failures++;
+		return;
+	}
+	Trace_dump(Bench_traceByte);
+	fclose(g_traceFile);
+	printf("  trace written to %s\n", BENCH_TRACE_FILE);
+}
+#endif
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+int main(void)
+{
+	uint64 cycles;
+
+	printf("F_CPU %lu Hz, %u sensor(s), access %u / call %u / ISR %u cycles\n", (unsigned long)F_CPU,
+			(unsigned)ULTRASONIC_SENSOR_COUNT, SIM_ACCESS_CYCLES, SIM_CALL_CYCLES, SIM_ISR_CYCLES);
+
+	/* Ultrasonic driver alone: back to back Ultrasonic_readDistance */
+	Bench_powerOn();
+	Ultrasonic_setCallBack(Bench_checkResult);
+	if(Bench_run("Ultrasonic_readDistance", Bench_measure, BENCH_MS_TO_CYCLES(BENCH_TIME_LIMIT_MS), &cycles) == FALSE)
+	{
+		g_failures++;
+	}
+	Bench_printResults(cycles);
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	Bench_printTelemetry(cycles);
+#endif
+
+#if (ULTRASONIC_SENSOR_COUNT > 1)
+	/* Ultrasonic scheduler: the share of the pings of every sensor */
+	Bench_powerOn();
+	Ultrasonic_setCallBack(Bench_checkResult);
+	if(Bench_run("Ultrasonic_startMeasurement", Bench_schedule, BENCH_MS_TO_CYCLES(BENCH_TIME_LIMIT_MS), &cycles) == FALSE)
+	{
+		g_failures++;
+	}
+	Bench_printResults(cycles);
+	Bench_printSchedule();
+#endif
+
+	/* OC1A pulse whose compare interrupt comes after the end of the pulse */
+	Bench_powerOn();
+	if(Bench_run("ICU_schedulePulse late", Bench_pulseLate, BENCH_MS_TO_CYCLES(BENCH_TIME_LIMIT_MS), &cycles) == FALSE)
+	{
+		g_failures++;
+	}
+	Bench_printPulseLate();
+
+	/* LCD driver alone: back to back characters */
+	Bench_powerOn();
+	if(Bench_run("LCD_displayCharacter", Bench_lcd, BENCH_MS_TO_CYCLES(BENCH_TIME_LIMIT_MS), &cycles) == FALSE)
+	{
+		g_failures++;
+	}
+	Bench_printLcd(cycles);
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+	Bench_printTwi();
+	Bench_checkLcdCharacters(BENCH_LCD_CHARACTERS);
+
+	/* LCD on an expander that NACKs bursts of TWI_MAX_RETRIES acknowledgements, every byte is sent again */
+	Bench_powerOn();
+	Sim_pcf8574SetNacks(BENCH_NACK_EVERY, TWI_MAX_RETRIES);
+	if(Bench_run("LCD_displayCharacter with NACKs", Bench_lcd, BENCH_MS_TO_CYCLES(BENCH_TIME_LIMIT_MS), &cycles) == FALSE)
+	{
+		g_failures++;
+	}
+	Bench_printLcd(cycles);
+	Bench_printTwi();
+	Bench_checkLcdCharacters(BENCH_LCD_CHARACTERS);
+
+	/* Expander that does not answer, the TWI driver drops the queued bytes */
+	Bench_powerOn();
+	if(Bench_run("TWI_writeByte dropped", Bench_twiDrop, BENCH_MS_TO_CYCLES(BENCH_TIME_LIMIT_MS), &cycles) == FALSE)
+	{
+		g_failures++;
+	}
+	Bench_printTwiDrop();
+#endif
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+	/* LCD queue full with the interrupts disabled */
+	Bench_powerOn();
+	if(Bench_run("LCD_displayCharacter locked", Bench_lcdLocked, BENCH_MS_TO_CYCLES(BENCH_TIME_LIMIT_MS), &cycles) == FALSE)
+	{
+		g_failures++;
+	}
+	Bench_printLcd(cycles);
+	Bench_checkLcdCharacters(BENCH_LCD_LOCKED_CHARACTERS);
+#endif
+
+	/* The application of mini_project4.c */
+	Bench_powerOn();
+#if (PERF_ENABLE == TRUE)
+	Perf_reset();
+#endif
+#if (TRACE_ENABLE == TRUE)
+	Trace_clear();
+#endif
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	g_telemetryFile = fopen(BENCH_TELEMETRY_FILE, "wb");
+#endif
+	(void)Bench_run("mini_project4 application", Bench_application, BENCH_MS_TO_CYCLES(BENCH_APPLICATION_MS), &cycles);
+	Bench_printResults(cycles);
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE) && (ULTRASONIC_SCHEDULE == ULTRASONIC_SCHEDULE_FIXED)
+	Bench_printPingRate(cycles);
+#endif
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	Bench_printTelemetry(cycles);
+	if(g_telemetryFile != NULL)
+	{
+		fclose(g_telemetryFile);
+		g_telemetryFile = NULL;
+		printf("  telemetry written to %s\n", BENCH_TELEMETRY_FILE);
+	}
+#endif
+	Bench_printLcd(cycles);
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+	Bench_printTwi();
+#endif
+#if (PERF_ENABLE == TRUE)
+	Bench_printPerf();
+#endif
+#if (TRACE_ENABLE == TRUE)
+	Bench_dumpTrace();
+#endif
+
+	printf("\n%s\n", (g_failures == 0) ? "PASS" : "FAIL");
+	return (g_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
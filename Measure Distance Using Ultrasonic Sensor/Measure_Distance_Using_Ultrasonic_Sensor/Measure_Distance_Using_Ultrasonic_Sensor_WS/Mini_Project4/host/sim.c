@@ -0,0 +1,1032 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: sim.c
+ *
+ * Discretion: Source file of the ATmega16 peripheral model used to run the drivers on a PC
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "sim.h"
+#include "gpio.h"         /* For the port IDs */
+#include "board_config.h" /* For the ICP1 and OC1A pins */
+#include <avr/io.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/* Registers of a port, the enumeration keeps PINx, DDRx and PORTx of every port together */
+#define SIM_PIN_REG(port_num)		((Sim_RegisterType)(SIM_PINA + (3 * (port_num))))
+#define SIM_DDR_REG(port_num)		((Sim_RegisterType)(SIM_DDRA + (3 * (port_num))))
+#define SIM_PORT_REG(port_num)		((Sim_RegisterType)(SIM_PORTA + (3 * (port_num))))
+
+/* TIFR, TWCR, UDR and UCSRA are seen by the program with this upper byte, a write clears it (see sim.h) */
+#define SIM_WRITE_MARK				0xFF00
+
+#define SIM_SREG_I					(1<<SREG_I)
+#define SIM_TCCR1A_FOC				((1<<FOC1A) | (1<<FOC1B))
+#define SIM_COM1A(tccr1a)			(((tccr1a) >> COM1A0) & 0x03)
+
+#define SIM_NO_EVENT				(~(uint64)0)
+
+/* TWI status codes of the master transmitter in TWSR, the prescaler bits are kept */
+#define SIM_TWI_START				0x08
+#define SIM_TWI_REPEATED_START		0x10
+#define SIM_TWI_SLA_W_ACK			0x18
+#define SIM_TWI_SLA_W_NACK			0x20
+#define SIM_TWI_DATA_ACK			0x28
+#define SIM_TWI_DATA_NACK			0x30
+#define SIM_TWI_NO_STATE			0xF8
+#define SIM_TWSR_PRESCALER			((1<<TWPS1) | (1<<TWPS0))
+#define SIM_TWCR_STATUS				((1<<TWINT) | (1<<TWWC)) /* Bits the program does not write */
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+typedef struct{
+	uint64 cycle;
+	Sim_EventHandlerType handler_ptr;
+	uint8 arg;
+}Sim_EventType;
+
+/* Actions of the TWI master on the bus */
+typedef enum{
+	SIM_TWI_ACTION_START, SIM_TWI_ACTION_STOP, SIM_TWI_ACTION_BYTE
+}Sim_TwiActionType;
+
+typedef struct{
+	Sim_RegisterType flag_reg;   /* TIFR, TWCR or UCSRA */
+	Sim_RegisterType enable_reg; /* TIMSK, TWCR or UCSRB */
+	uint8 flag;
+	uint8 enable;
+	boolean level;               /* The flag is a state of the peripheral and is not cleared when the vector is taken */
+	void (*vector_ptr)(void);    /* ISR of the drivers, NULL if no driver defines it */
+	const char * name;
+}Sim_VectorType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+/* Vectors defined by the drivers, weak so a program without the ISR still links */
+extern void TIMER1_CAPT_vect(void) __attribute__((weak));
+extern void TIMER1_COMPA_vect(void) __attribute__((weak));
+extern void TIMER1_COMPB_vect(void) __attribute__((weak));
+extern void TIMER1_OVF_vect(void) __attribute__((weak));
+extern void TIMER0_OVF_vect(void) __attribute__((weak));
+extern void TIMER0_COMP_vect(void) __attribute__((weak));
+extern void USART_UDRE_vect(void) __attribute__((weak));
+extern void USART_TXC_vect(void) __attribute__((weak));
+extern void TWI_vect(void) __attribute__((weak));
+
+/* Timer, USART transmitter and TWI interrupts in the priority order of the ATmega16 vector table */
+static const Sim_VectorType g_vectors[] = {
+	{SIM_TIFR,  SIM_TIMSK, (1<<ICF1),  (1<<TICIE1), FALSE, TIMER1_CAPT_vect,  "TIMER1_CAPT_vect"},
+	{SIM_TIFR,  SIM_TIMSK, (1<<OCF1A), (1<<OCIE1A), FALSE, TIMER1_COMPA_vect, "TIMER1_COMPA_vect"},
+	{SIM_TIFR,  SIM_TIMSK, (1<<OCF1B), (1<<OCIE1B), FALSE, TIMER1_COMPB_vect, "TIMER1_COMPB_vect"},
+	{SIM_TIFR,  SIM_TIMSK, (1<<TOV1),  (1<<TOIE1),  FALSE, TIMER1_OVF_vect,   "TIMER1_OVF_vect"},
+	{SIM_TIFR,  SIM_TIMSK, (1<<TOV0),  (1<<TOIE0),  FALSE, TIMER0_OVF_vect,   "TIMER0_OVF_vect"},
+	{SIM_UCSRA, SIM_UCSRB, (1<<UDRE),  (1<<UDRIE),  TRUE,  USART_UDRE_vect,   "USART_UDRE_vect"},
+	{SIM_UCSRA, SIM_UCSRB, (1<<TXC),   (1<<TXCIE),  FALSE, USART_TXC_vect,    "USART_TXC_vect"},
+	{SIM_TWCR,  SIM_TWCR,  (1<<TWINT), (1<<TWIE),   TRUE,  TWI_vect,          "TWI_vect"},
+	{SIM_TIFR,  SIM_TIMSK, (1<<OCF0),  (1<<OCIE0),  FALSE, TIMER0_COMP_vect,  "TIMER0_COMP_vect"},
+};
+
+/* Timer clock divider of the CS bits, 0 is stopped */
+static const uint16 g_prescaler[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+/*
+ * g_io is the memory the program reads and writes through Sim_io, g_published is what the model put there last
+ * and g_hw is the register value inside the model.
+ */
+static volatile uint16 g_io[SIM_REGISTER_COUNT];
+static uint16 g_published[SIM_REGISTER_COUNT];
+static uint16 g_hw[SIM_REGISTER_COUNT];
+
+static uint64 g_cycles = 0;
+
+/* Pins driven from outside the MCU */
+static uint8 g_inputMask[NUM_OF_PORTS];
+static uint8 g_inputValue[NUM_OF_PORTS];
+
+/* Pins the models saw last, to call them only when something changed */
+static uint8 g_lastOutput[NUM_OF_PORTS];
+static uint8 g_lastDirection[NUM_OF_PORTS];
+static uint8 g_icpLevel = 0;
+
+static uint8 g_oc1a = 0; /* Compare output latch of OC1A */
+
+/* USART transmitter: the shift register and the one byte buffer of UDR */
+static boolean g_uartShifting = FALSE;
+static uint8 g_uartShift = 0;
+static uint8 g_uartBuffer = 0; /* Valid while UDRE is clear */
+static void (*g_uartReceivePtr)(uint8 data) = NULL;
+
+/*
+ * TWI master: it holds the bus from the START to the STOP and one action runs at a time.
+ * g_twiAction is changed when the TWI is disabled, so the event of the action that ran is ignored.
+ */
+static boolean g_twiBusOwner = FALSE;
+static boolean g_twiAddressPhase = FALSE; /* The next byte is the SLA+R/W after a START */
+static boolean g_twiAddressed = FALSE;    /* The slave acknowledged its SLA+W */
+static boolean g_twiActive = FALSE;
+static boolean g_twiStartAfterStop = FALSE; /* TWSTA and TWSTO written together */
+static Sim_TwiActionType g_twiPending = SIM_TWI_ACTION_START;
+static uint8 g_twiAction = 0;
+static uint8 g_twiSlaveAddress = 0;
+static boolean (*g_twiReceivePtr)(uint8 data, boolean first) = NULL;
+
+static Sim_EventType g_events[SIM_MAX_EVENTS];
+static uint8 g_eventCount = 0;
+static uint64 g_nextEvent = SIM_NO_EVENT;
+
+/* Program run by Sim_runProgram */
+static jmp_buf g_stopJump;
+static boolean g_running = FALSE;
+static uint64 g_stopCycle = 0;
+static uint8 g_isrDepth = 0;
+static volatile sig_atomic_t g_progress = 0;
+static sig_atomic_t g_lastProgress = 0;
+static uint8 g_stuckSeconds = 0;
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+static void Sim_fail(const char * message, const char * detail)
+{
+	fprintf(stderr, "sim: %s%s at cycle %llu\n", message, detail, (unsigned long long)g_cycles);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Description: Level of every pin of the port as PINx reads it.
+ * Output pins read their own level, inputs the external driver, the pull-up or 0 if nothing drives them.
+ */
+static uint8 Sim_getPinLevels(uint8 port_num)
+{
+	uint8 direction = (uint8)g_hw[SIM_DDR_REG(port_num)];
+	uint8 pullUp = (uint8)g_hw[SIM_PORT_REG(port_num)] & (uint8)~direction & (uint8)~g_inputMask[port_num];
+
+	return Sim_getPortOutput(port_num) | (g_inputValue[port_num] & g_inputMask[port_num] & (uint8)~direction) | pullUp;
+}
+
+/*
+ * Description: Put the register values of the model in the memory the program sees.
+ */
+static void Sim_publish(void)
+{
+	uint8 reg;
+	uint8 port;
+
+	for(port = 0; port < NUM_OF_PORTS; port++)
+	{
+		g_hw[SIM_PIN_REG(port)] = Sim_getPinLevels(port);
+	}
+
+	for(reg = 0; reg < SIM_REGISTER_COUNT; reg++)
+	{
+		g_published[reg] = g_hw[reg];
+	}
+	g_published[SIM_TIFR] |= SIM_WRITE_MARK;
+	g_published[SIM_TWCR] |= SIM_WRITE_MARK;
+	g_published[SIM_UDR] |= SIM_WRITE_MARK;
+	g_published[SIM_UCSRA] |= SIM_WRITE_MARK;
+
+	for(reg = 0; reg < SIM_REGISTER_COUNT; reg++)
+	{
+		g_io[reg] = g_published[reg];
+	}
+}
+
+/*
+ * Description: Input capture of Timer1 on the edges of ICP1 selected by ICES1.
+ */
+static void Sim_checkInputCapture(void)
+{
+	uint8 level = (Sim_getPinLevels(BOARD_PORT_ID(BOARD_ICU_ICP1)) >> BOARD_PIN_ID(BOARD_ICU_ICP1)) & 0x01;
+	uint8 risingSelected = (g_hw[SIM_TCCR1B] >> ICES1) & 0x01;
+
+	if(level != g_icpLevel)
+	{
+		g_icpLevel = level;
+		if(level == risingSelected)
+		{
+			g_hw[SIM_ICR1] = g_hw[SIM_TCNT1];
+			g_hw[SIM_TIFR] |= (1<<ICF1);
+		}
+	}
+}
+
+/*
+ * Description: Tell the models about the pins the MCU drives if they changed.
+ */
+static void Sim_outputsChanged(void)
+{
+	boolean changed = FALSE;
+	uint8 port;
+
+	for(port = 0; port < NUM_OF_PORTS; port++)
+	{
+		if((Sim_getPortOutput(port) != g_lastOutput[port]) || (Sim_getPortDirection(port) != g_lastDirection[port]))
+		{
+			g_lastOutput[port] = Sim_getPortOutput(port);
+			g_lastDirection[port] = Sim_getPortDirection(port);
+			changed = TRUE;
+		}
+	}
+
+	if(changed == TRUE)
+	{
+		Sim_hcsr04PinsChanged();
+		Sim_hd44780PinsChanged();
+		Sim_checkInputCapture(); /* A direction change may change ICP1 too */
+	}
+}
+
+/*
+ * Description: Action of the compare output mode on the OC1A latch, by a compare match or FOC1A.
+ */
+static void Sim_compareOutputA(void)
+{
+	switch(SIM_COM1A(g_hw[SIM_TCCR1A]))
+	{
+	case 1: g_oc1a ^= 1; break; /* Toggle */
+	case 2: g_oc1a = 0; break;  /* Clear */
+	case 3: g_oc1a = 1; break;  /* Set */
+	default: break;
+	}
+	Sim_outputsChanged();
+}
+
+/*
+ * Description: CPU cycles of one character of the USART: start bit, data bits, parity and stop bits.
+ */
+static uint32 Sim_uartCharacterCycles(void)
+{
+	uint8 ucsrc = (uint8)g_hw[SIM_UCSRC];
+	uint32 bits = 1 + 5 + ((ucsrc >> UCSZ0) & 0x03) + ((ucsrc & (1<<UPM1)) ? 1 : 0) + ((ucsrc & (1<<USBS)) ? 2 : 1);
+	uint32 ubrr = (((uint32)g_hw[SIM_UBRRH] & 0x0F) << 8) | (uint8)g_hw[SIM_UBRRL];
+
+	if((g_hw[SIM_UCSRB] & (1<<UCSZ2)) != 0)
+	{
+		bits += 4; /* 9-bit data */
+	}
+	return bits * (((g_hw[SIM_UCSRA] & (1<<U2X)) != 0) ? 8UL : 16UL) * (ubrr + 1);
+}
+
+static void Sim_uartShiftDone(uint8 arg);
+
+static void Sim_uartStartShift(uint8 data)
+{
+	g_uartShift = data;
+	g_uartShifting = TRUE;
+	Sim_schedule(g_cycles + Sim_uartCharacterCycles(), Sim_uartShiftDone, 0);
+}
+
+/*
+ * Description: The stop bit of the character is out, the receiver gets it and the next byte of UDR starts.
+ */
+static void Sim_uartShiftDone(uint8 arg)
+{
+	(void)arg;
+
+	if(g_uartReceivePtr != NULL)
+	{
+		g_uartReceivePtr(g_uartShift);
+	}
+
+	if((g_hw[SIM_UCSRA] & (1<<UDRE)) == 0)
+	{
+		g_hw[SIM_UCSRA] |= (1<<UDRE); /* UDR moves to the shift register */
+		Sim_uartStartShift(g_uartBuffer);
+	}
+	else
+	{
+		g_uartShifting = FALSE;
+		g_hw[SIM_UCSRA] |= (1<<TXC);
+	}
+}
+
+/*
+ * Description: CPU cycles of one SCL period: F_CPU / (16 + 2 * TWBR * 4^TWPS).
+ */
+static uint32 Sim_twiBitCycles(void)
+{
+	return 16UL + (2UL * (uint8)g_hw[SIM_TWBR] * (1UL << (2 * (g_hw[SIM_TWSR] & SIM_TWSR_PRESCALER))));
+}
+
+static void Sim_twiDone(uint8 arg);
+
+static void Sim_twiBegin(Sim_TwiActionType action, uint8 bits)
+{
+	g_twiPending = action;
+	g_twiActive = TRUE;
+	Sim_schedule(g_cycles + ((uint64)bits * Sim_twiBitCycles()), Sim_twiDone, g_twiAction);
+}
+
+/*
+ * Description: End of an action with a status code, TWINT is set and SCL is held low until the program clears it.
+ */
+static void Sim_twiStatus(uint8 status)
+{
+	g_hw[SIM_TWSR] = (g_hw[SIM_TWSR] & SIM_TWSR_PRESCALER) | status;
+	g_hw[SIM_TWCR] |= (1<<TWINT);
+}
+
+/*
+ * Description: The action on the bus is over, the slave answered the byte with an ACK or a NACK.
+ */
+static void Sim_twiDone(uint8 arg)
+{
+	uint8 data = (uint8)g_hw[SIM_TWDR];
+	boolean ack = FALSE;
+
+	if(arg != g_twiAction)
+	{
+		return; /* The TWI was disabled while the action ran */
+	}
+	g_twiActive = FALSE;
+
+	switch(g_twiPending)
+	{
+	case SIM_TWI_ACTION_START:
+		Sim_twiStatus((g_twiBusOwner == TRUE) ? SIM_TWI_REPEATED_START : SIM_TWI_START);
+		g_twiBusOwner = TRUE;
+		g_twiAddressPhase = TRUE;
+		g_twiAddressed = FALSE;
+		break;
+
+	case SIM_TWI_ACTION_STOP:
+		g_hw[SIM_TWCR] &= (uint8)~(1<<TWSTO);
+		g_hw[SIM_TWSR] = (g_hw[SIM_TWSR] & SIM_TWSR_PRESCALER) | SIM_TWI_NO_STATE;
+		g_twiBusOwner = FALSE;
+		g_twiAddressed = FALSE;
+		if(g_twiStartAfterStop == TRUE)
+		{
+			g_twiStartAfterStop = FALSE;
+			Sim_twiBegin(SIM_TWI_ACTION_START, 1);
+		}
+		break;
+
+	default:
+		if(g_twiAddressPhase == TRUE)
+		{
+			g_twiAddressPhase = FALSE;
+			if((data & 0x01) != 0)
+			{
+				Sim_fail("the TWI master receiver is not modelled", "");
+			}
+			if((g_twiReceivePtr != NULL) && ((data >> 1) == g_twiSlaveAddress))
+			{
+				ack = g_twiReceivePtr(data, TRUE);
+			}
+			g_twiAddressed = ack;
+			Sim_twiStatus((ack == TRUE) ? SIM_TWI_SLA_W_ACK : SIM_TWI_SLA_W_NACK);
+		}
+		else
+		{
+			if(g_twiAddressed == TRUE)
+			{
+				ack = g_twiReceivePtr(data, FALSE);
+			}
+			Sim_twiStatus((ack == TRUE) ? SIM_TWI_DATA_ACK : SIM_TWI_DATA_NACK); /* Nobody answers a byte after a NACK of the address */
+		}
+		break;
+	}
+}
+
+/*
+ * Description: Write of TWCR, writing one to TWINT clears it and starts the action of TWSTA, TWSTO or TWDR.
+ */
+static void Sim_twiControl(uint8 value)
+{
+	uint8 control = (uint8)g_hw[SIM_TWCR];
+
+	if((value & (1<<TWEN)) == 0)
+	{
+		/* Disabling the TWI ends the transfer and releases the bus at once */
+		g_hw[SIM_TWCR] = value & (uint8)~(SIM_TWCR_STATUS | (1<<TWSTO));
+		g_hw[SIM_TWSR] = (g_hw[SIM_TWSR] & SIM_TWSR_PRESCALER) | SIM_TWI_NO_STATE;
+		g_twiAction++;
+		g_twiActive = FALSE;
+		g_twiBusOwner = FALSE;
+		g_twiAddressed = FALSE;
+		g_twiStartAfterStop = FALSE;
+		return;
+	}
+
+	/* TWSTO is cleared by the hardware when the STOP is on the bus */
+	g_hw[SIM_TWCR] = (value & (uint8)~(SIM_TWCR_STATUS | (1<<TWSTO))) | (control & (SIM_TWCR_STATUS | (1<<TWSTO)));
+	if((value & (1<<TWINT)) == 0)
+	{
+		return;
+	}
+
+	if((g_twiActive == TRUE) || ((control & (1<<TWSTO)) != 0))
+	{
+		Sim_fail("TWINT written while the TWI action runs", "");
+	}
+	g_hw[SIM_TWCR] &= (uint8)~SIM_TWCR_STATUS;
+
+	if(((value & (1<<TWSTO)) != 0) && (g_twiBusOwner == TRUE))
+	{
+		g_hw[SIM_TWCR] |= (1<<TWSTO);
+		g_twiStartAfterStop = ((value & (1<<TWSTA)) != 0) ? TRUE : FALSE;
+		Sim_twiBegin(SIM_TWI_ACTION_STOP, 1);
+	}
+	else if((value & (1<<TWSTA)) != 0)
+	{
+		Sim_twiBegin(SIM_TWI_ACTION_START, 1);
+	}
+	else if((value & (1<<TWSTO)) != 0)
+	{
+		/* STOP without the bus, nothing goes on the bus */
+	}
+	else if(g_twiBusOwner == TRUE)
+	{
+		Sim_twiBegin(SIM_TWI_ACTION_BYTE, 9); /* 8 bits and the acknowledge */
+	}
+	else
+	{
+		Sim_fail("TWDR sent without a START condition", "");
+	}
+}
+
+/*
+ * Description: Give one value the program wrote to the model of the register.
+ */
+static void Sim_write(Sim_RegisterType reg, uint16 value)
+{
+	switch(reg)
+	{
+	case SIM_PINA: case SIM_PINB: case SIM_PINC: case SIM_PIND:
+		break; /* Read only on the ATmega16 */
+
+	case SIM_DDRA: case SIM_DDRB: case SIM_DDRC: case SIM_DDRD:
+	case SIM_PORTA: case SIM_PORTB: case SIM_PORTC: case SIM_PORTD:
+		g_hw[reg] = (uint8)value;
+		Sim_outputsChanged();
+		break;
+
+	case SIM_TIFR:
+		g_hw[SIM_TIFR] &= (uint8)~value; /* Flags are cleared by writing one */
+		break;
+
+	case SIM_TCCR0:
+		if((value & (1<<WGM00)) != 0)
+		{
+			Sim_fail("Timer0 PWM modes are not modelled", "");
+		}
+		if(((value & 0x07) == 6) || ((value & 0x07) == 7))
+		{
+			Sim_fail("Timer0 external clock is not modelled", "");
+		}
+		g_hw[reg] = (uint8)value & (uint8)~(1<<FOC0);
+		break;
+
+	case SIM_TCCR1A:
+		if((value & ((1<<WGM11) | (1<<WGM10))) != 0)
+		{
+			Sim_fail("Timer1 runs in the normal mode only in the model", "");
+		}
+		g_hw[reg] = (uint8)value & (uint8)~SIM_TCCR1A_FOC;
+		if((value & (1<<FOC1A)) != 0)
+		{
+			Sim_compareOutputA(); /* Forced compare: the output action without the flag */
+		}
+		Sim_outputsChanged(); /* OC1A may be connected or disconnected */
+		break;
+
+	case SIM_TCCR1B:
+		if((value & ((1<<WGM13) | (1<<WGM12))) != 0)
+		{
+			Sim_fail("Timer1 runs in the normal mode only in the model", "");
+		}
+		if(((value & 0x07) == 6) || ((value & 0x07) == 7))
+		{
+			Sim_fail("Timer1 external clock is not modelled", "");
+		}
+		g_hw[reg] = (uint8)value;
+		break;
+
+	case SIM_TCNT1: case SIM_OCR1A: case SIM_OCR1B: case SIM_ICR1:
+		g_hw[reg] = value;
+		break;
+
+	case SIM_UDR:
+		g_hw[reg] = (uint8)value;
+		if((g_hw[SIM_UCSRB] & (1<<TXEN)) == 0)
+		{
+			break; /* The transmitter is disabled, nothing is sent */
+		}
+		if((g_hw[SIM_UCSRA] & (1<<UDRE)) == 0)
+		{
+			Sim_fail("UDR written while UDRE is clear, the byte in UDR is lost", "");
+		}
+		if(g_uartShifting == FALSE)
+		{
+			Sim_uartStartShift((uint8)value);
+		}
+		else
+		{
+			g_uartBuffer = (uint8)value;
+			g_hw[SIM_UCSRA] &= (uint8)~(1<<UDRE);
+		}
+		break;
+
+	case SIM_UCSRA:
+		/* U2X and MPCM are written, TXC is cleared by writing one and the other bits are status */
+		g_hw[reg] = (g_hw[reg] & (uint8)~((1<<U2X) | (1<<MPCM) | (value & (1<<TXC)))) | (value & ((1<<U2X) | (1<<MPCM)));
+		break;
+
+	case SIM_UCSRB:
+		if((value & ((1<<RXEN) | (1<<RXCIE))) != 0)
+		{
+			Sim_fail("the USART receiver is not modelled", "");
+		}
+		g_hw[reg] = (uint8)value;
+		break;
+
+	case SIM_TWCR:
+		Sim_twiControl((uint8)value);
+		break;
+
+	case SIM_TWSR:
+		g_hw[reg] = (g_hw[reg] & (uint8)~SIM_TWSR_PRESCALER) | (value & SIM_TWSR_PRESCALER); /* The status is read only */
+		break;
+
+	case SIM_TWDR:
+		if((g_hw[SIM_TWCR] & (1<<TWINT)) == 0)
+		{
+			g_hw[SIM_TWCR] |= (1<<TWWC); /* Write collision, TWDR keeps the byte on the bus */
+		}
+		else
+		{
+			g_hw[reg] = (uint8)value;
+		}
+		break;
+
+	default:
+		g_hw[reg] = (uint8)value;
+		break;
+	}
+}
+
+/*
+ * Description: Give the writes the program did since the last access to the model and publish the registers.
+ */
+static void Sim_sync(void)
+{
+	uint8 reg;
+
+	for(reg = 0; reg < SIM_REGISTER_COUNT; reg++)
+	{
+		if(g_io[reg] != g_published[reg])
+		{
+			Sim_write((Sim_RegisterType)reg, g_io[reg]);
+		}
+	}
+	Sim_publish();
+}
+
+static void Sim_runEvents(void)
+{
+	Sim_EventType event;
+	uint8 i;
+
+	for(;;)
+	{
+		/* Take the earliest due event out of the list before its handler schedules new ones */
+		uint8 first = g_eventCount;
+
+		for(i = 0; i < g_eventCount; i++)
+		{
+			if((g_events[i].cycle <= g_cycles) && ((first == g_eventCount) || (g_events[i].cycle < g_events[first].cycle)))
+			{
+				first = i;
+			}
+		}
+		if(first == g_eventCount)
+		{
+			break;
+		}
+
+		event = g_events[first];
+		g_events[first] = g_events[g_eventCount - 1];
+		g_eventCount--;
+		event.handler_ptr(event.arg);
+	}
+
+	g_nextEvent = SIM_NO_EVENT;
+	for(i = 0; i < g_eventCount; i++)
+	{
+		if(g_events[i].cycle < g_nextEvent)
+		{
+			g_nextEvent = g_events[i].cycle;
+		}
+	}
+}
+
+static void Sim_timer0Tick(void)
+{
+	uint8 count = (uint8)g_hw[SIM_TCNT0];
+
+	if((g_hw[SIM_TCCR0] & (1<<WGM01)) != 0)
+	{
+		count = (count == (uint8)g_hw[SIM_OCR0]) ? 0 : (uint8)(count + 1); /* CTC: cleared after the match */
+	}
+	else
+	{
+		count++;
+		if(count == 0)
+		{
+			g_hw[SIM_TIFR] |= (1<<TOV0);
+		}
+	}
+	g_hw[SIM_TCNT0] = count;
+
+	if(count == (uint8)g_hw[SIM_OCR0])
+	{
+		g_hw[SIM_TIFR] |= (1<<OCF0);
+	}
+}
+
+static void Sim_timer1Tick(void)
+{
+	uint16 count = (uint16)(g_hw[SIM_TCNT1] + 1);
+
+	g_hw[SIM_TCNT1] = count;
+	if(count == 0)
+	{
+		g_hw[SIM_TIFR] |= (1<<TOV1);
+	}
+	if(count == g_hw[SIM_OCR1A])
+	{
+		g_hw[SIM_TIFR] |= (1<<OCF1A);
+		Sim_compareOutputA();
+	}
+	if(count == g_hw[SIM_OCR1B])
+	{
+		g_hw[SIM_TIFR] |= (1<<OCF1B);
+	}
+}
+
+/*
+ * Description: One CPU cycle of the timers and the events of the models.
+ */
+static void Sim_step(void)
+{
+	uint16 divider;
+
+	g_cycles++;
+
+	divider = g_prescaler[g_hw[SIM_TCCR0] & 0x07];
+	if((divider != 0) && ((g_cycles & (divider - 1)) == 0))
+	{
+		Sim_timer0Tick();
+	}
+
+	divider = g_prescaler[g_hw[SIM_TCCR1B] & 0x07];
+	if((divider != 0) && ((g_cycles & (divider - 1)) == 0))
+	{
+		Sim_timer1Tick();
+	}
+
+	if(g_cycles >= g_nextEvent)
+	{
+		Sim_runEvents();
+	}
+}
+
+/*
+ * Description: Take the interrupt of the highest priority if SREG.I is set, as the AVR does between two instructions.
+ */
+static void Sim_checkInterrupts(void)
+{
+	uint8 pending;
+	uint8 i;
+
+	if((g_hw[SIM_SREG] & SIM_SREG_I) == 0)
+	{
+		return;
+	}
+
+	if((((uint8)g_hw[SIM_TIFR] & (uint8)g_hw[SIM_TIMSK]) == 0) && (((uint8)g_hw[SIM_UCSRA] & (uint8)g_hw[SIM_UCSRB]) == 0) &&
+			((g_hw[SIM_TWCR] & ((1<<TWINT) | (1<<TWIE))) != ((1<<TWINT) | (1<<TWIE))))
+	{
+		return;
+	}
+
+	for(i = 0; i < (sizeof(g_vectors) / sizeof(g_vectors[0])); i++)
+	{
+		if(((g_hw[g_vectors[i].flag_reg] & g_vectors[i].flag) != 0) && ((g_hw[g_vectors[i].enable_reg] & g_vectors[i].enable) != 0))
+		{
+			if(g_vectors[i].vector_ptr == NULL)
+			{
+				Sim_fail("enabled interrupt without ISR: ", g_vectors[i].name); /* The AVR would jump to the reset vector */
+			}
+
+			if(g_vectors[i].level == FALSE)
+			{
+				g_hw[g_vectors[i].flag_reg] &= (uint8)~g_vectors[i].flag; /* The hardware clears the flag when the vector is taken */
+			}
+			g_hw[SIM_SREG] &= (uint8)~SIM_SREG_I;
+			for(pending = 0; pending < SIM_ISR_CYCLES; pending++)
+			{
+				Sim_step();
+			}
+			Sim_publish();
+
+			g_isrDepth++;
+			g_vectors[i].vector_ptr();
+			g_isrDepth--;
+
+			Sim_sync(); /* The last write of the ISR */
+			g_hw[SIM_SREG] |= SIM_SREG_I; /* RETI */
+			Sim_publish();
+			return;
+		}
+	}
+}
+
+/*
+ * Description: Run the required number of CPU cycles of the current code, the interrupts run in between.
+ */
+static void Sim_run(uint32 cycles)
+{
+	while(cycles != 0)
+	{
+		Sim_step();
+		cycles--;
+		Sim_checkInterrupts();
+	}
+}
+
+static void Sim_checkStop(void)
+{
+	g_progress++;
+	if((g_running == TRUE) && (g_cycles >= g_stopCycle))
+	{
+		longjmp(g_stopJump, 1);
+	}
+}
+
+static void Sim_watchdog(int signal_num)
+{
+	(void)signal_num;
+
+	if(g_progress != g_lastProgress)
+	{
+		g_lastProgress = g_progress;
+		g_stuckSeconds = 0;
+	}
+	else if(++g_stuckSeconds >= SIM_STUCK_SECONDS)
+	{
+		static const char message[] = "sim: the program polls memory without a register access or a function call,"
+				" the simulated time does not advance (see sim.h)\n";
+		(void)write(2, message, sizeof(message) - 1);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+static void Sim_setWatchdog(boolean enable)
+{
+	struct itimerval timer;
+
+	memset(&timer, 0, sizeof(timer));
+	if(enable == TRUE)
+	{
+		timer.it_interval.tv_sec = 1;
+		timer.it_value.tv_sec = 1;
+		signal(SIGALRM, Sim_watchdog);
+	}
+	g_stuckSeconds = 0;
+	setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description: Function to reset the MCU model: registers, timers, pins, events and the time.
+ * The models of the external parts are reset by their own init functions.
+ */
+void Sim_init(void)
+{
+	uint8 port;
+
+	memset(g_hw, 0, sizeof(g_hw));
+	g_hw[SIM_TWSR] = 0xF8;  /* Reset values that are not zero */
+	g_hw[SIM_TWDR] = 0xFF;
+	g_hw[SIM_UCSRA] = (1<<UDRE);
+	g_hw[SIM_UCSRC] = (1<<URSEL) | (1<<UCSZ1) | (1<<UCSZ0);
+
+	for(port = 0; port < NUM_OF_PORTS; port++)
+	{
+		g_inputMask[port] = 0;
+		g_inputValue[port] = 0;
+		g_lastOutput[port] = 0;
+		g_lastDirection[port] = 0;
+	}
+
+	g_cycles = 0;
+	g_oc1a = 0;
+	g_icpLevel = 0;
+	g_eventCount = 0;
+	g_nextEvent = SIM_NO_EVENT;
+	g_isrDepth = 0;
+	g_uartShifting = FALSE;
+	g_uartReceivePtr = NULL;
+	g_twiBusOwner = FALSE;
+	g_twiAddressPhase = FALSE;
+	g_twiAddressed = FALSE;
+	g_twiActive = FALSE;
+	g_twiStartAfterStop = FALSE;
+	g_twiAction++;
+	g_twiReceivePtr = NULL;
+	Sim_publish();
+}
+
+/*
+ * Description: Function to get the address of the memory of a register, used by host/avr/io.h only.
+ * The writes done since the last access are given to the model and the time of one access passes.
+ */
+volatile void * Sim_io(Sim_RegisterType reg)
+{
+	Sim_sync();
+	Sim_run(SIM_ACCESS_CYCLES);
+	Sim_publish();
+	Sim_checkStop();
+	return &g_io[reg];
+}
+
+/*
+ * Description: Function to run the program for the required number of CPU cycles, used by _delay_us and _delay_ms.
+ * The interrupts that come in this time are taken and do not shorten the delay.
+ */
+void Sim_delayCycles(uint32 cycles)
+{
+	Sim_sync();
+	Sim_run(cycles);
+	Sim_publish();
+	Sim_checkStop();
+}
+
+/*
+ * Description: Function to get the CPU cycles since Sim_init.
+ */
+uint64 Sim_getCycles(void)
+{
+	return g_cycles;
+}
+
+/*
+ * Description: Function to call the entry function of a program until it returns or the required number of
+ * CPU cycles passed. Return FALSE if the time ran out before the entry function returned.
+ * The program may be stopped inside any function or interrupt, the drivers should be initialized again before
+ * they are used in another run.
+ */
+boolean Sim_runProgram(void (*entry_ptr)(void), uint64 cycles)
+{
+	volatile boolean completed = FALSE;
+
+	g_stopCycle = g_cycles + cycles;
+	g_isrDepth = 0;
+	g_running = TRUE;
+	Sim_setWatchdog(TRUE);
+
+	if(setjmp(g_stopJump) == 0)
+	{
+		entry_ptr();
+		completed = TRUE;
+	}
+	else if(g_isrDepth != 0)
+	{
+		g_isrDepth = 0;
+		g_hw[SIM_SREG] |= SIM_SREG_I; /* Stopped inside an ISR, do its RETI */
+		Sim_publish();
+	}
+
+	Sim_setWatchdog(FALSE);
+	g_running = FALSE;
+	return completed;
+}
+
+/*
+ * Description: Function to call the handler with the argument when the required cycle comes.
+ */
+void Sim_schedule(uint64 cycle, Sim_EventHandlerType handler_ptr, uint8 arg)
+{
+	if(g_eventCount == SIM_MAX_EVENTS)
+	{
+		Sim_fail("too many scheduled events, increase SIM_MAX_EVENTS", "");
+	}
+
+	g_events[g_eventCount].cycle = cycle;
+	g_events[g_eventCount].handler_ptr = handler_ptr;
+	g_events[g_eventCount].arg = arg;
+	g_eventCount++;
+
+	if(cycle < g_nextEvent)
+	{
+		g_nextEvent = cycle;
+	}
+}
+
+/*
+ * Description: Function to get the levels the MCU drives on the pins of a port, pins that are inputs read as 0.
+ * The levels come from PORTx or from the compare output of Timer1 on OC1A.
+ */
+uint8 Sim_getPortOutput(uint8 port_num)
+{
+	uint8 direction = (uint8)g_hw[SIM_DDR_REG(port_num)];
+	uint8 output = (uint8)g_hw[SIM_PORT_REG(port_num)];
+
+	if((port_num == BOARD_PORT_ID(BOARD_ICU_OC1A)) && (SIM_COM1A(g_hw[SIM_TCCR1A]) != 0))
+	{
+		/* The compare output overrides PORTx while COM1A is not zero */
+		output = (output & (uint8)~(1 << BOARD_PIN_ID(BOARD_ICU_OC1A))) | (uint8)(g_oc1a << BOARD_PIN_ID(BOARD_ICU_OC1A));
+	}
+
+	return output & direction;
+}
+
+/*
+ * Description: Function to get the pins of a port that are outputs (DDRx).
+ */
+uint8 Sim_getPortDirection(uint8 port_num)
+{
+	return (uint8)g_hw[SIM_DDR_REG(port_num)];
+}
+
+/*
+ * Description: Function to drive the masked pins of a port from outside the MCU with the required levels.
+ * The other pins keep their drivers.
+ */
+void Sim_drivePins(uint8 port_num, uint8 mask, uint8 value)
+{
+	g_inputMask[port_num] |= mask;
+	g_inputValue[port_num] = (g_inputValue[port_num] & (uint8)~mask) | (value & mask);
+	Sim_checkInputCapture();
+}
+
+/*
+ * Description: Function to stop driving the masked pins of a port from outside, they read as the pull-up or 0.
+ */
+void Sim_releasePins(uint8 port_num, uint8 mask)
+{
+	g_inputMask[port_num] &= (uint8)~mask;
+	Sim_checkInputCapture();
+}
+
+/*
+ * Description: Function to connect the receiver of the TXD line, it gets every character at the end of its stop bit.
+ */
+void Sim_uartConnect(void (*receive_ptr)(uint8 data))
+{
+	g_uartReceivePtr = receive_ptr;
+}
+
+/*
+ * Description: Function to connect the slave of the TWI bus, it answers the SLA+W of its 7-bit address.
+ * The receive function gets the SLA+W (first is TRUE) and the data bytes that follow it and returns TRUE for an ACK.
+ */
+void Sim_twiConnect(uint8 address, boolean (*receive_ptr)(uint8 data, boolean first))
+{
+	g_twiSlaveAddress = address;
+	g_twiReceivePtr = receive_ptr;
+}
+
+/*
+ * Description: Function entry hook of -finstrument-functions, the time of a call passes.
+ */
+void __cyg_profile_func_enter(void * function_ptr, void * call_site_ptr) __attribute__((no_instrument_function));
+void __cyg_profile_func_enter(void * function_ptr, void * call_site_ptr)
+{
+	(void)function_ptr;
+	(void)call_site_ptr;
+
+	Sim_sync();
+	Sim_run(SIM_CALL_CYCLES);
+	Sim_publish();
+	Sim_checkStop();
+}
+
+void __cyg_profile_func_exit(void * function_ptr, void * call_site_ptr) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void * function_ptr, void * call_site_ptr)
+{
+	(void)function_ptr;
+	(void)call_site_ptr;
+}
@@ -0,0 +1,198 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: sim.h
+ *
+ * Discretion: Header file of the ATmega16 peripheral model used to run the drivers on a PC
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef SIM_H_
+#define SIM_H_
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "std_types.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/*
+ * The host build replaces <avr/io.h> by host/avr/io.h, every register name is an access through Sim_io.
+ * Sim_io hands out the register memory and the model looks at it again on the next access:
+ * a value the program changed is a write and is given to the peripheral model, then the model
+ * runs the CPU time of the access and puts the new register values in the memory.
+ *
+ * The simulated time is not cycle accurate, it advances by fixed costs only:
+ * every register access, every function call of the drivers (-finstrument-functions),
+ * every interrupt entry and every _delay_us/_delay_ms. The cycles of the AVR code itself
+ * are measured on the AVR simulator (see the benchmark of the Debug build), this model is for
+ * the behaviour of the drivers and the rates that depend on the peripherals.
+ *
+ * Limitations:
+ * 	1. A write of the value a register already has is not seen, the registers with side effects on
+ * 	   such writes (TIFR, TWCR, UDR and UCSRA) are 16-bit in the model with 0xFF in the upper byte, so any write is seen.
+ * 	2. A loop that polls a variable written by an interrupt without calling a function or reading
+ * 	   a register does not advance the time, Sim_runProgram stops the program if that happens.
+ * 	   The drivers put POLL_WAIT() (common_macros.h) in the body of such loops, it runs SIM_POLL_CYCLES here.
+ * 	3. Timer1 runs in the normal mode only and Timer0 in the normal and the CTC modes.
+ * 	   The TWI runs in the master transmitter mode only, the USART receiver registers exist but are not modelled.
+ * 	4. A TWI bit takes one SCL period of TWBR and TWPS, the START and the STOP conditions take one bit each
+ * 	   and the slaves never stretch SCL.
+ */
+#define SIM_ACCESS_CYCLES			2  /* Register access (LDS/STS with the address calculation) */
+#define SIM_CALL_CYCLES				16 /* CALL, RET and the prologue and epilogue of a function */
+#define SIM_ISR_CYCLES				20 /* Interrupt response, vector jump and the register saving of an ISR */
+#define SIM_POLL_CYCLES				4  /* LDS, CP and the branch of one pass of a polling loop */
+
+/* Seconds of host time without any simulated time before the program is taken as stuck */
+#define SIM_STUCK_SECONDS			2
+
+/* Number of events the models can schedule at the same time */
+#define SIM_MAX_EVENTS				16
+
+#define SIM_US_TO_CYCLES(us)		((uint64)(us) * (F_CPU / 1000000UL))
+#define SIM_CYCLES_TO_US(cycles)	((cycles) / (F_CPU / 1000000UL))
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+/* Registers of the ATmega16 in the model */
+typedef enum{
+	SIM_PINA, SIM_DDRA, SIM_PORTA,
+	SIM_PINB, SIM_DDRB, SIM_PORTB,
+	SIM_PINC, SIM_DDRC, SIM_PORTC,
+	SIM_PIND, SIM_DDRD, SIM_PORTD,
+	SIM_SREG, SIM_TIMSK, SIM_TIFR, SIM_GICR,
+	SIM_TCCR0, SIM_TCNT0, SIM_OCR0,
+	SIM_TCCR1A, SIM_TCCR1B, SIM_TCNT1, SIM_OCR1A, SIM_OCR1B, SIM_ICR1,
+	SIM_TWBR, SIM_TWSR, SIM_TWAR, SIM_TWDR, SIM_TWCR,
+	SIM_UDR, SIM_UCSRA, SIM_UCSRB, SIM_UCSRC, SIM_UBRRH, SIM_UBRRL,
+	SIM_REGISTER_COUNT
+}Sim_RegisterType;
+
+/* Handler of a scheduled event, the argument is given to Sim_schedule */
+typedef void (*Sim_EventHandlerType)(uint8 arg);
+
+/*******************************************************************************
+ *                         	Function Prototypes                                *
+ *******************************************************************************/
+/*
+ * Description: Function to reset the MCU model: registers, timers, pins, events and the time.
+ * The models of the external parts are reset by their own init functions.
+ */
+void Sim_init(void);
+
+/*
+ * Description: Function to get the address of the memory of a register, used by host/avr/io.h only.
+ * The writes done since the last access are given to the model and the time of one access passes.
+ */
+volatile void * Sim_io(Sim_RegisterType reg);
+
+/*
+ * Description: Function to run the program for the required number of CPU cycles, used by _delay_us and _delay_ms.
+ * The interrupts that come in this time are taken and do not shorten the delay.
+ */
+void Sim_delayCycles(uint32 cycles);
+
+/*
+ * Description: Function to get the CPU cycles since Sim_init.
+ */
+uint64 Sim_getCycles(void);
+
+/*
+ * Description: Function to call the entry function of a program until it returns or the required number of
+ * CPU cycles passed. Return FALSE if the time ran out before the entry function returned.
+ * The program may be stopped inside any function or interrupt, the drivers should be initialized again before
+ * they are used in another run.
+ */
+boolean Sim_runProgram(void (*entry_ptr)(void), uint64 cycles);
+
+/*
+ * Description: Function to call the handler with the argument when the required cycle comes.
+ */
+void Sim_schedule(uint64 cycle, Sim_EventHandlerType handler_ptr, uint8 arg);
+
+/*
+ * Description: Function to get the levels the MCU drives on the pins of a port, pins that are inputs read as 0.
+ * The levels come from PORTx or from the compare output of Timer1 on OC1A.
+ */
+uint8 Sim_getPortOutput(uint8 port_num);
+
+/*
+ * Description: Function to get the pins of a port that are outputs (DDRx).
+ */
+uint8 Sim_getPortDirection(uint8 port_num);
+
+/*
+ * Description: Function to drive the masked pins of a port from outside the MCU with the required levels.
+ * The other pins keep their drivers.
+ */
+void Sim_drivePins(uint8 port_num, uint8 mask, uint8 value);
+
+/*
+ * Description: Function to stop driving the masked pins of a port from outside, they read as the pull-up or 0.
+ */
+void Sim_releasePins(uint8 port_num, uint8 mask);
+
+/*
+ * Description: Function to connect the receiver of the TXD line, it gets every character at the end of its stop bit.
+ * Sim_init disconnects it.
+ */
+void Sim_uartConnect(void (*receive_ptr)(uint8 data));
+
+/*
+ * Description: Function to connect the slave of the TWI bus, it answers the SLA+W of its 7-bit address.
+ * The receive function gets the SLA+W (first is TRUE) and the data bytes that follow it and returns TRUE for an ACK.
+ * Sim_init disconnects it.
+ */
+void Sim_twiConnect(uint8 address, boolean (*receive_ptr)(uint8 data, boolean first));
+
+/*
+ * Description: Functions of the HC-SR04 model (sim_hcsr04.c), the sensors and their pins are taken from board_config.h.
+ * The distance function gives the distance in mm of every ping of a sensor, or SIM_HCSR04_NO_TARGET.
+ */
+#define SIM_HCSR04_NO_TARGET		0xFFFF
+void Sim_hcsr04Init(uint16 (*distance_ptr)(uint8 sensor, uint32 ping));
+void Sim_hcsr04PinsChanged(void);
+uint32 Sim_hcsr04GetPingCount(uint8 sensor);
+uint16 Sim_hcsr04GetLastDistance(uint8 sensor);
+
+/*
+ * Description: Functions of the HD44780 model (sim_hd44780.c), wired as lcd.h and board_config.h describe.
+ */
+typedef struct{
+	uint32 bytes;            /* Commands and characters written */
+	uint32 characters;       /* Characters written */
+	uint32 reads;            /* Busy flag and address counter reads */
+	uint32 busyWrites;       /* Bytes written while the LCD was busy */
+	uint32 timingViolations; /* Enable pulse, setup or cycle time shorter than the datasheet */
+	uint32 contentions;      /* The LCD drove the bus while the MCU pins were outputs */
+	uint32 minCyclesBetweenBytes; /* Shortest time from one byte to the next */
+}Sim_Hd44780StatsType;
+
+void Sim_hd44780Init(void);
+void Sim_hd44780PinsChanged(void);
+void Sim_hd44780GetStats(Sim_Hd44780StatsType * Stats_Ptr);
+void Sim_hd44780GetRow(uint8 row, char * string); /* LCD_COLS characters and the terminator */
+
+/*
+ * Description: Functions of the PCF8574 model (sim_pcf8574.c), the expander of the LCD backpack at LCD_PCF8574_ADDRESS
+ * (LCD_BACKEND_PCF8574), its pins drive the HD44780 model. Sim_pcf8574SetNacks makes it answer the next count
+ * acknowledgements with a NACK, and again after every "every" bytes it takes if every is not 0.
+ */
+typedef struct{
+	uint32 bytes; /* Bytes written to the pins */
+	uint32 nacks; /* Addresses and bytes answered with a NACK */
+}Sim_Pcf8574StatsType;
+
+void Sim_pcf8574Init(void);
+uint8 Sim_pcf8574GetPins(void);
+void Sim_pcf8574SetNacks(uint16 every, uint8 count);
+void Sim_pcf8574GetStats(Sim_Pcf8574StatsType * Stats_Ptr);
+
+#endif /* SIM_H_ */
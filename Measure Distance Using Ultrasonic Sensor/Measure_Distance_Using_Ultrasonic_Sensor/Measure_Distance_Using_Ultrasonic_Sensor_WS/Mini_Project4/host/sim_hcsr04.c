@@ -0,0 +1,215 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: sim_hcsr04.c
+ *
+ * Discretion: Model of the HC-SR04 ultrasonic sensors and of the echo multiplexer of the board
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "sim.h"
+#include "board_config.h"
+#include "ultrasonic.h" /* For the trigger mode and the multiplexer select bits */
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+#define SIM_HCSR04_TRIGGER_MIN_US	10    /* Shortest trigger pulse the sensor takes */
+#define SIM_HCSR04_BURST_US			460   /* Falling edge of the trigger to the rising edge of the echo (8 x 40 kHz and setup) */
+#define SIM_HCSR04_NO_ECHO_US		38000 /* Echo width when nothing reflects the burst */
+#define SIM_HCSR04_SOUND_SPEED		343000UL /* mm per second */
+
+/* Echo width in CPU cycles of a target at the distance in mm: 2 * distance / speed of sound */
+#define SIM_HCSR04_ECHO_CYCLES(mm)	(((uint64)(mm) * 2UL * F_CPU) / SIM_HCSR04_SOUND_SPEED)
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+typedef enum{
+	SIM_HCSR04_IDLE, SIM_HCSR04_BURST, SIM_HCSR04_ECHO
+}Sim_Hcsr04StateType;
+
+typedef struct{
+	uint8 trigger_port;
+	uint8 trigger_pin;
+	uint8 echo_select;
+	uint8 trigger;          /* Level of the trigger input */
+	uint64 triggerRise;     /* Cycle of the last rising edge of the trigger */
+	Sim_Hcsr04StateType state;
+	uint8 echo;             /* Level of the echo output */
+	uint16 distance;        /* Distance of the last ping */
+	uint32 pings;
+}Sim_Hcsr04Type;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+#define SIM_HCSR04_ENTRY(trigger_port, trigger_pin, echo_select, priority) \
+	{trigger_port, trigger_pin, echo_select, 0, 0, SIM_HCSR04_IDLE, 0, SIM_HCSR04_NO_TARGET, 0},
+
+/* Sensors of the board in the order of board_config.h */
+static Sim_Hcsr04Type g_sensors[ULTRASONIC_SENSOR_COUNT] = {
+	BOARD_ULTRASONIC_SENSORS(SIM_HCSR04_ENTRY)
+};
+static const Sim_Hcsr04Type g_sensorsReset[ULTRASONIC_SENSOR_COUNT] = {
+	BOARD_ULTRASONIC_SENSORS(SIM_HCSR04_ENTRY)
+};
+
+static uint16 (*g_distancePtr)(uint8 sensor, uint32 ping) = NULL_PTR;
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+/*
+ * Description: Channel the multiplexer select pins choose, 0 without a multiplexer.
+ */
+static uint8 Sim_hcsr04GetSelect(void)
+{
+#if (ULTRASONIC_MUX_SELECT_BITS > 0)
+	return (Sim_getPortOutput(ULTRASONIC_MUX_PORT_ID) >> ULTRASONIC_MUX_FIRST_PIN_ID) & ((1 << ULTRASONIC_MUX_SELECT_BITS) - 1);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Description: Put the echo of the selected sensor on ICP1.
+ */
+static void Sim_hcsr04RouteEcho(void)
+{
+	uint8 select = Sim_hcsr04GetSelect();
+	uint8 level = 0;
+	uint8 i;
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		if(g_sensors[i].echo_select == select)
+		{
+			level = g_sensors[i].echo;
+			break;
+		}
+	}
+
+	Sim_drivePins(BOARD_PORT_ID(BOARD_ICU_ICP1), (1 << BOARD_PIN_ID(BOARD_ICU_ICP1)),
+			(uint8)(level << BOARD_PIN_ID(BOARD_ICU_ICP1)));
+}
+
+static void Sim_hcsr04EchoEnd(uint8 sensor)
+{
+	g_sensors[sensor].echo = 0;
+	g_sensors[sensor].state = SIM_HCSR04_IDLE;
+	Sim_hcsr04RouteEcho();
+}
+
+static void Sim_hcsr04EchoStart(uint8 sensor)
+{
+	uint64 width;
+
+	if(g_sensors[sensor].distance == SIM_HCSR04_NO_TARGET)
+	{
+		width = SIM_US_TO_CYCLES(SIM_HCSR04_NO_ECHO_US);
+	}
+	else
+	{
+		width = SIM_HCSR04_ECHO_CYCLES(g_sensors[sensor].distance);
+	}
+
+	g_sensors[sensor].echo = 1;
+	g_sensors[sensor].state = SIM_HCSR04_ECHO;
+	Sim_hcsr04RouteEcho();
+	Sim_schedule(Sim_getCycles() + width, Sim_hcsr04EchoEnd, sensor);
+}
+
+/*
+ * Description: Level of the trigger input of the sensor.
+ * In ULTRASONIC_TRIGGER_HARDWARE mode OC1A reaches the selected sensor through the demultiplexer.
+ */
+static uint8 Sim_hcsr04GetTrigger(uint8 sensor)
+{
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+	if(g_sensors[sensor].echo_select != Sim_hcsr04GetSelect())
+	{
+		return 0;
+	}
+	return (Sim_getPortOutput(BOARD_PORT_ID(BOARD_ICU_OC1A)) >> BOARD_PIN_ID(BOARD_ICU_OC1A)) & 0x01;
+#else
+	return (Sim_getPortOutput(g_sensors[sensor].trigger_port) >> g_sensors[sensor].trigger_pin) & 0x01;
+#endif
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description: Function to reset the sensors, the distance function gives the distance in mm of every ping of a sensor.
+ */
+void Sim_hcsr04Init(uint16 (*distance_ptr)(uint8 sensor, uint32 ping))
+{
+	uint8 i;
+
+	g_distancePtr = distance_ptr;
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		g_sensors[i] = g_sensorsReset[i];
+	}
+	Sim_hcsr04RouteEcho();
+}
+
+/*
+ * Description: Function called by the MCU model when the MCU pins changed.
+ * A trigger pulse of at least 10 us sends the burst, the echo rises after it and is as wide as the
+ * sound needs to reach the target and come back. Triggers during a ping are ignored as the sensor does.
+ */
+void Sim_hcsr04PinsChanged(void)
+{
+	uint8 level;
+	uint8 i;
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		level = Sim_hcsr04GetTrigger(i);
+		if(level == g_sensors[i].trigger)
+		{
+			continue;
+		}
+
+		g_sensors[i].trigger = level;
+		if(level == 1)
+		{
+			g_sensors[i].triggerRise = Sim_getCycles();
+		}
+		else if((g_sensors[i].state == SIM_HCSR04_IDLE) &&
+				((Sim_getCycles() - g_sensors[i].triggerRise) >= SIM_US_TO_CYCLES(SIM_HCSR04_TRIGGER_MIN_US)))
+		{
+			g_sensors[i].distance = (g_distancePtr != NULL_PTR) ? g_distancePtr(i, g_sensors[i].pings) : SIM_HCSR04_NO_TARGET;
+			g_sensors[i].pings++;
+			g_sensors[i].state = SIM_HCSR04_BURST;
+			Sim_schedule(Sim_getCycles() + SIM_US_TO_CYCLES(SIM_HCSR04_BURST_US), Sim_hcsr04EchoStart, i);
+		}
+	}
+
+	Sim_hcsr04RouteEcho(); /* The multiplexer select may have changed */
+}
+
+/*
+ * Description: Function to get the number of pings the sensor sent.
+ */
+uint32 Sim_hcsr04GetPingCount(uint8 sensor)
+{
+	return g_sensors[sensor].pings;
+}
+
+/*
+ * Description: Function to get the distance in mm of the last ping the sensor sent,
+ * SIM_HCSR04_NO_TARGET if nothing reflects it.
+ */
+uint16 Sim_hcsr04GetLastDistance(uint8 sensor)
+{
+	return g_sensors[sensor].distance;
+}
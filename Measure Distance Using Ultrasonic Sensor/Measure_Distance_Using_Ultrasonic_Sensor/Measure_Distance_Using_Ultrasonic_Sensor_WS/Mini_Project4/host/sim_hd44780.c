@@ -0,0 +1,485 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: sim_hd44780.c
+ *
+ * Discretion: Model of the HD44780 LCD controller on the parallel bus or the PCF8574 expander, it checks the bus timing
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "sim.h"
+#include "lcd.h" /* For the LCD pins and the data bits mode */
+#include <stdio.h>
+#include <string.h>
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/* HD44780U datasheet values at VCC = 4.5 V to 5.5 V */
+#define SIM_HD44780_CYCLE_NS		500   /* Enable cycle time (tcycE) */
+#define SIM_HD44780_PULSE_NS		230   /* Enable pulse width high (PWEH) */
+#define SIM_HD44780_ADDRESS_NS		40    /* RS and R/W setup before E rises (tAS) */
+#define SIM_HD44780_DATA_SETUP_NS	80    /* Data setup before E falls (tDSW) */
+#define SIM_HD44780_DATA_DELAY_NS	160   /* Data valid after E rises when reading (tDDR) */
+#define SIM_HD44780_POWER_ON_US		15000 /* VCC rise to the first instruction */
+#define SIM_HD44780_EXECUTION_US	37
+#define SIM_HD44780_LONG_US			1520  /* Clear display and return home */
+#define SIM_HD44780_RESET_FIRST_US	4100  /* After the first function set of the initialization by instruction */
+#define SIM_HD44780_RESET_US		100   /* After the second function set */
+
+/* Number of problems written to stderr, the others are only counted */
+#define SIM_HD44780_REPORT_LIMIT	5
+
+#define SIM_CYCLES_TO_NS(cycles)	(((uint64)(cycles) * 1000000000ULL) / F_CPU)
+#define SIM_NS_TO_CYCLES(ns)		((((uint64)(ns) * F_CPU) + 999999999ULL) / 1000000000ULL)
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+/* The LCD lines are the expander pins, D4 --> D7 on P4 --> P7 */
+#define SIM_LCD_FIRST_PIN			4
+#define SIM_LCD_LINE(mask)			((Sim_pcf8574GetPins() & (mask)) ? 1 : 0)
+#define SIM_LCD_E()					SIM_LCD_LINE(LCD_PCF8574_E)
+#define SIM_LCD_RS()				SIM_LCD_LINE(LCD_PCF8574_RS)
+#define SIM_LCD_RW()				SIM_LCD_LINE(LCD_PCF8574_RW)
+#define SIM_LCD_DATA()				(Sim_pcf8574GetPins() & 0xF0)
+#else
+#if (LCD_DATA_BITS_MODE == 8)
+#define SIM_LCD_FIRST_PIN			0
+#else
+#define SIM_LCD_FIRST_PIN			LCD_FIRST_DATA_PIN_ID
+#endif
+
+#define SIM_LCD_PIN(port_num, pin_num)	((Sim_getPortOutput(port_num) >> (pin_num)) & 0x01)
+#define SIM_LCD_E()					SIM_LCD_PIN(LCD_E_PORT_ID, LCD_E_PIN_ID)
+#define SIM_LCD_RS()				SIM_LCD_PIN(LCD_RS_PORT_ID, LCD_RS_PIN_ID)
+#define SIM_LCD_RW()				SIM_LCD_PIN(LCD_RW_PORT_ID, LCD_RW_PIN_ID)
+#define SIM_LCD_DATA()				(Sim_getPortOutput(LCD_DATA_PORT_ID) & LCD_DATA_PINS_MASK)
+#endif
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static Sim_Hd44780StatsType g_stats;
+static uint8 g_ddram[128];
+static uint8 g_address = 0;          /* Address counter */
+static boolean g_cgram = FALSE;      /* The address counter points to the CGRAM */
+static boolean g_increment = TRUE;   /* I/D of the entry mode */
+static boolean g_twoLines = FALSE;   /* N of the function set */
+static boolean g_interface8 = TRUE;  /* DL of the function set, the LCD starts with the 8-bit interface */
+static boolean g_haveNibble = FALSE; /* The high nibble of a 4-bit transfer is received */
+#if (LCD_DATA_BITS_MODE == 4)
+static uint8 g_firstNibble = 0;      /* High nibble of the 4-bit transfer */
+#endif
+static boolean g_readLow = FALSE;    /* The next 4-bit read gives the low nibble */
+static uint8 g_functionSets = 0;     /* Function sets received since the power on */
+
+static uint64 g_powerOn = 0;
+static uint64 g_busyUntil = 0;
+static uint64 g_lastByte = 0;
+static boolean g_haveByte = FALSE;
+
+/* Bus lines as the LCD saw them last and the time they changed */
+static uint8 g_e = 0;
+static uint8 g_rs = 0;
+static uint8 g_rw = 0;
+static uint8 g_data = 0;
+static uint64 g_controlChange = 0;
+static uint64 g_dataChange = 0;
+static uint64 g_eRise = 0;
+static boolean g_read = FALSE; /* R/W was high when E rose, the LCD latches R/W and RS on the rising edge */
+static boolean g_eRoseBefore = FALSE;
+static boolean g_driving = FALSE;
+static uint32 g_reports = 0;
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+static void Sim_hd44780Report(const char * problem, uint64 value_ns)
+{
+	if(g_reports < SIM_HD44780_REPORT_LIMIT)
+	{
+		fprintf(stderr, "hd44780: %s (%llu ns) at %llu us\n", problem,
+				(unsigned long long)value_ns, (unsigned long long)SIM_CYCLES_TO_US(Sim_getCycles()));
+	}
+	g_reports++;
+}
+
+static void Sim_hd44780Busy(uint32 us)
+{
+	g_busyUntil = Sim_getCycles() + SIM_US_TO_CYCLES(us);
+}
+
+/*
+ * Description: Move the address counter after a data write, the DDRAM of the two lines mode has a gap.
+ */
+static void Sim_hd44780StepAddress(void)
+{
+	if(g_cgram == TRUE)
+	{
+		g_address = (g_address + (g_increment ? 1 : 0x3F)) & 0x3F;
+	}
+	else if(g_increment == TRUE)
+	{
+		g_address++;
+		if(g_twoLines == TRUE)
+		{
+			g_address = (g_address == 0x28) ? 0x40 : ((g_address == 0x68) ? 0x00 : g_address);
+		}
+		else if(g_address == 0x50)
+		{
+			g_address = 0x00;
+		}
+	}
+	else
+	{
+		if(g_twoLines == TRUE)
+		{
+			g_address = (g_address == 0x40) ? 0x27 : ((g_address == 0x00) ? 0x67 : (uint8)(g_address - 1));
+		}
+		else
+		{
+			g_address = (g_address == 0x00) ? 0x4F : (uint8)(g_address - 1);
+		}
+	}
+}
+
+static void Sim_hd44780Command(uint8 command)
+{
+	uint8 i;
+
+	Sim_hd44780Busy(SIM_HD44780_EXECUTION_US);
+
+	if((command & 0x80) != 0) /* Set DDRAM address */
+	{
+		g_address = command & 0x7F;
+		g_cgram = FALSE;
+	}
+	else if((command & 0x40) != 0) /* Set CGRAM address */
+	{
+		g_address = command & 0x3F;
+		g_cgram = TRUE;
+	}
+	else if((command & 0x20) != 0) /* Function set */
+	{
+		g_interface8 = ((command & 0x10) != 0) ? TRUE : FALSE;
+		g_twoLines = ((command & 0x08) != 0) ? TRUE : FALSE;
+		g_haveNibble = FALSE;
+		g_readLow = FALSE;
+		if(g_functionSets == 0)
+		{
+			Sim_hd44780Busy(SIM_HD44780_RESET_FIRST_US);
+		}
+		else if(g_functionSets == 1)
+		{
+			Sim_hd44780Busy(SIM_HD44780_RESET_US);
+		}
+		if(g_functionSets < 0xFF)
+		{
+			g_functionSets++;
+		}
+	}
+	else if((command & 0x10) != 0) /* Cursor or display shift */
+	{
+		if((command & 0x08) == 0)
+		{
+			boolean increment = g_increment;
+
+			g_increment = ((command & 0x04) != 0) ? TRUE : FALSE;
+			Sim_hd44780StepAddress(); /* Cursor move */
+			g_increment = increment;
+		}
+	}
+	else if((command & 0x04) != 0) /* Entry mode set */
+	{
+		g_increment = ((command & 0x02) != 0) ? TRUE : FALSE;
+	}
+	else if((command & 0x02) != 0) /* Return home */
+	{
+		g_address = 0;
+		g_cgram = FALSE;
+		Sim_hd44780Busy(SIM_HD44780_LONG_US);
+	}
+	else if(command == 0x01) /* Clear display */
+	{
+		for(i = 0; i < sizeof(g_ddram); i++)
+		{
+			g_ddram[i] = ' ';
+		}
+		g_address = 0;
+		g_cgram = FALSE;
+		g_increment = TRUE;
+		Sim_hd44780Busy(SIM_HD44780_LONG_US);
+	}
+	/* Display on/off control changes nothing the model shows */
+}
+
+/*
+ * Description: Execute one byte written to the LCD.
+ */
+static void Sim_hd44780Execute(uint8 rs, uint8 byte)
+{
+	uint64 now = Sim_getCycles();
+
+	g_stats.bytes++;
+	if(now < g_busyUntil)
+	{
+		g_stats.busyWrites++;
+		Sim_hd44780Report("byte written while the LCD is busy", SIM_CYCLES_TO_NS(g_busyUntil - now));
+	}
+	if((now - g_powerOn) < SIM_US_TO_CYCLES(SIM_HD44780_POWER_ON_US))
+	{
+		g_stats.timingViolations++;
+		Sim_hd44780Report("byte written before the power on time", SIM_CYCLES_TO_NS(now - g_powerOn));
+	}
+	if((g_haveByte == TRUE) && ((now - g_lastByte) < g_stats.minCyclesBetweenBytes))
+	{
+		g_stats.minCyclesBetweenBytes = (uint32)(now - g_lastByte);
+	}
+	g_haveByte = TRUE;
+	g_lastByte = now;
+
+	if(rs == 0)
+	{
+		Sim_hd44780Command(byte);
+	}
+	else
+	{
+		if(g_cgram == FALSE)
+		{
+			g_ddram[g_address & 0x7F] = byte;
+		}
+		Sim_hd44780StepAddress();
+		g_stats.characters++;
+		Sim_hd44780Busy(SIM_HD44780_EXECUTION_US);
+	}
+}
+
+#if (LCD_BACKEND == LCD_BACKEND_PARALLEL)
+/*
+ * Description: Put the busy flag and the address counter on the data pins, tDDR after E rises.
+ */
+static void Sim_hd44780DriveRead(uint8 arg)
+{
+	uint8 value = (uint8)(((Sim_getCycles() < g_busyUntil) ? 0x80 : 0x00) | (g_address & 0x7F));
+
+	(void)arg;
+	if((g_e == 0) || (g_rw == 0))
+	{
+		return; /* The read ended before the data was valid */
+	}
+
+	if((Sim_getPortDirection(LCD_DATA_PORT_ID) & LCD_DATA_PINS_MASK) != 0)
+	{
+		g_stats.contentions++;
+		Sim_hd44780Report("the LCD drives the data bus while the MCU pins are outputs", 0);
+	}
+
+#if (LCD_DATA_BITS_MODE == 4)
+	value = (g_readLow == TRUE) ? (uint8)(value & 0x0F) : (uint8)(value >> 4);
+#endif
+	Sim_drivePins(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK, (uint8)(value << SIM_LCD_FIRST_PIN));
+	g_driving = TRUE;
+}
+#endif
+
+static void Sim_hd44780Release(void)
+{
+	if(g_driving == TRUE)
+	{
+		Sim_releasePins(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK);
+		g_driving = FALSE;
+	}
+}
+
+/*
+ * Description: Latch the data pins on the falling edge of E.
+ */
+static void Sim_hd44780Latch(void)
+{
+	uint8 lines = (uint8)(SIM_LCD_DATA() >> SIM_LCD_FIRST_PIN);
+	uint8 byte;
+
+	if(g_read == TRUE)
+	{
+		Sim_hd44780Release();
+		g_stats.reads++;
+#if (LCD_DATA_BITS_MODE == 4)
+		if(g_interface8 == FALSE)
+		{
+			g_readLow = (g_readLow == TRUE) ? FALSE : TRUE;
+		}
+#endif
+		return;
+	}
+
+#if (LCD_DATA_BITS_MODE == 4)
+	/* Only D7-D4 are wired, D3-D0 read as 0 in the 8-bit interface */
+	if(g_interface8 == TRUE)
+	{
+		byte = (uint8)(lines << 4);
+	}
+	else if(g_haveNibble == FALSE)
+	{
+		g_firstNibble = lines;
+		g_haveNibble = TRUE;
+		return;
+	}
+	else
+	{
+		byte = (uint8)((g_firstNibble << 4) | lines);
+		g_haveNibble = FALSE;
+	}
+#else
+	byte = lines;
+#endif
+
+	Sim_hd44780Execute(g_rs, byte);
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description: Function to power on the LCD model now, the DDRAM is filled with spaces.
+ * The lines start at the levels they have now, the PCF8574 model should be powered on first.
+ */
+void Sim_hd44780Init(void)
+{
+	memset(&g_stats, 0, sizeof(g_stats));
+	g_stats.minCyclesBetweenBytes = 0xFFFFFFFFUL;
+	memset(g_ddram, ' ', sizeof(g_ddram));
+	g_address = 0;
+	g_cgram = FALSE;
+	g_increment = TRUE;
+	g_twoLines = FALSE;
+	g_interface8 = TRUE;
+	g_haveNibble = FALSE;
+	g_readLow = FALSE;
+	g_functionSets = 0;
+	g_powerOn = Sim_getCycles();
+	g_busyUntil = 0;
+	g_haveByte = FALSE;
+	g_e = SIM_LCD_E();
+	g_rs = SIM_LCD_RS();
+	g_rw = SIM_LCD_RW();
+	g_data = SIM_LCD_DATA();
+	g_controlChange = g_powerOn;
+	g_dataChange = g_powerOn;
+	g_eRise = g_powerOn;
+	g_read = ((g_e == 1) && (g_rw == 1)) ? TRUE : FALSE;
+	g_eRoseBefore = FALSE;
+	g_driving = FALSE;
+	g_reports = 0;
+#if (LCD_BACKEND == LCD_BACKEND_PARALLEL)
+	Sim_releasePins(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK);
+#endif
+}
+
+/*
+ * Description: Function called by the MCU model when the MCU pins changed and by the PCF8574 model when its pins changed.
+ */
+void Sim_hd44780PinsChanged(void)
+{
+	uint64 now = Sim_getCycles();
+	uint8 e = SIM_LCD_E();
+	uint8 rs = SIM_LCD_RS();
+	uint8 rw = SIM_LCD_RW();
+	uint8 data = SIM_LCD_DATA();
+
+	if((rs != g_rs) || (rw != g_rw))
+	{
+		/* The bus is not looked at during the internal reset, the PCF8574 starts with all its pins high */
+		if((g_e == 1) && ((now - g_powerOn) >= SIM_US_TO_CYCLES(SIM_HD44780_POWER_ON_US)))
+		{
+			g_stats.timingViolations++;
+			Sim_hd44780Report("RS or R/W changed while E is high", 0);
+		}
+		g_rs = rs;
+		if((rw == 0) && (g_rw == 1))
+		{
+			Sim_hd44780Release();
+		}
+		g_rw = rw;
+		g_controlChange = now;
+	}
+
+	if(data != g_data)
+	{
+		g_data = data;
+		g_dataChange = now;
+	}
+
+	if(e == g_e)
+	{
+		return;
+	}
+	g_e = e;
+
+	if(e == 1)
+	{
+		if(SIM_CYCLES_TO_NS(now - g_controlChange) < SIM_HD44780_ADDRESS_NS)
+		{
+			g_stats.timingViolations++;
+			Sim_hd44780Report("RS or R/W setup before E rises too short", SIM_CYCLES_TO_NS(now - g_controlChange));
+		}
+		if((g_eRoseBefore == TRUE) && (SIM_CYCLES_TO_NS(now - g_eRise) < SIM_HD44780_CYCLE_NS))
+		{
+			g_stats.timingViolations++;
+			Sim_hd44780Report("enable cycle time too short", SIM_CYCLES_TO_NS(now - g_eRise));
+		}
+		g_eRise = now;
+		g_eRoseBefore = TRUE;
+		g_read = (g_rw == 1) ? TRUE : FALSE;
+
+#if (LCD_BACKEND == LCD_BACKEND_PARALLEL)
+		if(g_read == TRUE)
+		{
+			Sim_schedule(now + SIM_NS_TO_CYCLES(SIM_HD44780_DATA_DELAY_NS), Sim_hd44780DriveRead, 0);
+		}
+#endif
+	}
+	else
+	{
+		if(SIM_CYCLES_TO_NS(now - g_eRise) < SIM_HD44780_PULSE_NS)
+		{
+			g_stats.timingViolations++;
+			Sim_hd44780Report("enable pulse too short", SIM_CYCLES_TO_NS(now - g_eRise));
+		}
+		if((g_read == FALSE) && (SIM_CYCLES_TO_NS(now - g_dataChange) < SIM_HD44780_DATA_SETUP_NS))
+		{
+			g_stats.timingViolations++;
+			Sim_hd44780Report("data setup before E falls too short", SIM_CYCLES_TO_NS(now - g_dataChange));
+		}
+		Sim_hd44780Latch();
+	}
+}
+
+/*
+ * Description: Function to get the counters of the bus since Sim_hd44780Init.
+ */
+void Sim_hd44780GetStats(Sim_Hd44780StatsType * Stats_Ptr)
+{
+	*Stats_Ptr = g_stats;
+}
+
+/*
+ * Description: Function to get the characters the LCD shows on a row, LCD_COLS characters and the terminator.
+ */
+void Sim_hd44780GetRow(uint8 row, char * string)
+{
+	static const uint8 rowAddress[4] = {0x00, 0x40, 0x00 + LCD_COLS, 0x40 + LCD_COLS};
+	uint8 col;
+
+	for(col = 0; col < LCD_COLS; col++)
+	{
+		uint8 character = g_ddram[(rowAddress[row & 0x03] + col) & 0x7F];
+
+		string[col] = ((character >= 0x20) && (character < 0x7F)) ? (char)character : '?';
+	}
+	string[LCD_COLS] = '\0';
+}
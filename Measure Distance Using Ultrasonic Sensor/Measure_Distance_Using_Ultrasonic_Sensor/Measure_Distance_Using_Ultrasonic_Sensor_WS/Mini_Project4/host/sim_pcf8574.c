@@ -0,0 +1,120 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: sim_pcf8574.c
+ *
+ * Discretion: Model of the PCF8574 I2C expander of the LCD backpack, its pins drive the HD44780 model
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "sim.h"
+#include "lcd.h" /* For the backend and the address of the expander */
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/* The quasi-bidirectional pins of the PCF8574 are high after the power on */
+#define SIM_PCF8574_POWER_ON_PINS	0xFF
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static Sim_Pcf8574StatsType g_stats;
+static uint8 g_pins = SIM_PCF8574_POWER_ON_PINS;
+static uint16 g_nackEvery = 0;
+static uint8 g_nackCount = 0;
+static uint8 g_nacksLeft = 0;  /* Acknowledgements still answered with a NACK */
+static uint16 g_bytesToNack = 0; /* Bytes taken before the next NACKs */
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+/*
+ * Description: Slave of the TWI model, every data byte is written to the pins at its acknowledge.
+ */
+static boolean Sim_pcf8574Receive(uint8 data, boolean first)
+{
+	if(g_nacksLeft != 0)
+	{
+		g_nacksLeft--;
+		g_stats.nacks++;
+		return FALSE; /* The byte does not reach the pins */
+	}
+
+	if(first == TRUE)
+	{
+		return TRUE;
+	}
+
+	g_pins = data;
+	g_stats.bytes++;
+	Sim_hd44780PinsChanged();
+
+	if(g_nackEvery != 0)
+	{
+		g_bytesToNack--;
+		if(g_bytesToNack == 0)
+		{
+			g_bytesToNack = g_nackEvery;
+			g_nacksLeft = g_nackCount;
+		}
+	}
+	return TRUE;
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description: Function to power on the expander and connect it to the TWI bus at LCD_PCF8574_ADDRESS.
+ * The HD44780 model takes the pins from the first write, the power on levels only start a read that the first write ends.
+ */
+void Sim_pcf8574Init(void)
+{
+	g_stats.bytes = 0;
+	g_stats.nacks = 0;
+	g_pins = SIM_PCF8574_POWER_ON_PINS;
+	g_nackEvery = 0;
+	g_nackCount = 0;
+	g_nacksLeft = 0;
+	g_bytesToNack = 0;
+	Sim_twiConnect(LCD_PCF8574_ADDRESS, Sim_pcf8574Receive);
+}
+
+/*
+ * Description: Function to get the levels of the expander pins P7 --> P0.
+ */
+uint8 Sim_pcf8574GetPins(void)
+{
+	return g_pins;
+}
+
+/*
+ * Description: Function to answer the next count acknowledgements with a NACK, and again after every "every" bytes
+ * the expander takes if every is not 0.
+ */
+void Sim_pcf8574SetNacks(uint16 every, uint8 count)
+{
+	g_nackEvery = every;
+	g_nackCount = count;
+	g_nacksLeft = count;
+	g_bytesToNack = every;
+}
+
+/*
+ * Description: Function to get the counters of the expander since Sim_pcf8574Init.
+ */
+void Sim_pcf8574GetStats(Sim_Pcf8574StatsType * Stats_Ptr)
+{
+	*Stats_Ptr = g_stats;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: crc16.h
+ *
+ * Discretion: CRC functions of avr-libc used by the drivers, written in C for the host build
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef SIM_UTIL_CRC16_H_
+#define SIM_UTIL_CRC16_H_
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include <stdint.h>
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description: CRC-16/XMODEM (polynomial 0x1021, initial value 0), the same result as the avr-libc assembler version.
+ */
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	uint8_t i;
+
+	crc ^= (uint16_t)data << 8;
+	for(i = 0; i < 8; i++)
+	{
+		crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+	}
+	return crc;
+}
+
+#endif /* SIM_UTIL_CRC16_H_ */
@@ -0,0 +1,34 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: delay.h
+ *
+ * Discretion: Busy wait delays of the host build, the simulated time passes instead of the host time
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef SIM_UTIL_DELAY_H_
+#define SIM_UTIL_DELAY_H_
+
+/*******************************************************************************
+ *                      		Include Header	                               *
+ *******************************************************************************/
+#include "sim.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+#ifndef F_CPU
+#error "F_CPU is not defined, pass it on the compiler command line (-DF_CPU=8000000UL)"
+#endif
+
+/* Cycles of a delay rounded up as avr-libc does, so a delay is never shorter than required */
+#define SIM_DELAY_CYCLES(us)	((uint32)((double)(us) * ((double)(F_CPU) / 1e6) + 0.999))
+
+#define _delay_us(us)			Sim_delayCycles(SIM_DELAY_CYCLES(us))
+#define _delay_ms(ms)			Sim_delayCycles(SIM_DELAY_CYCLES((double)(ms) * 1000.0))
+
+#endif /* SIM_UTIL_DELAY_H_ */
@@ -0,0 +1,19 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: hwadaptive.h
+ *
+ * Discretion: Bench variant with the trigger pulses of OC1A scheduled after every echo
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef VARIANT_HWADAPTIVE_H_
+#define VARIANT_HWADAPTIVE_H_
+
+#define ULTRASONIC_TRIGGER_MODE			1 /* ULTRASONIC_TRIGGER_HARDWARE */
+#define ULTRASONIC_SCHEDULE				1 /* ULTRASONIC_SCHEDULE_ADAPTIVE */
+
+#endif /* VARIANT_HWADAPTIVE_H_ */
@@ -0,0 +1,21 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: hwstatic.h
+ *
+ * Discretion: Bench variant of hwtrigger.h with the capture handler bound at compile time
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef VARIANT_HWSTATIC_H_
+#define VARIANT_HWSTATIC_H_
+
+#define ULTRASONIC_TRIGGER_MODE			1 /* ULTRASONIC_TRIGGER_HARDWARE */
+#define ULTRASONIC_SCHEDULE				0 /* ULTRASONIC_SCHEDULE_FIXED */
+#define ICU_CAPTURE_BINDING				1 /* ICU_CAPTURE_BINDING_STATIC */
+#define PERF_ENABLE						TRUE /* The capture ISR time is compared with hwtrigger */
+
+#endif /* VARIANT_HWSTATIC_H_ */
@@ -0,0 +1,20 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: hwtrigger.h
+ *
+ * Discretion: Bench variant with the trigger pulses of OC1A at a fixed rate and the echoes measured in the ICU interrupts
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef VARIANT_HWTRIGGER_H_
+#define VARIANT_HWTRIGGER_H_
+
+#define ULTRASONIC_TRIGGER_MODE			1 /* ULTRASONIC_TRIGGER_HARDWARE */
+#define ULTRASONIC_SCHEDULE				0 /* ULTRASONIC_SCHEDULE_FIXED */
+#define PERF_ENABLE						TRUE /* The capture ISR time is compared with hwstatic */
+
+#endif /* VARIANT_HWTRIGGER_H_ */
@@ -0,0 +1,18 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: lcdqueue.h
+ *
+ * Discretion: Bench variant with the LCD bytes written by the Timer0 interrupt from the queue
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef VARIANT_LCDQUEUE_H_
+#define VARIANT_LCDQUEUE_H_
+
+#define LCD_BACKGROUND_WRITE			TRUE
+
+#endif /* VARIANT_LCDQUEUE_H_ */
@@ -0,0 +1,18 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: pcf8574.h
+ *
+ * Discretion: Bench variant with the LCD on a PCF8574 backpack driven by the TWI driver
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef VARIANT_PCF8574_H_
+#define VARIANT_PCF8574_H_
+
+#define LCD_BACKEND						1 /* LCD_BACKEND_PCF8574, lcd.h chooses the modes it needs */
+
+#endif /* VARIANT_PCF8574_H_ */
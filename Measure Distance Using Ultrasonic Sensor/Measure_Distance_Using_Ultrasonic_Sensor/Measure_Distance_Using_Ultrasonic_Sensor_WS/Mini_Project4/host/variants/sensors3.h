@@ -0,0 +1,22 @@
+/****************************************************************************************
+ *
+ * Module: Host Simulation
+ *
+ * File Name: sensors3.h
+ *
+ * Discretion: Bench variant with three sensors of different priorities on the echo multiplexer
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef VARIANT_SENSORS3_H_
+#define VARIANT_SENSORS3_H_
+
+/* Sensor 1 is the neighbour of both others, the scheduler should still give it its share */
+#define BOARD_ULTRASONIC_SENSORS(SENSOR) \
+	SENSOR(PORTB_ID, PIN5_ID, 0, 1) \
+	SENSOR(PORTB_ID, PIN6_ID, 1, 3) \
+	SENSOR(PORTB_ID, PIN7_ID, 2, 2)
+
+#endif /* VARIANT_SENSORS3_H_ */
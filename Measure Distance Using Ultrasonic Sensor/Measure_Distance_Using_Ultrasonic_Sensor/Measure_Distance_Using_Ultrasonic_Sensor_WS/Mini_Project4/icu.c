@@ -16,6 +16,9 @@
  *******************************************************************************/
 #include "icu.h"
 #include "common_macros.h"
+#include "board_config.h" /* For the ICP1 pin */
+#include "perf.h"
+#include "trace.h"
 #include <avr/io.h>
 #include <avr/interrupt.h> /* For ICU ISR */
 
@@ -23,18 +26,204 @@
  *                           Global Variables                                  *
  *******************************************************************************/
 /* Global variables to hold the address of the call back function in the application */
-static volatile void (*g_callBackPtr)(void) = NULL_PTR;
+#if (ICU_CAPTURE_BINDING == ICU_CAPTURE_BINDING_RUNTIME)
+static void (*volatile g_callBackPtr)(void) = NULL_PTR;
+#endif
+static void (*volatile g_timeoutCallBackPtr)(void) = NULL_PTR;
+static void (*volatile g_pulseCallBackPtr)(void) = NULL_PTR;
+
+/* Number of Timer1 overflows, it is the upper 16-bit of the extended timer value */
+static volatile uint16 g_overflowCount = 0;
+
+/* Upper 16-bit of the timeout deadline, the lower 16-bit are in OCR1B */
+static volatile uint16 g_timeoutEpoch = 0;
+
+/* Last capture latched by the ISR: ICR1, the overflow epoch it belongs to and the edge that caused it */
+static volatile uint16 g_captureValue = 0;
+static volatile uint16 g_captureEpoch = 0;
+static volatile ICU_EdgeSelect g_captureEdge = RISING;
+
+/* OC1A pulse generator: compare matches to skip before the pulse starts, pulse width and state */
+static volatile uint16 g_pulseSkipCount = 0;
+static volatile uint16 g_pulseWidth = 0;
+static volatile uint8 g_pulseHigh = FALSE;
+
+/* Single producer (ISRs) single consumer (application) queue of capture records */
+static volatile ICU_CaptureType g_captureBuffer[ICU_CAPTURE_BUFFER_SIZE];
+static volatile uint8 g_captureHead = 0; /* Written by the ISRs only */
+static volatile uint8 g_captureTail = 0; /* Written by the application only */
+static volatile uint16 g_captureDropCount = 0;
+static volatile uint8 g_captureTag = 0;
+
+#if (ICU_MEASURE_ISR_CYCLES == TRUE)
+/* Biggest time from the captured edge to the start and to the end of the capture ISR */
+static volatile uint16 g_isrEntryTicks = 0;
+static volatile uint16 g_isrExitTicks = 0;
+#endif
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+/*
+ * Description: Queue a capture record, called from the ISRs only.
+ * The record is written before the head is moved, so the reader never sees a half written record.
+ */
+static inline void ICU_pushCapture(uint32 timestamp, ICU_EventType event)
+{
+	uint8 head = g_captureHead;
+	uint8 next = (head + 1) & (ICU_CAPTURE_BUFFER_SIZE - 1);
+
+	if(next == g_captureTail)
+	{
+		g_captureDropCount++; /* Queue is full, the application is too slow */
+	}
+	else
+	{
+		g_captureBuffer[head].timestamp = timestamp;
+		g_captureBuffer[head].event = event;
+		g_captureBuffer[head].tag = g_captureTag;
+		g_captureHead = next;
+	}
+}
+
+/*
+ * Description: End the pulse of ICU_schedulePulse after OC1A is cleared, called from the compare ISR only.
+ */
+static inline void ICU_endPulse(void)
+{
+	g_pulseHigh = FALSE;
+	TCCR1A = (TCCR1A & 0x3F) | (ICU_OC1A_DISCONNECTED << 6);
+	TIMSK &= ~(1<<OCIE1A);
+
+	if((*g_pulseCallBackPtr) != NULL_PTR)
+	{
+		/* Call the pulse Call Back function in the application */
+		(*g_pulseCallBackPtr)();
+	}
+}
 
 /*******************************************************************************
  *                       Interrupt Service Routines                            *
  *******************************************************************************/
 ISR(TIMER1_CAPT_vect)
 {
+#if (ICU_MEASURE_ISR_CYCLES == TRUE)
+	uint16 entry = TCNT1;
+#endif
+	uint16 epoch = g_overflowCount;
+	PERF_START(PERF_ICU_CAPTURE_ISR);
+
+	/* Latch the capture before a new edge overwrites ICR1 */
+	g_captureValue = ICR1;
+#if (ICU_MEASURE_ISR_CYCLES == TRUE)
+	entry -= g_captureValue;
+	if(entry > g_isrEntryTicks)
+	{
+		g_isrEntryTicks = entry;
+	}
+#endif
+	g_captureEdge = BIT_IS_SET(TCCR1B,ICES1) ? RISING : FALLING;
+	TRACE((g_captureEdge == RISING) ? TRACE_RISING_EDGE : TRACE_FALLING_EDGE, g_captureValue);
+
+#if (ICU_TOGGLE_EDGE == TRUE)
+	TCCR1B ^= (1<<ICES1); /* Capture the other edge of the pulse next */
+	TIFR = (1<<ICF1);     /* Changing the edge may set the capture flag */
+#endif
+
+	/* The edge may be captured right after an overflow that is not handled yet */
+	if(BIT_IS_SET(TIFR,TOV1) && (g_captureValue < 0x8000))
+	{
+		epoch++;
+	}
+	g_captureEpoch = epoch;
+
+	ICU_pushCapture(((uint32)epoch << 16) | g_captureValue, (ICU_EventType)g_captureEdge);
+
+#if (ICU_CAPTURE_BINDING == ICU_CAPTURE_BINDING_RUNTIME)
 	if((*g_callBackPtr) != NULL_PTR)
 	{
 		/* Call the Call Back function in the application after the edge is detected */
 		(*g_callBackPtr)(); /* another method to call the function using pointer to function g_callBackPtr(); */
 	}
+#else
+	ICU_STATIC_CAPTURE_HOOK(); /* Handler bound at compile time */
+#endif
+
+#if (ICU_MEASURE_ISR_CYCLES == TRUE)
+	/* A later edge may change ICR1, g_captureValue is the edge of this ISR */
+	entry = TCNT1 - g_captureValue;
+	if(entry > g_isrExitTicks)
+	{
+		g_isrExitTicks = entry;
+	}
+#endif
+
+	PERF_STOP(PERF_ICU_CAPTURE_ISR);
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	g_overflowCount++; /* Extend Timer1 to 32-bit */
+	TRACE(TRACE_TIMER1_OVERFLOW, g_overflowCount);
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+	uint16 epoch = g_overflowCount;
+
+	/* The compare match may come right after an overflow that is not handled yet */
+	if(BIT_IS_SET(TIFR,TOV1) && (OCR1B < 0x8000))
+	{
+		epoch++;
+	}
+
+	/* OCR1B matches once every 65536 ticks, only the match in the deadline epoch is the timeout */
+	if((sint16)(epoch - g_timeoutEpoch) >= 0)
+	{
+		TIMSK &= ~(1<<OCIE1B); /* Disable timeout interrupt */
+		TRACE(TRACE_TIMEOUT, OCR1B);
+
+		ICU_pushCapture(((uint32)epoch << 16) | OCR1B, ICU_EVENT_TIMEOUT);
+
+		if((*g_timeoutCallBackPtr) != NULL_PTR)
+		{
+			/* Call the timeout Call Back function in the application */
+			(*g_timeoutCallBackPtr)();
+		}
+	}
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+	if(g_pulseSkipCount != 0)
+	{
+		/* OCR1A matches once every 65536 ticks, wait for the match at the start time */
+		g_pulseSkipCount--;
+		if(g_pulseSkipCount == 0)
+		{
+			TCCR1A = (TCCR1A & 0x3F) | (ICU_OC1A_SET << 6); /* The next match sets OC1A */
+		}
+	}
+	else if(g_pulseHigh == FALSE)
+	{
+		/* OC1A is set by the hardware, the next match clears it after the pulse width */
+		g_pulseHigh = TRUE;
+		TCCR1A = (TCCR1A & 0x3F) | (ICU_OC1A_CLEAR << 6);
+		OCR1A += g_pulseWidth;
+
+		if((sint16)(TCNT1 - OCR1A) >= 0)
+		{
+			/* The interrupt came too late for the match, clear OC1A now.
+			 * A forced compare does not set OCF1A, so the pulse is completed here and not at the next match. */
+			TCCR1A |= (1<<FOC1A);
+			ICU_endPulse();
+		}
+	}
+	else
+	{
+		/* OC1A is cleared by the hardware, the pulse is completed */
+		ICU_endPulse();
+	}
 }
 
 /*******************************************************************************
@@ -45,25 +234,39 @@ ISR(TIMER1_CAPT_vect)
  * Description : Function to initialize the ICU driver
  * 	1. Set the required clock.
  * 	2. Set the required edge detection.
- * 	3. Enable the Input Capture Interrupt.
+ * 	3. Enable the Input Capture and the Timer1 Overflow Interrupts.
  * 	4. Initialize Timer1 Registers
  */
 void ICU_init(const ICU_ConfigType * Config_Ptr)
 {
+	uint8 sreg;
+
 	/* Configure ICP1/PD6 as input pin */
-	DDRD &= ~(1<<PD6);
+	GPIO_SETUP_PIN_DIRECTION_STATIC(BOARD_PORT_ID(BOARD_ICU_ICP1), BOARD_PIN_ID(BOARD_ICU_ICP1), PIN_INPUT);
+
+	/* Force OC1A low so the pulse generator starts from a known level */
+	TCCR1A = (ICU_OC1A_CLEAR << 6);
+	TCCR1A = (ICU_OC1A_CLEAR << 6) | (1<< FOC1A);
 
 	TCCR1A = (1<< FOC1A) | (1<< FOC1B); /* Normal Mode (Non-PWM mode) */
 
 	TCCR1B = (TCCR1B & 0xF8) | (Config_Ptr->prescaler & 0x07); /* Set prescaler value */
 	TCCR1B = (TCCR1B & 0xBF) | ((Config_Ptr->edge & 0x01)<<6); /* select falling or rising edge */
 
-	TIMSK |= (1<<TICIE1); /* Enable interrupt */
+	sreg = SREG;
+	cli(); /* The Timer1 ISRs change TIMSK too */
+	TIMSK |= (1<<TICIE1) | (1<<TOIE1); /* Enable capture and overflow interrupts */
+	SREG = sreg;
 
 	TCNT1 = 0; /* Initialize Timer1 Register */
 	ICR1 = 0;  /* Initialize Input Capture Register */
+	g_overflowCount = 0;
+
+	g_captureHead = 0; /* Empty the capture queue */
+	g_captureTail = 0;
 }
 
+#if (ICU_CAPTURE_BINDING == ICU_CAPTURE_BINDING_RUNTIME)
 /*
  * Description: Function to set the Call Back function address.
  */
@@ -72,13 +275,32 @@ void ICU_setCallBack(void(*a_ptr)(void))
 	/* Save the address of the Call back function in a global variable */
 	g_callBackPtr = a_ptr;
 }
+#endif
 
 /*
  * Description: Function to set the required edge detection.
  */
 void ICU_setEdgeDetectionType(const ICU_EdgeSelect edgeType)
 {
+	uint8 sreg = SREG;
+
+	cli(); /* The capture ISR may toggle the edge at the same time */
 	TCCR1B = (TCCR1B & 0xBF) | ((edgeType & 0x01)<<6);
+	TIFR = (1<<ICF1); /* Changing the edge may set the capture flag */
+	SREG = sreg;
+}
+
+/*
+ * Description: Function to change the Timer1 clock while the timer is running.
+ * The timer value is kept, so the free running time base continues at the rate of the new clock.
+ */
+void ICU_setPrescaler(const ICU_Prescaler prescaler)
+{
+	uint8 sreg = SREG;
+
+	cli(); /* The capture ISR writes TCCR1B too */
+	TCCR1B = (TCCR1B & 0xF8) | (prescaler & 0x07);
+	SREG = sreg;
 }
 
 /*
@@ -91,23 +313,257 @@ uint16 ICU_getInputCaptureValue(void)
 }
 
 /*
- * Description: Function to clear the Timer1 Value to start count from ZERO
+ * Description: Function to clear the Timer1 Value and the overflow count to start count from ZERO
+ * Timer1 is a free running time base, clearing it invalidates the timestamps taken before.
  */
 void ICU_clearTimerValue(void)
 {
 	TCNT1 = 0;
+	TIFR = (1<<TOV1); /* Drop any overflow that is not handled yet */
+	g_overflowCount = 0;
+}
+
+/*
+ * Description: Function to get the free running timestamp of the last captured edge.
+ * The lower 16-bit are the captured ICR1 value and the upper 16-bit are its overflow epoch.
+ * Pulse widths are the difference of two timestamps, which is correct across Timer1 overflows.
+ */
+uint32 ICU_getCaptureTimestamp(void)
+{
+	uint8 sreg = SREG;
+	uint32 timestamp;
+
+	cli(); /* A new capture must not change the value between the two reads */
+	timestamp = ((uint32)g_captureEpoch << 16) | g_captureValue;
+	SREG = sreg;
+
+	return timestamp;
 }
 
+/*
+ * Description: Function to get the overflow epoch of the last captured edge.
+ */
+uint16 ICU_getCaptureEpoch(void)
+{
+	return g_captureEpoch;
+}
+
+/*
+ * Description: Function to get the edge polarity that caused the last capture.
+ */
+ICU_EdgeSelect ICU_getCaptureEdge(void)
+{
+	return g_captureEdge;
+}
+
+/*
+ * Description: Function to read the level of the ICP1 input now, LOGIC_HIGH or LOGIC_LOW.
+ */
+uint8 ICU_getInputLevel(void)
+{
+	return GPIO_READ_PIN_STATIC(BOARD_PORT_ID(BOARD_ICU_ICP1), BOARD_PIN_ID(BOARD_ICU_ICP1));
+}
+
+/*
+ * Description: Function to get the current Timer1 Value extended to 32-bit by the overflow count.
+ */
+uint32 ICU_getTimerValue(void)
+{
+	uint8 sreg = SREG;
+	uint16 count;
+	uint16 epoch;
+
+	cli(); /* The overflow interrupt must not change the count between the two reads */
+	count = TCNT1;
+	epoch = g_overflowCount;
+	if(BIT_IS_SET(TIFR,TOV1) && (count < 0x8000))
+	{
+		epoch++;
+	}
+	SREG = sreg;
+
+	return ((uint32)epoch << 16) | count;
+}
+
+/*
+ * Description: Function to start the timeout watchdog.
+ * After the required number of Timer1 ticks an ICU_EVENT_TIMEOUT record is queued and the timeout
+ * call back function is called once, unless ICU_stopTimeout is called before.
+ */
+void ICU_startTimeout(uint32 ticks)
+{
+	uint8 sreg = SREG;
+	uint32 deadline;
+
+	cli();
+	deadline = ICU_getTimerValue() + ticks;
+	g_timeoutEpoch = (uint16)(deadline >> 16);
+	OCR1B = (uint16)deadline;
+	TIFR = (1<<OCF1B);    /* Clear any old compare match */
+	TIMSK |= (1<<OCIE1B); /* Enable timeout interrupt, TIMSK is changed by the Timer1 ISRs too */
+	SREG = sreg;
+}
+
+/*
+ * Description: Function to stop the timeout watchdog.
+ */
+void ICU_stopTimeout(void)
+{
+	uint8 sreg = SREG;
+
+	cli(); /* The Timer1 ISRs change TIMSK too */
+	TIMSK &= ~(1<<OCIE1B); /* Disable timeout interrupt */
+	SREG = sreg;
+}
+
+/*
+ * Description: Function to set the timeout Call Back function address.
+ */
+void ICU_setTimeoutCallBack(void(*a_ptr)(void))
+{
+	/* Save the address of the Call back function in a global variable */
+	g_timeoutCallBackPtr = a_ptr;
+}
+
+/*
+ * Description: Function to read the oldest capture record queued by the ISR.
+ * Return FALSE if the queue is empty.
+ * The ISR is the only writer and the application the only reader, so no interrupts are disabled.
+ */
+boolean ICU_readCapture(ICU_CaptureType * Capture_Ptr)
+{
+	uint8 tail = g_captureTail;
+
+	if(tail == g_captureHead)
+	{
+		return FALSE; /* Queue is empty */
+	}
+
+	Capture_Ptr->timestamp = g_captureBuffer[tail].timestamp;
+	Capture_Ptr->event = g_captureBuffer[tail].event;
+	Capture_Ptr->tag = g_captureBuffer[tail].tag;
+
+	/* Free the slot only after it is copied */
+	g_captureTail = (tail + 1) & (ICU_CAPTURE_BUFFER_SIZE - 1);
+	return TRUE;
+}
+
+/*
+ * Description: Function to get the number of capture records that were dropped because the queue was full.
+ */
+uint16 ICU_getCaptureDropCount(void)
+{
+	uint8 sreg = SREG;
+	uint16 count;
+
+	cli();
+	count = g_captureDropCount;
+	SREG = sreg;
+
+	return count;
+}
+
+/*
+ * Description: Function to set the tag stored with the next capture records.
+ */
+void ICU_setCaptureTag(uint8 tag)
+{
+	g_captureTag = tag;
+}
+
+/*
+ * Description: Function to generate one pulse on OC1A/PD5 by the Timer1 hardware.
+ * The pulse starts at the free running Timer1 time start and is width ticks long,
+ * so its timing does not depend on the CPU. The pulse call back function is called when it ends.
+ * The start time should be in the future, a pulse already in progress is cancelled.
+ * OC1A/PD5 should be configured as output pin by the application.
+ */
+void ICU_schedulePulse(uint32 start, uint16 width)
+{
+	uint8 sreg = SREG;
+	uint32 now;
+	uint32 delta;
+
+	cli();
+	now = ICU_getTimerValue();
+	delta = start - now;
+	if((delta == 0) || (delta > 0x7FFFFFFFUL))
+	{
+		delta = 1; /* The start time already passed, start as soon as possible */
+	}
+	start = now + delta;
+
+	g_pulseWidth = width;
+	g_pulseHigh = FALSE;
+	g_pulseSkipCount = (uint16)((delta - 1) >> 16); /* Matches of OCR1A before the start time */
+
+	OCR1A = (uint16)start;
+	if(g_pulseSkipCount == 0)
+	{
+		TCCR1A = (TCCR1A & 0x3F) | (ICU_OC1A_SET << 6); /* The next match sets OC1A */
+	}
+	else
+	{
+		TCCR1A = (TCCR1A & 0x3F) | (ICU_OC1A_DISCONNECTED << 6);
+	}
+	TIFR = (1<<OCF1A);    /* Clear any old compare match */
+
+	/* The 32-bit times are compared, a start up to 65535 ticks away is beyond the range of TCNT1 - OCR1A */
+	if((g_pulseSkipCount == 0) && ((sint32)(ICU_getTimerValue() - start) >= 0))
+	{
+		/* The start time passed while the pulse was set up, start the pulse now */
+		TCCR1A |= (1<<FOC1A);
+		g_pulseHigh = TRUE;
+		TCCR1A = (TCCR1A & 0x3F) | (ICU_OC1A_CLEAR << 6);
+		OCR1A = TCNT1 + width;
+		TIFR = (1<<OCF1A);
+	}
+
+	TIMSK |= (1<<OCIE1A); /* Enable pulse interrupt */
+	SREG = sreg;
+}
+
+/*
+ * Description: Function to set the pulse Call Back function address.
+ */
+void ICU_setPulseCallBack(void(*a_ptr)(void))
+{
+	/* Save the address of the Call back function in a global variable */
+	g_pulseCallBackPtr = a_ptr;
+}
+
+#if (ICU_MEASURE_ISR_CYCLES == TRUE)
+/*
+ * Description: Function to get the biggest time from a captured edge to the start and to the end of the capture ISR
+ * in Timer1 ticks since ICU_init, and clear them.
+ */
+void ICU_getIsrTicks(uint16 * entry_ptr, uint16 * exit_ptr)
+{
+	uint8 sreg = SREG;
+
+	cli(); /* 16-bit variables written by the ISR */
+	*entry_ptr = g_isrEntryTicks;
+	*exit_ptr = g_isrExitTicks;
+	g_isrEntryTicks = 0;
+	g_isrExitTicks = 0;
+	SREG = sreg;
+}
+#endif
+
 /*
  * Description: Function to disable the Timer1 to stop the ICU Driver
  */
 void ICU_DeInit(void)
 {
+	uint8 sreg = SREG;
+
 	/* Clear All Timer1 Registers */
 	 TCCR1A = 0;
 	 TCCR1B = 0;
 	 TCNT1 = 0;
 	 ICR1 = 0;
 
-	 TIMSK &= ~(1<<TICIE1); /* Disable interrupt */
+	 cli(); /* The Timer1 ISRs change TIMSK too */
+	 TIMSK &= ~((1<<TICIE1) | (1<<TOIE1) | (1<<OCIE1A) | (1<<OCIE1B)); /* Disable interrupts */
+	 SREG = sreg;
 }
@@ -18,6 +18,59 @@
  *******************************************************************************/
 #include "std_types.h"
 
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/* Number of capture records the ISR can queue before the application reads them (power of 2) */
+#define ICU_CAPTURE_BUFFER_SIZE		8
+
+#if ((ICU_CAPTURE_BUFFER_SIZE & (ICU_CAPTURE_BUFFER_SIZE - 1)) != 0) || (ICU_CAPTURE_BUFFER_SIZE > 128)
+#error "ICU_CAPTURE_BUFFER_SIZE should be a power of 2 not bigger than 128"
+#endif
+
+/* If ICU_TOGGLE_EDGE is TRUE the ISR switches the edge detection after every capture,
+ * so both edges of a pulse are captured without waiting for the application */
+#define ICU_TOGGLE_EDGE				TRUE
+
+/*
+ * Binding of the function called by the capture ISR after the capture is queued:
+ * ICU_CAPTURE_BINDING_RUNTIME: the function given to ICU_setCallBack, called through a pointer after a NULL check.
+ * ICU_CAPTURE_BINDING_STATIC: ICU_STATIC_CAPTURE_HOOK, called directly. It is known at compile time, so the ISR
+ * has no pointer load and no NULL check. The default hook is a function of another file, so it is not inlined
+ * and the ISR still saves the registers a call may change, only a hook defined as a macro is inlined.
+ * ICU_setCallBack does not exist in this binding.
+ * The hook runs in the ISR, so the application must not read the capture queue too: with the ultrasonic driver
+ * this binding needs ULTRASONIC_TRIGGER_HARDWARE (ultrasonic.h fails the build otherwise).
+ */
+#define ICU_CAPTURE_BINDING_RUNTIME	0
+#define ICU_CAPTURE_BINDING_STATIC	1
+
+#ifndef ICU_CAPTURE_BINDING
+#define ICU_CAPTURE_BINDING			ICU_CAPTURE_BINDING_RUNTIME
+#endif
+
+#if (ICU_CAPTURE_BINDING == ICU_CAPTURE_BINDING_STATIC)
+/* Capture handler of the application, here the echo processing of the ultrasonic driver */
+#ifndef ICU_STATIC_CAPTURE_HOOK
+#define ICU_STATIC_CAPTURE_HOOK		Ultrasonic_edgeProcessing
+#endif
+#elif (ICU_CAPTURE_BINDING != ICU_CAPTURE_BINDING_RUNTIME)
+#error "ICU_CAPTURE_BINDING should be equal to ICU_CAPTURE_BINDING_RUNTIME or ICU_CAPTURE_BINDING_STATIC"
+#endif
+
+/*
+ * If ICU_MEASURE_ISR_CYCLES is TRUE the capture ISR measures its own time from ICR1, which holds the Timer1 value
+ * of the edge: the time from the edge to the first statement of the ISR (interrupt response and register saving)
+ * and to the end of the ISR (before the registers are restored), in Timer1 ticks. With the F_CPU_1 prescaler a tick
+ * is one CPU cycle. The biggest values are kept, read them by ICU_getIsrTicks.
+ */
+#define ICU_MEASURE_ISR_CYCLES		FALSE
+
+/* Compare Output Mode of OC1A (COM1A1:0) used by the pulse generator */
+#define ICU_OC1A_DISCONNECTED		0
+#define ICU_OC1A_CLEAR				2
+#define ICU_OC1A_SET				3
+
 /*******************************************************************************
  *                         	Types Declaration                                  *
  *******************************************************************************/
@@ -34,6 +87,17 @@ typedef struct{
 	ICU_EdgeSelect edge;
 }ICU_ConfigType;
 
+/* The edge events have the same values as ICU_EdgeSelect */
+typedef enum{
+	ICU_EVENT_FALLING_EDGE, ICU_EVENT_RISING_EDGE, ICU_EVENT_TIMEOUT
+}ICU_EventType;
+
+typedef struct{
+	uint32 timestamp;    /* Free running Timer1 time of the event */
+	ICU_EventType event; /* Captured edge or timeout */
+	uint8 tag;           /* Tag set by ICU_setCaptureTag when the event happened (sensor id) */
+}ICU_CaptureType;
+
 /*******************************************************************************
  *                         	Function Prototypes                                *
  *******************************************************************************/
@@ -42,22 +106,33 @@ typedef struct{
  * Description : Function to initialize the ICU driver
  * 	1. Set the required clock.
  * 	2. Set the required edge detection.
- * 	3. Enable the Input Capture Interrupt.
+ * 	3. Enable the Input Capture and the Timer1 Overflow Interrupts.
  * 	4. Initialize Timer1 Registers
  */
 void ICU_init(const ICU_ConfigType * Config_Ptr);
 
+#if (ICU_CAPTURE_BINDING == ICU_CAPTURE_BINDING_RUNTIME)
 /*
  * Description:
  * Description: Function to set the Call Back function address.
  */
 void ICU_setCallBack(void(*a_ptr)(void));
+#else
+/* Declaration of the handler when it is a function */
+void ICU_STATIC_CAPTURE_HOOK(void);
+#endif
 
 /*
  * Description: Function to set the required edge detection.
  */
 void ICU_setEdgeDetectionType(const ICU_EdgeSelect edgeType);
 
+/*
+ * Description: Function to change the Timer1 clock while the timer is running.
+ * The timer value is kept, so the free running time base continues at the rate of the new clock.
+ */
+void ICU_setPrescaler(const ICU_Prescaler prescaler);
+
 /*
  * Description:
  * Description: Function to get the Timer1 Value when the input is captured
@@ -67,10 +142,107 @@ uint16 ICU_getInputCaptureValue(void);
 
 /*
  * Description:
- * Description: Function to clear the Timer1 Value to start count from ZERO
+ * Description: Function to clear the Timer1 Value and the overflow count to start count from ZERO
+ * Timer1 is a free running time base, clearing it invalidates the timestamps taken before.
  */
 void ICU_clearTimerValue(void);
 
+/*
+ * Description:
+ * Description: Function to get the free running timestamp of the last captured edge.
+ * The lower 16-bit are the captured ICR1 value and the upper 16-bit are its overflow epoch.
+ * Pulse widths are the difference of two timestamps, which is correct across Timer1 overflows.
+ */
+uint32 ICU_getCaptureTimestamp(void);
+
+/*
+ * Description:
+ * Description: Function to get the overflow epoch of the last captured edge.
+ */
+uint16 ICU_getCaptureEpoch(void);
+
+/*
+ * Description:
+ * Description: Function to get the edge polarity that caused the last capture.
+ */
+ICU_EdgeSelect ICU_getCaptureEdge(void);
+
+/*
+ * Description: Function to read the level of the ICP1 input now, LOGIC_HIGH or LOGIC_LOW.
+ */
+uint8 ICU_getInputLevel(void);
+
+/*
+ * Description:
+ * Description: Function to get the current Timer1 Value extended to 32-bit by the overflow count.
+ */
+uint32 ICU_getTimerValue(void);
+
+/*
+ * Description:
+ * Description: Function to start the timeout watchdog.
+ * After the required number of Timer1 ticks an ICU_EVENT_TIMEOUT record is queued and the timeout
+ * call back function is called once, unless ICU_stopTimeout is called before.
+ */
+void ICU_startTimeout(uint32 ticks);
+
+/*
+ * Description:
+ * Description: Function to stop the timeout watchdog.
+ */
+void ICU_stopTimeout(void);
+
+/*
+ * Description:
+ * Description: Function to set the timeout Call Back function address.
+ */
+void ICU_setTimeoutCallBack(void(*a_ptr)(void));
+
+/*
+ * Description:
+ * Description: Function to read the oldest capture record queued by the ISR.
+ * Return FALSE if the queue is empty.
+ * The ISR is the only writer and the application the only reader, so no interrupts are disabled.
+ */
+boolean ICU_readCapture(ICU_CaptureType * Capture_Ptr);
+
+/*
+ * Description:
+ * Description: Function to get the number of capture records that were dropped because the queue was full.
+ */
+uint16 ICU_getCaptureDropCount(void);
+
+/*
+ * Description:
+ * Description: Function to set the tag stored with the next capture records.
+ */
+void ICU_setCaptureTag(uint8 tag);
+
+/*
+ * Description:
+ * Description: Function to generate one pulse on OC1A/PD5 by the Timer1 hardware.
+ * The pulse starts at the free running Timer1 time start and is width ticks long,
+ * so its timing does not depend on the CPU. The pulse call back function is called when it ends.
+ * The start time should be in the future, a pulse already in progress is cancelled.
+ * OC1A/PD5 should be configured as output pin by the application.
+ */
+void ICU_schedulePulse(uint32 start, uint16 width);
+
+/*
+ * Description:
+ * Description: Function to set the pulse Call Back function address.
+ */
+void ICU_setPulseCallBack(void(*a_ptr)(void));
+
+#if (ICU_MEASURE_ISR_CYCLES == TRUE)
+/*
+ * Description:
+ * Description: Function to get the biggest time from a captured edge to the start and to the end of the capture ISR
+ * in Timer1 ticks since ICU_init, and clear them.
+ */
+void ICU_getIsrTicks(uint16 * entry_ptr, uint16 * exit_ptr);
+#endif
+
 /*
  * Description:
  * Description: Function to disable the Timer1 to stop the ICU Driver
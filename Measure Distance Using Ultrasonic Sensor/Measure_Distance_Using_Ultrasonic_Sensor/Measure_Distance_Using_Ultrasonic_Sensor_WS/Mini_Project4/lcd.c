@@ -15,160 +15,651 @@
  *******************************************************************************/
 #include "lcd.h"
 #include <avr/io.h>
+#include "common_macros.h"
 #include "gpio.h"
 #include <util/delay.h>
+#include <avr/interrupt.h> /* For the background writer ISR */
+#include <avr/pgmspace.h> /* For the strings in the program memory */
+#include "perf.h"
+#include "trace.h"
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+#include "twi.h"
+#endif
 
 /*******************************************************************************
- *                      	Function Definitions                               *
+ *                           Global Variables                                  *
+ *******************************************************************************/
+/* The busy flag is valid after the function set of LCD_init */
+static boolean g_busyFlagValid = FALSE;
+
+/* DDRAM address of the first cell of every row */
+static const uint8 g_rowAddress[4] = {0x00, 0x40, 0x00 + LCD_COLS, 0x40 + LCD_COLS};
+
+/*
+ * The frame buffer holds the cells the application wants to show and the shadow holds the cells
+ * the LCD shows now. g_lcdAddress follows the DDRAM address counter of the LCD through the entry mode
+ * and the cursor shifts, it is LCD_ADDRESS_UNKNOWN while the counter points to the CGRAM or after
+ * a command that moves it in a way the driver does not follow.
+ */
+#define LCD_ADDRESS_UNKNOWN		0xFF
+static uint8 g_frameBuffer[LCD_ROWS][LCD_COLS];
+static uint8 g_lcdShadow[LCD_ROWS][LCD_COLS];
+static uint8 g_lcdAddress = LCD_ADDRESS_UNKNOWN;
+static boolean g_lcdAddressDecrement = FALSE; /* I/D = 0 in the last entry mode command */
+
+/* Commands the address tracking decodes */
+#define LCD_ENTRY_MODE_MASK		0xFC
+#define LCD_ENTRY_MODE			0x04 /* I/D (bit 1) and S (bit 0) */
+#define LCD_ENTRY_INCREMENT		0x02
+#define LCD_SHIFT_MASK			0xF0
+#define LCD_SHIFT				0x10 /* S/C (bit 3) and R/L (bit 2) */
+#define LCD_SHIFT_DISPLAY		0x08
+#define LCD_SHIFT_RIGHT			0x04
+#define LCD_SET_CGRAM_MASK		0xC0
+#define LCD_SET_CGRAM_ADDRESS	0x40
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+/* Number of queue ticks that cover an execution time */
+#define LCD_QUEUE_TICKS(us)		(((us) + LCD_QUEUE_TICK_US - 1) / LCD_QUEUE_TICK_US)
+
+/* Single producer (application) single consumer (Timer0 ISR) queue of the bytes to write */
+static volatile uint8 g_queueRs[LCD_QUEUE_SIZE];
+static volatile uint8 g_queueByte[LCD_QUEUE_SIZE];
+static volatile uint8 g_queueHead = 0; /* Written by the application only */
+static volatile uint8 g_queueTail = 0; /* Written by the ISR, or by the application with the interrupts disabled */
+static volatile uint8 g_queueWait = 0; /* Ticks the LCD still needs for the last byte */
+static uint8 g_queueHighWatermark = 0;
+static boolean g_queueEnabled = FALSE; /* LCD_init writes directly, the queue is used after it */
+#endif
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+#if (TWI_BIT_RATE(LCD_PCF8574_SCL_HZ) < 10) || (TWI_BIT_RATE(LCD_PCF8574_SCL_HZ) > 255)
+#error "LCD_PCF8574_SCL_HZ needs a TWBR from 10 (master mode minimum) to 255 at this F_CPU"
+#endif
+
+/* RS and the backlight on the expander pins, E is low between the expander writes */
+static uint8 g_expanderControl = LCD_PCF8574_BACKLIGHT;
+#endif
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
  *******************************************************************************/
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
 /*
  * Description:
- * This function activate LCD pins and start the LCD by identify LCD mode and clear the screen.
+ * Queue one write of the expander pins in the TWI driver.
  */
-void LCD_init(void)
+static void LCD_expanderWrite(uint8 pins)
 {
-	/* Make control pins output */
-	GPIO_setupPinDirection(LCD_RS_PORT_ID, LCD_RS_PIN_ID, PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_RW_PORT_ID, LCD_RW_PIN_ID, PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_E_PORT_ID, LCD_E_PIN_ID, PIN_OUTPUT);
-#if(LCD_DATA_BITS_MODE == 8)
-	/* Make Data port output */
-	GPIO_setupPortDirection(LCD_DATA_PORT_ID, PORT_OUTPUT);
+	TWI_writeByte(LCD_PCF8574_ADDRESS, pins);
+}
 
-	LCD_sendCommand(LCD_TWO_LINES_EIGHT_BITS_MODE); /* Two lines 8-bit mode */
-#elif(LCD_DATA_BITS_MODE == 4)
+/*
+ * Description:
+ * Queue count expander writes that do not change the pins, the LCD gets the time they take on the bus
+ * without blocking the CPU.
+ */
+static void LCD_expanderPad(uint8 count)
+{
+	while(count != 0)
+	{
+		LCD_expanderWrite(g_expanderControl);
+		count--;
+	}
+}
 
-	/* Make Data pins output */
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID, LCD_FIRST_DATA_PIN_ID + 0, PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID, LCD_FIRST_DATA_PIN_ID + 1, PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID, LCD_FIRST_DATA_PIN_ID + 2, PIN_OUTPUT);
-	GPIO_setupPinDirection(LCD_DATA_PORT_ID, LCD_FIRST_DATA_PIN_ID + 3, PIN_OUTPUT);
+/*
+ * Description:
+ * Put the 4 bits of the value on D4 --> D7 with E high then with E low, the LCD latches them on the falling edge.
+ * Every write takes LCD_PCF8574_BYTE_US, longer than the enable pulse and the setup times.
+ */
+static void LCD_writeBus(uint8 value)
+{
+	uint8 pins = (uint8)(value << 4) | g_expanderControl;
 
-	LCD_sendCommand(LCD_RETURN_HOME	);
-	LCD_sendCommand(LCD_TWO_LINES_FOUR_BITS_MODE); /* Two lines 4-bit mode */
-#endif
-	/* Send initial commands */
-	LCD_sendCommand(LCD_CURSOR_OFF); /* Cursor off*/
-	LCD_sendCommand(LCD_CLEAR_SCREEN ); /* Clear Screen */
+	LCD_expanderWrite(pins | LCD_PCF8574_E); /* Enable(E) = 1 */
+	LCD_expanderWrite(pins);                 /* Enable(E) = 0 */
 }
 
 /*
  * Description:
- * This function send commands to the LCD.
+ * Queue one byte without waiting for the LCD, RS is changed by a write of its own before E rises.
  */
-void LCD_sendCommand(uint8 command)
+static void LCD_sendByte(uint8 rs, uint8 byte)
 {
-	uint8 lcd_port_value = 0;
-	/* RS = 0  (to send command) and R/W = 0 (to write value) */
-	GPIO_writePin(LCD_RS_PORT_ID, LCD_RS_PIN_ID, LOGIC_LOW);
-	GPIO_writePin(LCD_RW_PORT_ID, LCD_RW_PIN_ID, LOGIC_LOW);
+	uint8 control = (rs == LOGIC_HIGH) ? (LCD_PCF8574_RS | LCD_PCF8574_BACKLIGHT) : LCD_PCF8574_BACKLIGHT;
 
-	_delay_ms(1);
+	if(control != g_expanderControl)
+	{
+		g_expanderControl = control; /* RS = 0 (to send command) or RS = 1 (to send data), R/W = 0 always */
+		LCD_expanderWrite(control);
+	}
 
-	GPIO_writePin(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_HIGH); /* Enable(E) = 1 */
+	LCD_writeBus(byte >> 4);   /* out the last 4 bits of the byte to the data bus D4 --> D7 */
+	LCD_writeBus(byte & 0x0F); /* out the first 4 bits of the byte to the data bus D4 --> D7 */
+}
 
-	_delay_ms(1);
+/* The delays after a bus write are expander writes queued after it */
+#define LCD_BUS_DELAY_US(us)		LCD_expanderPad(LCD_PCF8574_PAD_BYTES(us))
+#else
+/*
+ * Description:
+ * Give one enable pulse, the LCD latches the data bus on the falling edge.
+ */
+static void LCD_pulseEnable(void)
+{
+	GPIO_WRITE_PIN_STATIC(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_HIGH); /* Enable(E) = 1 */
+	_delay_us(LCD_ENABLE_PULSE_US);
+	GPIO_WRITE_PIN_STATIC(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_LOW); /* Enable(E) = 0 */
+	_delay_us(LCD_ENABLE_PULSE_US);
+}
 
+/*
+ * Description:
+ * Put the value on the data bus D0 --> D7 (8-bit mode) or the 4 bits of the value on D4 --> D7 (4-bit mode)
+ * and latch it into the LCD.
+ */
+static void LCD_writeBus(uint8 value)
+{
 #if(LCD_DATA_BITS_MODE == 8)
-	/* Send command */
-	GPIO_writePort(LCD_DATA_PORT_ID, command);
+	GPIO_writePort(LCD_DATA_PORT_ID, value);
+#elif(LCD_DATA_BITS_MODE == 4)
+	/* One write of the 4 data pins, the other pins of the port are not touched */
+	GPIO_writePortMasked(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK, value << LCD_FIRST_DATA_PIN_ID);
+#endif
+	LCD_pulseEnable();
+}
+
+#if (LCD_USE_BUSY_FLAG == TRUE)
+/*
+ * Description:
+ * Read the busy flag until the LCD finished the last instruction.
+ * The data pins are inputs while the LCD drives the bus.
+ */
+static void LCD_waitBusyFlag(void)
+{
+	uint16 polls = 0;
+	uint8 busy;
+
+	GPIO_setupPortDirectionMasked(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK, PORT_INPUT);
+
+	/* RS = 0 and R/W = 1 (to read the busy flag and the address counter) */
+	GPIO_WRITE_PIN_STATIC(LCD_RS_PORT_ID, LCD_RS_PIN_ID, LOGIC_LOW);
+	GPIO_WRITE_PIN_STATIC(LCD_RW_PORT_ID, LCD_RW_PIN_ID, LOGIC_HIGH);
+	_delay_us(LCD_ADDRESS_SETUP_US);
 
-	_delay_ms(1);
+	do
+	{
+		GPIO_WRITE_PIN_STATIC(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_HIGH); /* Enable(E) = 1 */
+		_delay_us(LCD_DATA_DELAY_US);
+		busy = GPIO_READ_PIN_STATIC(LCD_DATA_PORT_ID, LCD_BUSY_FLAG_PIN_ID);
+		GPIO_WRITE_PIN_STATIC(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_LOW); /* Enable(E) = 0 */
+		_delay_us(LCD_ENABLE_PULSE_US);
+#if(LCD_DATA_BITS_MODE == 4)
+		LCD_pulseEnable(); /* The second half of the address counter is not needed */
+#endif
+		polls++;
+	}while((busy == LOGIC_HIGH) && (polls < LCD_BUSY_FLAG_MAX_POLLS));
+
+	GPIO_WRITE_PIN_STATIC(LCD_RW_PORT_ID, LCD_RW_PIN_ID, LOGIC_LOW);
+
+	GPIO_setupPortDirectionMasked(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK, PORT_OUTPUT);
+}
+#endif
 
-	GPIO_writePin(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_LOW); /* Enable(E) = 0 */
+/*
+ * Description:
+ * Write one byte on the bus without waiting for the LCD.
+ */
+static void LCD_sendByte(uint8 rs, uint8 byte)
+{
+	/* RS = 0 (to send command) or RS = 1 (to send data) and R/W = 0 (to write value) */
+	GPIO_WRITE_PIN_STATIC(LCD_RS_PORT_ID, LCD_RS_PIN_ID, rs);
+	GPIO_WRITE_PIN_STATIC(LCD_RW_PORT_ID, LCD_RW_PIN_ID, LOGIC_LOW);
+	_delay_us(LCD_ADDRESS_SETUP_US);
 
-	_delay_ms(1);
+#if(LCD_DATA_BITS_MODE == 8)
+	LCD_writeBus(byte);
 #elif(LCD_DATA_BITS_MODE == 4)
-	/* out the last 4 bits of the required command to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
-#ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | (command & 0xF0);
-#else
-	lcd_port_value = (lcd_port_value & 0xF0) | ((command & 0xF0) >> 4);
+	LCD_writeBus(byte >> 4);   /* out the last 4 bits of the byte to the data bus D4 --> D7 */
+	LCD_writeBus(byte & 0x0F); /* out the first 4 bits of the byte to the data bus D4 --> D7 */
 #endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
+}
 
-	_delay_ms(1);
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1);
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	_delay_ms(1);
+#define LCD_BUS_DELAY_US(us)		_delay_us(us)
+#endif
+
+/*
+ * Description:
+ * Return TRUE if the byte is the clear display or the return home command, which take the long execution time.
+ */
+static boolean LCD_isLongCommand(uint8 rs, uint8 byte)
+{
+	return ((rs == LOGIC_LOW) && ((byte & 0xFC) == 0));
+}
 
-	/* out the first 4 bits of the required command to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
-#ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | ((command & 0x0F) << 4);
+/*
+ * Description:
+ * Wait the datasheet execution time of the byte written last.
+ */
+static void LCD_waitExecution(uint8 rs, uint8 byte)
+{
+	if(LCD_isLongCommand(rs, byte) == TRUE)
+	{
+		LCD_BUS_DELAY_US(LCD_CLEAR_EXECUTION_US); /* Clear display or return home */
+	}
+	else
+	{
+#if (LCD_BACKEND == LCD_BACKEND_PARALLEL)
+		_delay_us(LCD_EXECUTION_US);
 #else
-	lcd_port_value = (lcd_port_value & 0xF0) | (command & 0x0F);
+		/* The next byte is latched two expander writes later, after LCD_EXECUTION_US */
 #endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
+	}
+}
 
-	_delay_ms(1);
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1);
+/*
+ * Description:
+ * Move the tracked DDRAM address one cell as the LCD does after a data write or a cursor shift.
+ */
+static void LCD_stepAddress(boolean decrement)
+{
+	if(g_lcdAddress == LCD_ADDRESS_UNKNOWN)
+	{
+		return;
+	}
+	if(decrement == FALSE)
+	{
+		g_lcdAddress++;
+	}
+	else if(g_lcdAddress != 0)
+	{
+		g_lcdAddress--;
+	}
+	else
+	{
+		g_lcdAddress = LCD_ADDRESS_UNKNOWN; /* The LCD wraps to the end of the DDRAM */
+	}
+}
 
-#endif
+/*
+ * Description:
+ * Follow the LCD address counter and keep the shadow equal to the LCD after the byte is written.
+ * The shadow holds the DDRAM, a display shift (entry mode S = 1 or a display shift command) moves the window
+ * the LCD shows over it but does not change the DDRAM or the address counter.
+ */
+static void LCD_trackByte(uint8 rs, uint8 byte)
+{
+	uint8 row;
+	uint8 col;
 
+	if(rs == LOGIC_HIGH)
+	{
+		if(g_lcdAddress == LCD_ADDRESS_UNKNOWN)
+		{
+			return; /* Unknown DDRAM address or a write to the CGRAM */
+		}
+		for(row = 0; row < LCD_ROWS; row++)
+		{
+			col = g_lcdAddress - g_rowAddress[row];
+			if((g_lcdAddress >= g_rowAddress[row]) && (col < LCD_COLS))
+			{
+				g_lcdShadow[row][col] = byte; /* Visible cell */
+			}
+		}
+		LCD_stepAddress(g_lcdAddressDecrement); /* The LCD moves the address after every data write */
+	}
+	else if((byte & LCD_SET_CURSOR_LOCATION) != 0)
+	{
+		g_lcdAddress = byte & 0x7F;
+	}
+	else if((byte & LCD_SET_CGRAM_MASK) == LCD_SET_CGRAM_ADDRESS)
+	{
+		g_lcdAddress = LCD_ADDRESS_UNKNOWN; /* The data writes go to the CGRAM until the next DDRAM address */
+	}
+	else if(byte == LCD_CLEAR_SCREEN)
+	{
+		g_lcdAddress = 0;
+		for(row = 0; row < LCD_ROWS; row++)
+		{
+			for(col = 0; col < LCD_COLS; col++)
+			{
+				g_lcdShadow[row][col] = ' ';
+			}
+		}
+	}
+	else if((byte & 0xFE) == LCD_RETURN_HOME)
+	{
+		g_lcdAddress = 0;
+	}
+	else if((byte & LCD_SHIFT_MASK) == LCD_SHIFT)
+	{
+		if((byte & LCD_SHIFT_DISPLAY) == 0)
+		{
+			LCD_stepAddress((byte & LCD_SHIFT_RIGHT) == 0); /* Cursor shift */
+		}
+	}
+	else if((byte & LCD_ENTRY_MODE_MASK) == LCD_ENTRY_MODE)
+	{
+		g_lcdAddressDecrement = ((byte & LCD_ENTRY_INCREMENT) == 0) ? TRUE : FALSE;
+	}
 }
 
+#if (LCD_BACKGROUND_WRITE == TRUE)
+/*
+ * Description:
+ * Write the oldest byte of the queue to the LCD and free its slot.
+ * The Timer0 ISR calls it, and LCD_queueByte with the interrupts disabled.
+ */
+static void LCD_queueWriteTail(void)
+{
+	uint8 tail = g_queueTail;
+
+	LCD_sendByte(g_queueRs[tail], g_queueByte[tail]);
+
+	/*
+	 * Wait one tick more than the execution time: this write may have been late by the latency of another
+	 * interrupt or a critical section and the next compare match may come on time.
+	 */
+	if(LCD_isLongCommand(g_queueRs[tail], g_queueByte[tail]) == TRUE)
+	{
+		g_queueWait = LCD_QUEUE_TICKS(LCD_CLEAR_EXECUTION_US);
+	}
+	else
+	{
+		g_queueWait = LCD_QUEUE_TICKS(LCD_EXECUTION_US);
+	}
+
+	g_queueTail = (tail + 1) & (LCD_QUEUE_SIZE - 1); /* Free the slot only after it is written */
+}
 
 /*
  * Description:
- * This function send character to the LCD.
+ * Put the byte in the queue of the background writer, wait only if the queue is full.
+ * With the interrupts disabled the ISR can not free a slot, so the oldest byte is written here at the pace of
+ * the LCD instead of waiting forever.
  */
-void LCD_displayCharacter(uint8 character)
+static void LCD_queueByte(uint8 rs, uint8 byte)
 {
-	uint8 lcd_port_value = 0;
-	/* RS = 1 (to send character) and R/W = 0 (to write value) */
-	/* RS = 0  (to send command) and R/W = 0 (to write value) */
-	GPIO_writePin(LCD_RS_PORT_ID, LCD_RS_PIN_ID, LOGIC_HIGH);
-	GPIO_writePin(LCD_RW_PORT_ID, LCD_RW_PIN_ID, LOGIC_LOW);
+	uint8 head = g_queueHead;
+	uint8 next = (head + 1) & (LCD_QUEUE_SIZE - 1);
+	uint8 depth;
+	uint8 sreg;
 
-	_delay_ms(1);
+	if((next == g_queueTail) && (BIT_IS_CLEAR(SREG,SREG_I)))
+	{
+		/* The ISR may have written the last byte a moment ago, wait the ticks it still counts and one more */
+		_delay_us(LCD_QUEUE_TICK_US);
+		while(g_queueWait != 0)
+		{
+			_delay_us(LCD_QUEUE_TICK_US);
+			g_queueWait--;
+		}
+
+		LCD_queueWriteTail(); /* The tail is next when the queue is full */
+
+		/* The ISR comes as soon as the interrupts are enabled again, the LCD should be ready for it */
+		LCD_waitExecution(g_queueRs[next], g_queueByte[next]);
+		g_queueWait = 0;
+	}
 
-	/* Enable(E) = 1 */
-	GPIO_writePin(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_HIGH);
+	while(next == g_queueTail)
+	{
+		POLL_WAIT(); /* Queue is full, wait for the ISR to write one byte */
+	}
 
-	_delay_ms(1);
+	g_queueRs[head] = rs;
+	g_queueByte[head] = byte;
+	g_queueHead = next;
 
-#if(LCD_DATA_BITS_MODE == 8)
-	/* Send character */
-	GPIO_writePort(LCD_DATA_PORT_ID, character);
+	depth = (next - g_queueTail) & (LCD_QUEUE_SIZE - 1);
+	if(depth > g_queueHighWatermark)
+	{
+		g_queueHighWatermark = depth;
+	}
+
+	sreg = SREG;
+	cli(); /* TIMSK is shared with the ICU interrupts */
+	TIMSK |= (1<<OCIE0); /* Start the background writer */
+	SREG = sreg;
+}
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+ISR(TIMER0_COMP_vect)
+{
+	if(g_queueWait != 0)
+	{
+		g_queueWait--; /* The LCD still executes the last byte */
+	}
+	else if(g_queueTail == g_queueHead)
+	{
+		TIMSK &= ~(1<<OCIE0); /* Queue is empty and the LCD is ready, stop until the next byte */
+	}
+	else
+	{
+		LCD_queueWriteTail();
+	}
+}
+#endif
+
+/*
+ * Description:
+ * Format an unsigned or fixed-point number right aligned in a field of width characters (see LCD_displayNumber).
+ * The string is not terminated, the function returns the width of the field.
+ * The digits are found by subtracting powers of ten, at most 42 subtractions for a uint16 and no division.
+ */
+static uint8 LCD_formatNumber(uint8 * string, uint16 value, uint8 width, uint8 decimals, uint8 pad)
+{
+	static const uint16 powersOfTen[5] PROGMEM = {10000, 1000, 100, 10, 1};
+	uint16 power;
+	uint8 digits[5];
+	uint8 first = 0; /* First digit to show */
+	uint8 length;
+	uint8 i;
+
+	if(decimals > 4)
+	{
+		decimals = 4;
+	}
+
+	for(i = 0; i < 5; i++)
+	{
+		digits[i] = '0';
+		power = pgm_read_word(&powersOfTen[i]);
+		while(value >= power)
+		{
+			value -= power;
+			digits[i]++;
+		}
+	}
 
-	_delay_ms(1);
+	/* Skip the leading zeros but keep the digit before the decimal point */
+	while((first < (4 - decimals)) && (digits[first] == '0'))
+	{
+		first++;
+	}
 
-	GPIO_writePin(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_LOW); /* Enable(E) = 0 */
+	length = (5 - first) + ((decimals != 0) ? 1 : 0);
+	if(width == 0)
+	{
+		width = length;
+	}
+	if(width > LCD_NUMBER_MAX_WIDTH)
+	{
+		width = LCD_NUMBER_MAX_WIDTH;
+	}
 
-	_delay_ms(1);
-#elif(LCD_DATA_BITS_MODE == 4)
-	/* out the last 4 bits of the required data to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
-#ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | (character & 0xF0);
+	if(length > width)
+	{
+		for(i = 0; i < width; i++)
+		{
+			string[i] = '*'; /* The number does not fit in the field */
+		}
+		return width;
+	}
+
+	for(i = 0; i < (width - length); i++)
+	{
+		string[i] = pad;
+	}
+	for(; first < 5; first++)
+	{
+		if((decimals != 0) && (first == (5 - decimals)))
+		{
+			string[i++] = '.';
+		}
+		string[i++] = digits[first];
+	}
+	return width;
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description:
+ * This function activate LCD pins and start the LCD by identify LCD mode and clear the screen.
+ */
+void LCD_init(void)
+{
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+	TWI_ConfigType twi_config = {TWI_BIT_RATE(LCD_PCF8574_SCL_HZ), TWI_PRESCALER_1};
+
+	TWI_init(&twi_config);
+	g_expanderControl = LCD_PCF8574_BACKLIGHT;
+	LCD_expanderWrite(g_expanderControl); /* RS = 0, R/W = 0, E = 0 and the backlight on */
 #else
-	lcd_port_value = (lcd_port_value & 0xF0) | ((character & 0xF0) >> 4);
+	/* Make control pins output */
+	GPIO_SETUP_PIN_DIRECTION_STATIC(LCD_RS_PORT_ID, LCD_RS_PIN_ID, PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION_STATIC(LCD_RW_PORT_ID, LCD_RW_PIN_ID, PIN_OUTPUT);
+	GPIO_SETUP_PIN_DIRECTION_STATIC(LCD_E_PORT_ID, LCD_E_PIN_ID, PIN_OUTPUT);
+	GPIO_WRITE_PIN_STATIC(LCD_E_PORT_ID, LCD_E_PIN_ID, LOGIC_LOW);
 #endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
 
-	_delay_ms(1);
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1);
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_HIGH); /* Enable LCD E=1 */
-	_delay_ms(1);
+	_delay_ms(LCD_POWER_ON_DELAY_MS); /* Wait for the LCD internal reset */
 
-	/* out the first 4 bits of the required data to the data bus D4 --> D7 */
-	lcd_port_value = GPIO_readPort(LCD_DATA_PORT_ID);
-#ifdef LCD_LAST_PORT_PINS
-	lcd_port_value = (lcd_port_value & 0x0F) | ((character & 0x0F) << 4);
-#else
-	lcd_port_value = (lcd_port_value & 0xF0) | (character & 0x0F);
+#if (LCD_BACKGROUND_WRITE == TRUE)
+	TIMSK &= ~(1<<OCIE0);
+	g_queueEnabled = FALSE; /* Write the initial commands directly */
+	g_queueHead = 0;
+	g_queueTail = 0;
+	g_queueWait = 0;
+	g_queueHighWatermark = 0;
+#endif
+
+	g_busyFlagValid = FALSE; /* Use the execution times until the interface is set */
+	g_lcdAddress = LCD_ADDRESS_UNKNOWN;
+	g_lcdAddressDecrement = FALSE; /* Entry mode after the internal reset: increment, no shift */
+#if (LCD_BACKEND == LCD_BACKEND_PARALLEL)
+	/* Make Data pins output, in 4-bit mode the other pins of the port are not touched */
+	GPIO_setupPortDirectionMasked(LCD_DATA_PORT_ID, LCD_DATA_PINS_MASK, PORT_OUTPUT);
+#endif
+
+	/*
+	 * Initialization by instruction (HD44780 datasheet): three 8-bit function sets bring the LCD to the 8-bit
+	 * interface from any state, even from the middle of a 4-bit transfer. Only D7-D4 are read here,
+	 * so in 4-bit mode every function set is one nibble.
+	 */
+#if (LCD_BACKEND == LCD_BACKEND_PARALLEL)
+	GPIO_WRITE_PIN_STATIC(LCD_RS_PORT_ID, LCD_RS_PIN_ID, LOGIC_LOW);
+	GPIO_WRITE_PIN_STATIC(LCD_RW_PORT_ID, LCD_RW_PIN_ID, LOGIC_LOW);
+	_delay_us(LCD_ADDRESS_SETUP_US);
+#endif
+#if(LCD_DATA_BITS_MODE == 8)
+	LCD_writeBus(LCD_FUNCTION_SET_EIGHT_BITS);
+	_delay_ms(LCD_RESET_FIRST_DELAY_MS);
+	LCD_writeBus(LCD_FUNCTION_SET_EIGHT_BITS);
+	_delay_us(LCD_RESET_DELAY_US);
+	LCD_writeBus(LCD_FUNCTION_SET_EIGHT_BITS);
+	_delay_us(LCD_RESET_DELAY_US);
+
+	LCD_sendCommand(LCD_TWO_LINES_EIGHT_BITS_MODE); /* Two lines 8-bit mode */
+#elif(LCD_DATA_BITS_MODE == 4)
+	LCD_writeBus(LCD_FUNCTION_SET_EIGHT_BITS >> 4);
+	LCD_BUS_DELAY_US(LCD_RESET_FIRST_DELAY_MS * 1000UL);
+	LCD_writeBus(LCD_FUNCTION_SET_EIGHT_BITS >> 4);
+	LCD_BUS_DELAY_US(LCD_RESET_DELAY_US);
+	LCD_writeBus(LCD_FUNCTION_SET_EIGHT_BITS >> 4);
+	LCD_BUS_DELAY_US(LCD_RESET_DELAY_US);
+	LCD_writeBus(LCD_FUNCTION_SET_FOUR_BITS >> 4); /* Switch to the 4-bit interface, still one nibble */
+	LCD_BUS_DELAY_US(LCD_EXECUTION_US);
+
+	LCD_sendCommand(LCD_TWO_LINES_FOUR_BITS_MODE); /* Two lines 4-bit mode, the first command in two nibbles */
+#endif
+	g_busyFlagValid = LCD_USE_BUSY_FLAG; /* The interface is set, the busy flag can be read */
+
+	/* Send initial commands */
+	LCD_sendCommand(LCD_CURSOR_OFF); /* Cursor off*/
+	LCD_sendCommand(LCD_CLEAR_SCREEN ); /* Clear Screen */
+
+	LCD_bufferClear(); /* The frame buffer starts equal to the clear LCD */
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+	/* Wait for the clear command then hand the LCD to the background writer */
+	LCD_waitExecution(LOGIC_LOW, LCD_CLEAR_SCREEN);
+	TCCR0 = (1<<WGM01) | (1<<CS01); /* CTC mode, F_CPU/8 */
+	OCR0 = LCD_QUEUE_OCR;
+	TCNT0 = 0;
+	g_queueEnabled = TRUE;
+#endif
+}
+
+/*
+ * Description:
+ * This function writes one byte to the LCD, rs is LOGIC_LOW for a command and LOGIC_HIGH for data.
+ * It waits until the LCD can take the byte by the busy flag or the execution time of the last byte.
+ */
+void LCD_writeByte(uint8 rs, uint8 byte)
+{
+	PERF_START(PERF_LCD_WRITE_BYTE);
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+	if(g_queueEnabled == TRUE)
+	{
+		LCD_queueByte(rs, byte); /* The Timer0 interrupt writes it at the pace of the LCD */
+		LCD_trackByte(rs, byte);
+		PERF_STOP(PERF_LCD_WRITE_BYTE);
+		return;
+	}
 #endif
-	GPIO_writePort(LCD_DATA_PORT_ID,lcd_port_value);
 
-	_delay_ms(1);
-	GPIO_writePin(LCD_E_PORT_ID,LCD_E_PIN_ID,LOGIC_LOW); /* Disable LCD E=0 */
-	_delay_ms(1);
+#if (LCD_USE_BUSY_FLAG == TRUE)
+	if(g_busyFlagValid == TRUE)
+	{
+		LCD_waitBusyFlag(); /* The LCD works on the last byte while the CPU prepares this one */
+	}
 #endif
+
+	LCD_sendByte(rs, byte);
+
+	if(g_busyFlagValid == FALSE)
+	{
+		LCD_waitExecution(rs, byte);
+	}
+
+	LCD_trackByte(rs, byte);
+
+	PERF_STOP(PERF_LCD_WRITE_BYTE);
+}
+
+/*
+ * Description:
+ * This function send commands to the LCD.
+ */
+void LCD_sendCommand(uint8 command)
+{
+	LCD_writeByte(LOGIC_LOW, command);
+}
+
+/*
+ * Description:
+ * This function send character to the LCD.
+ */
+void LCD_displayCharacter(uint8 character)
+{
+	LCD_writeByte(LOGIC_HIGH, character);
 }
 
 /*
@@ -197,21 +688,7 @@ void LCD_moveCursor(uint8 row, uint8 col)
 	uint8 lcd_memory_address;
 
 	/* Calculate the required address in the LCD DDRAM */
-	switch(row)
-	{
-		case 0:
-			lcd_memory_address=col;
-				break;
-		case 1:
-			lcd_memory_address=col+0x40;
-				break;
-		case 2:
-			lcd_memory_address=col+0x10;
-				break;
-		case 3:
-			lcd_memory_address=col+0x50;
-				break;
-	}
+	lcd_memory_address = g_rowAddress[row & 0x03] + col;
 	/* Move the LCD cursor to this specific address */
 	LCD_sendCommand(lcd_memory_address | LCD_SET_CURSOR_LOCATION); /*1000 0000 | memory address*/
 }
@@ -228,15 +705,73 @@ void LCD_displayStringRowColumn(uint8 row, uint8 col, const uint8* string)
 }
 
 
+/*
+ * Description:
+ * This function send a string stored in the program memory (PSTR or PROGMEM) to the LCD,
+ * so constant text does not take SRAM.
+ */
+void LCD_displayString_P(const char* string)
+{
+	uint8 character = pgm_read_byte(string);
+
+	while(character != '\0')
+	{
+		LCD_displayCharacter(character);
+		string++;
+		character = pgm_read_byte(string);
+	}
+}
+
+/*
+ * Description:
+ * This function can select the position of the cursor and write a string stored in the program memory directly.
+ */
+void LCD_displayStringRowColumn_P(uint8 row, uint8 col, const char* string)
+{
+	LCD_moveCursor(row, col);    /* Go to the required LCD position */
+	LCD_displayString_P(string); /* Display the string */
+}
+
 /*
  * Description:
  * This function convert integer number into ASSCI to present the value on the LCD.
  */
 void LCD_intgerToString(int intiger)
 {
-	   uint8 buff[16]; /* String to hold the ASCII result */
-	   itoa(intiger,buff,10); /* Use itoa C function to convert the data to its corresponding ASCII value, 10 for decimal */
-	   LCD_displayString(buff); /* Display the string */
+	uint8 buff[LCD_NUMBER_MAX_WIDTH]; /* String to hold the ASCII result */
+	uint8 length;
+	uint8 i;
+
+	if(intiger < 0)
+	{
+		LCD_displayCharacter('-');
+	}
+	length = LCD_formatNumber(buff, (intiger < 0) ? (uint16)(-(sint32)intiger) : (uint16)intiger, 0, 0, ' ');
+	for(i = 0; i < length; i++)
+	{
+		LCD_displayCharacter(buff[i]); /* Display the string */
+	}
+}
+
+/*
+ * Description:
+ * This function displays an unsigned number right aligned in a field of width characters, filled with pad (' ' or '0').
+ * If decimals is not zero the number is a fixed-point value and is shown with a decimal point before its last decimals digits,
+ * e.g. 1234 with 1 decimal is "123.4". A width of zero gives a field as wide as the number.
+ * A number wider than the field is shown as '*' characters, so the field never grows.
+ * The digits are found by subtracting powers of ten, no division is done.
+ */
+void LCD_displayNumber(uint16 value, uint8 width, uint8 decimals, uint8 pad)
+{
+	uint8 buff[LCD_NUMBER_MAX_WIDTH];
+	uint8 length;
+	uint8 i;
+
+	length = LCD_formatNumber(buff, value, width, decimals, pad);
+	for(i = 0; i < length; i++)
+	{
+		LCD_displayCharacter(buff[i]);
+	}
 }
 
 /*
@@ -248,3 +783,154 @@ void LCD_clearScreen(void)
 	LCD_sendCommand(LCD_CLEAR_SCREEN ); /* Clear Screen */
 }
 
+/*
+ * Description:
+ * This function writes a character into the frame buffer, it is shown on the LCD by LCD_flush.
+ * Cells out of the display are ignored.
+ */
+void LCD_bufferWriteCharacter(uint8 row, uint8 col, uint8 character)
+{
+	if((row < LCD_ROWS) && (col < LCD_COLS))
+	{
+		g_frameBuffer[row][col] = character;
+	}
+}
+
+/*
+ * Description:
+ * This function writes a string into the frame buffer starting at the required cell,
+ * the string is cut at the end of the row.
+ */
+void LCD_bufferWriteString(uint8 row, uint8 col, const uint8* string)
+{
+	while(((*string) != '\0') && (col < LCD_COLS))
+	{
+		LCD_bufferWriteCharacter(row, col, *string);
+		string++;
+		col++;
+	}
+}
+
+/*
+ * Description:
+ * This function writes a string stored in the program memory into the frame buffer starting at the required cell,
+ * the string is cut at the end of the row.
+ */
+void LCD_bufferWriteString_P(uint8 row, uint8 col, const char* string)
+{
+	uint8 character = pgm_read_byte(string);
+
+	while((character != '\0') && (col < LCD_COLS))
+	{
+		LCD_bufferWriteCharacter(row, col, character);
+		string++;
+		col++;
+		character = pgm_read_byte(string);
+	}
+}
+
+/*
+ * Description:
+ * This function writes an integer number as ASCII into the frame buffer starting at the required cell.
+ */
+void LCD_bufferWriteInteger(uint8 row, uint8 col, int intiger)
+{
+	if(intiger < 0)
+	{
+		LCD_bufferWriteCharacter(row, col, '-');
+		col++;
+	}
+	LCD_bufferWriteNumber(row, col, (intiger < 0) ? (uint16)(-(sint32)intiger) : (uint16)intiger, 0, 0, ' ');
+}
+
+/*
+ * Description:
+ * This function writes an unsigned or fixed-point number into the frame buffer starting at the required cell,
+ * formatted as LCD_displayNumber does.
+ */
+void LCD_bufferWriteNumber(uint8 row, uint8 col, uint16 value, uint8 width, uint8 decimals, uint8 pad)
+{
+	uint8 buff[LCD_NUMBER_MAX_WIDTH];
+	uint8 length;
+	uint8 i;
+
+	length = LCD_formatNumber(buff, value, width, decimals, pad);
+	for(i = 0; i < length; i++)
+	{
+		LCD_bufferWriteCharacter(row, col + i, buff[i]); /* Cells out of the display are dropped */
+	}
+}
+
+/*
+ * Description:
+ * This function fills the frame buffer with spaces.
+ */
+void LCD_bufferClear(void)
+{
+	uint8 row;
+	uint8 col;
+
+	for(row = 0; row < LCD_ROWS; row++)
+	{
+		for(col = 0; col < LCD_COLS; col++)
+		{
+			g_frameBuffer[row][col] = ' ';
+		}
+	}
+}
+
+/*
+ * Description:
+ * This function sends the cells of the frame buffer that differ from the LCD to the LCD.
+ * Changed cells next to each other are written in one run, the cursor is moved only at the
+ * start of a run, so a frame that did not change costs no LCD write.
+ */
+void LCD_flush(void)
+{
+	uint8 row;
+	uint8 col;
+	uint8 address;
+	PERF_START(PERF_LCD_FLUSH);
+	TRACE(TRACE_LCD_FLUSH_START, 0);
+
+	for(row = 0; row < LCD_ROWS; row++)
+	{
+		for(col = 0; col < LCD_COLS; col++)
+		{
+			if(g_frameBuffer[row][col] != g_lcdShadow[row][col])
+			{
+				address = g_rowAddress[row] + col;
+				if(address != g_lcdAddress)
+				{
+					/* Start of a run, the cells of a run follow the address counter of the LCD */
+					LCD_sendCommand(address | LCD_SET_CURSOR_LOCATION);
+				}
+				LCD_displayCharacter(g_frameBuffer[row][col]); /* Updates the shadow and the address */
+			}
+		}
+	}
+
+	TRACE(TRACE_LCD_FLUSH_END, 0);
+	PERF_STOP(PERF_LCD_FLUSH);
+}
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+/*
+ * Description:
+ * This function returns the number of bytes waiting in the queue of the background writer.
+ */
+uint8 LCD_getQueueDepth(void)
+{
+	return (g_queueHead - g_queueTail) & (LCD_QUEUE_SIZE - 1);
+}
+
+/*
+ * Description:
+ * This function returns the biggest number of bytes that waited in the queue since LCD_init.
+ * A high watermark equal to LCD_QUEUE_SIZE - 1 means the application waited for the LCD.
+ */
+uint8 LCD_getQueueHighWatermark(void)
+{
+	return g_queueHighWatermark;
+}
+#endif
@@ -17,12 +17,40 @@
  *                      		Include Header	                               *
  *******************************************************************************/
 #include "std_types.h"
+#include "board_config.h"
 
 /*******************************************************************************
  *                      		Definitions 	                               *
  *******************************************************************************/
+/*
+ * LCD backend: LCD_BACKEND_PARALLEL drives the LCD pins by the GPIO driver, LCD_BACKEND_PCF8574 drives
+ * a PCF8574 I2C expander (LCD backpack) by the TWI driver, so the LCD takes only SCL (PC0) and SDA (PC1).
+ * The PCF8574 backend changes the defaults of the modes below to the only ones it supports.
+ */
+#define LCD_BACKEND_PARALLEL			0
+#define LCD_BACKEND_PCF8574				1
+
+#ifndef LCD_BACKEND
+#define LCD_BACKEND						LCD_BACKEND_PARALLEL
+#endif
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+/* The backpack wires only D4 --> D7, and the TWI driver queues the bytes so the LCD is never read */
+#ifndef LCD_DATA_BITS_MODE
+#define LCD_DATA_BITS_MODE 4
+#endif
+#ifndef LCD_USE_BUSY_FLAG
+#define LCD_USE_BUSY_FLAG				FALSE
+#endif
+#ifndef LCD_BACKGROUND_WRITE
+#define LCD_BACKGROUND_WRITE			FALSE
+#endif
+#endif
+
 /* Mode sellect */
+#ifndef LCD_DATA_BITS_MODE
 #define LCD_DATA_BITS_MODE 8
+#endif
 
 #if((LCD_DATA_BITS_MODE != 4) && (LCD_DATA_BITS_MODE != 8))
 
@@ -33,7 +61,9 @@
 #if (LCD_DATA_BITS_MODE == 4)
 
 /* if LCD_LAST_PORT_PINS is defined in the code, the LCD driver will use the last 4 pins in the gpio port for for data.
- * To use the first four pins in the gpio port for data just remove LCD_LAST_PORT_PINS */
+ * To use the first four pins in the gpio port for data just remove LCD_LAST_PORT_PINS.
+ * The LCD writes only its own 4 pins with one masked port write, so the other 4 pins of the port
+ * can be used by other drivers (e.g. the trigger pins of more ultrasonic sensors). */
 #define LCD_LAST_PORT_PINS
 
 #ifdef LCD_LAST_PORT_PINS
@@ -44,21 +74,129 @@
 
 #endif
 
-/* LCD ports and pins configurations */
-#define LCD_RS_PORT_ID					PORTB_ID
-#define LCD_RS_PIN_ID  					PIN0_ID
+/* LCD ports and pins configurations, the pins are assigned in board_config.h */
+#define LCD_RS_PORT_ID					BOARD_PORT_ID(BOARD_LCD_RS)
+#define LCD_RS_PIN_ID  					BOARD_PIN_ID(BOARD_LCD_RS)
 
-#define LCD_RW_PORT_ID					PORTB_ID
-#define LCD_RW_PIN_ID 					PIN1_ID
+#define LCD_RW_PORT_ID					BOARD_PORT_ID(BOARD_LCD_RW)
+#define LCD_RW_PIN_ID 					BOARD_PIN_ID(BOARD_LCD_RW)
 
-#define LCD_E_PORT_ID					PORTB_ID
-#define LCD_E_PIN_ID					PIN2_ID
+#define LCD_E_PORT_ID					BOARD_PORT_ID(BOARD_LCD_E)
+#define LCD_E_PIN_ID					BOARD_PIN_ID(BOARD_LCD_E)
 
 /* 8-bit mode port configurations */
-#define LCD_DATA_PORT_ID				PORTA_ID
+#define LCD_DATA_PORT_ID				BOARD_LCD_DATA_PORT_ID
+
+/* Pins of LCD_DATA_PORT_ID used by the LCD, D7 carries the busy flag when the LCD is read */
+#if (LCD_DATA_BITS_MODE == 8)
+#define LCD_DATA_PINS_MASK				0xFF
+#define LCD_BUSY_FLAG_PIN_ID			PIN7_ID
+#else
+#define LCD_DATA_PINS_MASK				(0x0F << LCD_FIRST_DATA_PIN_ID)
+#define LCD_BUSY_FLAG_PIN_ID			(LCD_FIRST_DATA_PIN_ID + 3)
+#endif
+
+/*
+ * If LCD_USE_BUSY_FLAG is TRUE the driver reads the busy flag through the RW pin before every write,
+ * so a byte takes only the time the LCD really needs (about 40us) instead of fixed delays.
+ * If it is FALSE (RW tied to ground) the driver waits the datasheet execution times after every write.
+ * The busy flag is not used before the function set of LCD_init, which uses the execution times too.
+ */
+#ifndef LCD_USE_BUSY_FLAG
+#define LCD_USE_BUSY_FLAG				TRUE
+#endif
+
+/* HD44780 timing in micro seconds (datasheet minimum values with margin) */
+#define LCD_ADDRESS_SETUP_US			0.1  /* RS and RW stable before E rises (tAS) */
+#define LCD_ENABLE_PULSE_US				0.5  /* E high time (PWEH) */
+#define LCD_DATA_DELAY_US				0.4  /* Data valid after E rises when reading (tDDR) */
+#define LCD_EXECUTION_US				40   /* Most of the commands and the data writes */
+#define LCD_CLEAR_EXECUTION_US			1640 /* Clear display and return home */
+#define LCD_POWER_ON_DELAY_MS			40   /* Vcc rise to the first command */
+#define LCD_RESET_FIRST_DELAY_MS		5    /* After the first function set of the initialization by instruction */
+#define LCD_RESET_DELAY_US				150  /* After the second and the third function sets */
+
+/* Number of busy flag reads before the driver stops waiting for a missing LCD */
+#define LCD_BUSY_FLAG_MAX_POLLS			1000
+
+/*
+ * If LCD_BACKGROUND_WRITE is TRUE, LCD_writeByte (and every function that writes to the LCD) only puts the byte
+ * in a queue of LCD_QUEUE_SIZE bytes after LCD_init, and the Timer0 compare interrupt writes one byte every
+ * LCD_QUEUE_TICK_US, which is longer than the execution time of a byte. The caller waits only when the queue is full,
+ * or writes the oldest byte itself at the pace of the LCD if it runs with the interrupts disabled.
+ * Timer0 is used by the LCD driver in this mode.
+ */
+#ifndef LCD_BACKGROUND_WRITE
+#define LCD_BACKGROUND_WRITE			FALSE
+#endif
+
+#define LCD_QUEUE_SIZE					64 /* Power of 2 */
+#define LCD_QUEUE_TICK_US				50
+
+#ifndef F_CPU
+#error "F_CPU is not defined, pass it on the compiler command line (-DF_CPU=8000000UL)"
+#endif
+
+/* Timer0 runs at F_CPU/8 in CTC mode, OCR0 gives one compare match every LCD_QUEUE_TICK_US */
+#define LCD_QUEUE_OCR					(((F_CPU / 8UL) * LCD_QUEUE_TICK_US) / 1000000UL - 1)
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+#if ((LCD_QUEUE_SIZE & (LCD_QUEUE_SIZE - 1)) != 0) || (LCD_QUEUE_SIZE > 128)
+#error "LCD_QUEUE_SIZE should be a power of 2 not bigger than 128"
+#endif
+#if (LCD_QUEUE_TICK_US < LCD_EXECUTION_US) || (LCD_QUEUE_OCR > 255) || (LCD_QUEUE_OCR < 1)
+#error "LCD_QUEUE_TICK_US should be longer than LCD_EXECUTION_US and fit in Timer0 at F_CPU/8"
+#endif
+#elif (LCD_BACKGROUND_WRITE != FALSE)
+#error "LCD_BACKGROUND_WRITE should be equal to TRUE or FALSE"
+#endif
+
+#if (LCD_BACKEND == LCD_BACKEND_PCF8574)
+/*
+ * PCF8574 backend configurations. The expander pins are P0 = RS, P1 = RW, P2 = E, P3 = backlight and
+ * P4 --> P7 = D4 --> D7 as on the common backpacks. Every LCD byte is 4 or 5 expander bytes queued in the TWI driver,
+ * which sends them from its interrupt, so the LCD is write only in 4-bit mode and the execution times are
+ * given by queuing more expander bytes that do not change the pins.
+ */
+#define LCD_PCF8574_ADDRESS				0x27 /* 7-bit address with A2:A0 = 111 (0x3F for the PCF8574A) */
+#define LCD_PCF8574_SCL_HZ				100000UL /* The PCF8574 is specified up to 100 kHz */
+
+#define LCD_PCF8574_RS					(1<<0)
+#define LCD_PCF8574_RW					(1<<1)
+#define LCD_PCF8574_E					(1<<2)
+#define LCD_PCF8574_BACKLIGHT			(1<<3)
+
+/* Time of one expander byte on the bus (8 bits and the ACK) in micro seconds, rounded down so a delay is never short */
+#define LCD_PCF8574_BYTE_US				((9UL * 1000000UL) / LCD_PCF8574_SCL_HZ)
+
+/* Number of expander bytes that take at least us micro seconds on the bus */
+#define LCD_PCF8574_PAD_BYTES(us)		(((us) + LCD_PCF8574_BYTE_US - 1) / LCD_PCF8574_BYTE_US)
+
+#if (LCD_DATA_BITS_MODE != 4) || (LCD_USE_BUSY_FLAG != FALSE) || (LCD_BACKGROUND_WRITE != FALSE)
+#error "The PCF8574 backend needs LCD_DATA_BITS_MODE 4, LCD_USE_BUSY_FLAG FALSE and LCD_BACKGROUND_WRITE FALSE, remove these overrides"
+#endif
+#if ((2 * LCD_PCF8574_BYTE_US) < LCD_EXECUTION_US) || (LCD_PCF8574_PAD_BYTES(LCD_RESET_FIRST_DELAY_MS * 1000UL) > 255)
+#error "LCD_PCF8574_SCL_HZ is too fast for the LCD execution times or too slow for the delays of LCD_init"
+#endif
+#elif (LCD_BACKEND != LCD_BACKEND_PARALLEL)
+#error "LCD_BACKEND should be equal to LCD_BACKEND_PARALLEL or LCD_BACKEND_PCF8574"
+#endif
+
+/* Size of the display, the LCD_buffer functions keep a copy of these cells in RAM */
+#define LCD_ROWS						2
+#define LCD_COLS						16
+
+#if ((LCD_ROWS < 1) || (LCD_ROWS > 4) || (LCD_COLS < 1) || (LCD_COLS > 20))
+#error "LCD_ROWS should be from 1 to 4 and LCD_COLS from 1 to 20"
+#endif
+
+/* Widest field of the number formatter: 5 digits of a uint16, the decimal point and the sign */
+#define LCD_NUMBER_MAX_WIDTH			7
 
 
 /* LCD Common commands */
+#define LCD_FUNCTION_SET_EIGHT_BITS		0x30
+#define LCD_FUNCTION_SET_FOUR_BITS		0x20
 #define LCD_CLEAR_SCREEN 				0x01
 #define LCD_RETURN_HOME					0x02
 #define LCD_TWO_LINES_EIGHT_BITS_MODE   0x38
@@ -77,6 +215,15 @@
  */
 void LCD_init(void);
 
+/*
+ * Description:
+ * This function writes one byte to the LCD, rs is LOGIC_LOW for a command and LOGIC_HIGH for data.
+ * It waits until the LCD can take the byte by the busy flag or the execution time of the last byte.
+ * With LCD_BACKEND_PCF8574 the byte is queued as expander writes in the TWI driver.
+ * With LCD_BACKGROUND_WRITE the byte is queued and written later by the Timer0 interrupt.
+ */
+void LCD_writeByte(uint8 rs, uint8 byte);
+
 /*
  * Description:
  * This function send commands to the LCD.
@@ -107,18 +254,105 @@ void LCD_moveCursor(uint8 row, uint8 col);
  */
 
 void LCD_displayStringRowColumn(uint8 row, uint8 col, const uint8* string);
+
+/*
+ * Description:
+ * This function send a string stored in the program memory (PSTR or PROGMEM) to the LCD,
+ * so constant text does not take SRAM.
+ */
+void LCD_displayString_P(const char* string);
+
+/*
+ * Description:
+ * This function can select the position of the cursor and write a string stored in the program memory directly.
+ */
+void LCD_displayStringRowColumn_P(uint8 row, uint8 col, const char* string);
+
 /*
  * Description:
  * This function convert integer number into ASSCI to present the value on the LCD.
  */
 void LCD_intgerToString(int intiger);
 
+/*
+ * Description:
+ * This function displays an unsigned number right aligned in a field of width characters, filled with pad (' ' or '0').
+ * If decimals is not zero the number is a fixed-point value and is shown with a decimal point before its last decimals digits,
+ * e.g. 1234 with 1 decimal is "123.4". A width of zero gives a field as wide as the number.
+ * A number wider than the field is shown as '*' characters, so the field never grows.
+ * The digits are found by subtracting powers of ten, no division is done.
+ */
+void LCD_displayNumber(uint16 value, uint8 width, uint8 decimals, uint8 pad);
+
 /*
  * Description:
  * This function clear the LCD screen.
  */
 void LCD_clearScreen(void);
 
+/*
+ * Description:
+ * This function writes a character into the frame buffer, it is shown on the LCD by LCD_flush.
+ * Cells out of the display are ignored.
+ */
+void LCD_bufferWriteCharacter(uint8 row, uint8 col, uint8 character);
+
+/*
+ * Description:
+ * This function writes a string into the frame buffer starting at the required cell,
+ * the string is cut at the end of the row.
+ */
+void LCD_bufferWriteString(uint8 row, uint8 col, const uint8* string);
+
+/*
+ * Description:
+ * This function writes a string stored in the program memory into the frame buffer starting at the required cell,
+ * the string is cut at the end of the row.
+ */
+void LCD_bufferWriteString_P(uint8 row, uint8 col, const char* string);
+
+/*
+ * Description:
+ * This function writes an integer number as ASCII into the frame buffer starting at the required cell.
+ */
+void LCD_bufferWriteInteger(uint8 row, uint8 col, int intiger);
+
+/*
+ * Description:
+ * This function writes an unsigned or fixed-point number into the frame buffer starting at the required cell,
+ * formatted as LCD_displayNumber does.
+ */
+void LCD_bufferWriteNumber(uint8 row, uint8 col, uint16 value, uint8 width, uint8 decimals, uint8 pad);
+
+/*
+ * Description:
+ * This function fills the frame buffer with spaces.
+ */
+void LCD_bufferClear(void);
+
+/*
+ * Description:
+ * This function sends the cells of the frame buffer that differ from the LCD to the LCD.
+ * Changed cells next to each other are written in one run, the cursor is moved only at the
+ * start of a run, so a frame that did not change costs no LCD write.
+ */
+void LCD_flush(void);
+
+#if (LCD_BACKGROUND_WRITE == TRUE)
+/*
+ * Description:
+ * This function returns the number of bytes waiting in the queue of the background writer.
+ */
+uint8 LCD_getQueueDepth(void);
+
+/*
+ * Description:
+ * This function returns the biggest number of bytes that waited in the queue since LCD_init.
+ * A high watermark equal to LCD_QUEUE_SIZE - 1 means the application waited for the LCD.
+ */
+uint8 LCD_getQueueHighWatermark(void);
+#endif
+
 
 
 #endif /* LCD_H_ */
@@ -8,47 +8,93 @@
  */
 
 
-#define F_CPU 8000000
-
 #include <avr/io.h>
+#include <avr/pgmspace.h> /* The constant text is kept in the program memory */
 #include "ultrasonic.h"
 #include "lcd.h"
 #include "icu.h"
 
 uint16 g_distance; 	/* Variable to save the distance value in it */
 
+/*
+ * Layout of the first LCD row: label, right aligned value field and unit.
+ * In mm the value is shown in cm with one decimal (1234 mm is "123.4 cm").
+ */
+#if (ULTRASONIC_DISTANCE_UNIT == ULTRASONIC_UNIT_MM)
+#define DISPLAY_LABEL			"Dist = "
+#define DISPLAY_VALUE_COL		7
+#define DISPLAY_VALUE_WIDTH		5
+#define DISPLAY_VALUE_DECIMALS	1
+#define DISPLAY_NO_TARGET		"  ---"
+#define DISPLAY_UNIT_COL		13
+#else
+#define DISPLAY_LABEL			"Distance = "
+#define DISPLAY_VALUE_COL		11
+#define DISPLAY_VALUE_WIDTH		3
+#define DISPLAY_VALUE_DECIMALS	0
+#define DISPLAY_NO_TARGET		"---"
+#define DISPLAY_UNIT_COL		14
+#endif
+
+/* Sensors in their mounting order, from the sensor table of board_config.h */
+static const Ultrasonic_SensorConfigType g_sensors[ULTRASONIC_SENSOR_COUNT] = {
+	BOARD_ULTRASONIC_SENSORS(ULTRASONIC_SENSOR_CONFIG)
+};
+
 int main(void)
 {
+	Ultrasonic_ResultType result; /* Result of the last completed ping */
+
 	SREG |= (1<<7); /* Activate interrupt */
 
 	LCD_init(); 	/* Activate LCD */
 
 	/*
 	 * Activate ultrasonic sensor with initiation of ICU driver.
-	 * Ultrasonic_edgeProcessing function is called back by the ICU driver used in Ultrasonic_init.
+	 * The ICU driver queues the echo edges and Ultrasonic_getResult processes them in this loop.
 	 */
-	Ultrasonic_init();
+	Ultrasonic_init(g_sensors);
 
-	LCD_displayString("Distance = "); /* This string will appear on LCD */
+	LCD_bufferWriteString_P(0,0,PSTR(DISPLAY_LABEL)); /* This string will appear on LCD */
+	LCD_bufferWriteString_P(0,DISPLAY_UNIT_COL,PSTR("cm")); /* This string will appear on LCD */
+	LCD_flush();
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+	Ultrasonic_startPeriodic(); /* Timer1 pings the sensor at a fixed rate and the echoes are measured in the background */
+#else
+	Ultrasonic_startMeasurement(); /* Send the first ping, the ICU completes it in the background */
+#endif
 
 	/* This loop will monitor the distance continuously from range 2 to 400 cm */
 	while(1)
 	{
-		g_distance = Ultrasonic_readDistance();/* Get the distance */
-
-		LCD_moveCursor(0,11); /* move cursor to the right place every loop to prevent over right */
-		if(g_distance >= 100) /* if the value is more than 100 display it normally */
+		if(Ultrasonic_getResult(&result) == FALSE)
 		{
-			LCD_intgerToString(g_distance); /* Convert Distance value to string and then display the value on LCD LCD */
+			continue; /* The echo did not arrive yet, the CPU is free for other work here */
 		}
-		else if(g_distance < 100) /* if the value is less than 100 display it normally and the tenth number will be replaced with space ' ' */
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+		Ultrasonic_startMeasurement(); /* Send the next ping while the LCD shows this one */
+#endif
+
+		if(result.sensor != 0)
 		{
-			LCD_intgerToString(g_distance); /* Convert Distance value to string and then display the value on LCD LCD */
-			LCD_displayCharacter(' ');
+			continue; /* Only the first sensor is shown on the LCD */
 		}
 
-		LCD_moveCursor(0,14); /* move cursor to the right place every loop to prevent over right */
+		g_distance = result.distance;/* Get the distance */
+
+		/* Only the frame buffer is written here, LCD_flush sends the cells that changed */
+		if(result.status == ULTRASONIC_NO_TARGET) /* Nothing in range, the echo timed out */
+		{
+			LCD_bufferWriteString_P(0,DISPLAY_VALUE_COL,PSTR(DISPLAY_NO_TARGET));
+		}
+		else
+		{
+			/* The field has a fixed width and is right aligned, so it always covers the old value */
+			LCD_bufferWriteNumber(0,DISPLAY_VALUE_COL,g_distance,DISPLAY_VALUE_WIDTH,DISPLAY_VALUE_DECIMALS,' ');
+		}
 
-		LCD_displayString("cm"); /* This string will appear on LCD */
+		LCD_flush();
 	}
 }
@@ -0,0 +1,144 @@
+/****************************************************************************************
+ *
+ * Module: PERF
+ *
+ * File Name: perf.c
+ *
+ * Discretion: Source file for the cycle instrumentation of the interrupts and the hot paths
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "perf.h"
+
+#if (PERF_ENABLE == TRUE)
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+typedef struct{
+	uint32 count;
+	uint16 min; /* Timer1 ticks */
+	uint16 max;
+	uint32 sum;
+}Perf_RecordType;
+
+/*******************************************************************************
+ *                         	  Global variables                                 *
+ *******************************************************************************/
+static volatile Perf_RecordType g_perfRecords[PERF_POINT_COUNT];
+static volatile uint32 g_perfCounters[PERF_COUNTER_COUNT];
+
+/* CPU cycles of one Timer1 tick for every clock select value of TCCR1B (CS12:0), 0 for the stopped or external clock */
+static const uint16 g_perfTickCycles[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+/*******************************************************************************
+ *                         	Function Declaration                                *
+ *******************************************************************************/
+/*
+ * Description:
+ * Function to add the time of one pass of a measuring point in Timer1 ticks, used by PERF_STOP.
+ * The points are written from the ISRs and from the application, so the record is updated with the interrupts disabled.
+ */
+void Perf_record(Perf_PointType point, uint16 ticks)
+{
+	volatile Perf_RecordType * record = &g_perfRecords[point];
+	uint8 sreg = SREG;
+
+	if(g_perfTickCycles[TCCR1B & 0x07] == 0)
+	{
+		return; /* Timer1 is stopped before ICU_init or has no CPU clock, there is no time to record */
+	}
+
+	cli();
+	if((record->count == 0) || (ticks < record->min))
+	{
+		record->min = ticks;
+	}
+	if(ticks > record->max)
+	{
+		record->max = ticks;
+	}
+	record->sum += ticks;
+	record->count++;
+	SREG = sreg;
+}
+
+/*
+ * Description:
+ * Function to add one to a counter, used by PERF_COUNT.
+ */
+void Perf_count(Perf_CounterType counter)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	g_perfCounters[counter]++;
+	SREG = sreg;
+}
+
+/*
+ * Description:
+ * Function to get the statistics of a measuring point in CPU cycles.
+ * The ticks are converted with the current Timer1 prescaler, so the resolution is one prescaler period.
+ */
+void Perf_getStats(Perf_PointType point, Perf_StatsType * Stats_Ptr)
+{
+	Perf_RecordType record;
+	uint16 tickCycles = g_perfTickCycles[TCCR1B & 0x07];
+	uint8 sreg = SREG;
+
+	cli();
+	record = g_perfRecords[point];
+	SREG = sreg;
+
+	Stats_Ptr->count = record.count;
+	Stats_Ptr->min = (uint32)record.min * tickCycles;
+	Stats_Ptr->max = (uint32)record.max * tickCycles;
+	Stats_Ptr->mean = (record.count != 0) ? ((record.sum / record.count) * tickCycles) : 0;
+}
+
+/*
+ * Description:
+ * Function to get the value of a counter.
+ */
+uint32 Perf_getCounter(Perf_CounterType counter)
+{
+	uint32 value;
+	uint8 sreg = SREG;
+
+	cli();
+	value = g_perfCounters[counter];
+	SREG = sreg;
+	return value;
+}
+
+/*
+ * Description:
+ * Function to clear the statistics table and the counters.
+ */
+void Perf_reset(void)
+{
+	uint8 i;
+	uint8 sreg = SREG;
+
+	cli();
+	for(i = 0; i < PERF_POINT_COUNT; i++)
+	{
+		g_perfRecords[i].count = 0;
+		g_perfRecords[i].min = 0;
+		g_perfRecords[i].max = 0;
+		g_perfRecords[i].sum = 0;
+	}
+	for(i = 0; i < PERF_COUNTER_COUNT; i++)
+	{
+		g_perfCounters[i] = 0;
+	}
+	SREG = sreg;
+}
+
+#endif /* PERF_ENABLE */
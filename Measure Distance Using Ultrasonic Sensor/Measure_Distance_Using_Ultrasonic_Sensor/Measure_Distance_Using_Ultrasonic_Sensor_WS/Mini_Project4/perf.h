@@ -0,0 +1,126 @@
+/****************************************************************************************
+ *
+ * Module: PERF
+ *
+ * File Name: perf.h
+ *
+ * Discretion: Header file for the cycle instrumentation of the interrupts and the hot paths
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef PERF_H_
+#define PERF_H_
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "std_types.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/*
+ * If PERF_ENABLE is TRUE the instrumented code reads Timer1 at the start and at the end of every measuring point
+ * and counts the events, the results are read by Perf_getStats and Perf_getCounter.
+ * If it is FALSE the PERF_* macros are empty and the module adds no code and no RAM.
+ * Timer1 is the free running timer of the ICU driver, so the times are valid only after ICU_init.
+ * A time includes the interrupts that came inside the measured code and the read of TCNT1 at its end.
+ */
+#ifndef PERF_ENABLE
+#define PERF_ENABLE					FALSE
+#endif
+
+#if (PERF_ENABLE == TRUE)
+#define PERF_START(point)			uint16 perf_start_##point = Perf_now()
+#define PERF_STOP(point)			Perf_record((point), (uint16)(Perf_now() - perf_start_##point))
+#define PERF_COUNT(counter)			Perf_count(counter)
+#elif (PERF_ENABLE == FALSE)
+#define PERF_START(point)
+#define PERF_STOP(point)
+#define PERF_COUNT(counter)
+#else
+#error "PERF_ENABLE should be equal to TRUE or FALSE"
+#endif
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+/* Measuring points, every one has a line in the statistics table */
+typedef enum{
+	PERF_ICU_CAPTURE_ISR,            /* ISR(TIMER1_CAPT_vect) */
+	PERF_ULTRASONIC_EDGE_PROCESSING, /* Ultrasonic_edgeProcessing */
+	PERF_LCD_WRITE_BYTE,             /* LCD_writeByte, with the wait for the LCD */
+	PERF_LCD_FLUSH,                  /* LCD_flush, one display update */
+	PERF_POINT_COUNT
+}Perf_PointType;
+
+typedef enum{
+	PERF_MISSED_ECHO,                /* Pings completed by the timeout without an echo */
+	PERF_STRAY_EDGE,                 /* Edges with no measurement waiting for them or of another sensor */
+	PERF_COUNTER_COUNT
+}Perf_CounterType;
+
+/* Statistics of one measuring point, the times are in CPU cycles */
+typedef struct{
+	uint32 count;
+	uint32 min;
+	uint32 max;
+	uint32 mean;
+}Perf_StatsType;
+
+/*******************************************************************************
+ *                         	Function Prototypes                                *
+ *******************************************************************************/
+#if (PERF_ENABLE == TRUE)
+/*
+ * Description:
+ * Function to read Timer1, the interrupts are disabled while its two bytes are read.
+ */
+static inline uint16 Perf_now(void)
+{
+	uint8 sreg = SREG;
+	uint16 now;
+
+	cli();
+	now = TCNT1;
+	SREG = sreg;
+	return now;
+}
+
+/*
+ * Description:
+ * Function to add the time of one pass of a measuring point in Timer1 ticks, used by PERF_STOP.
+ */
+void Perf_record(Perf_PointType point, uint16 ticks);
+
+/*
+ * Description:
+ * Function to add one to a counter, used by PERF_COUNT.
+ */
+void Perf_count(Perf_CounterType counter);
+
+/*
+ * Description:
+ * Function to get the statistics of a measuring point in CPU cycles.
+ * The ticks are converted with the current Timer1 prescaler, so the resolution is one prescaler period.
+ */
+void Perf_getStats(Perf_PointType point, Perf_StatsType * Stats_Ptr);
+
+/*
+ * Description:
+ * Function to get the value of a counter.
+ */
+uint32 Perf_getCounter(Perf_CounterType counter);
+
+/*
+ * Description:
+ * Function to clear the statistics table and the counters.
+ */
+void Perf_reset(void);
+#endif
+
+#endif /* PERF_H_ */
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Decode the telemetry frames the ultrasonic driver sends on the UART (ULTRASONIC_TELEMETRY) into CSV.
+
+A frame is 16 bytes, little endian (see ultrasonic.h):
+    AA 55 SS FF TTTTTTTT KKKKKKKK DDDD CCCC
+    SS sequence number counted per sensor, FF sensor << 4 | ICU prescaler << 1 | status,
+    T timestamp and K echo width in ICU ticks, D distance, C CRC-16/XMODEM of the bytes from SS to DDDD.
+The decoder searches for the sync bytes, so it starts in the middle of a stream and skips frames with a
+wrong CRC. The gaps in the sequence numbers of each sensor are the frames the driver dropped when the UART
+queue was full.
+
+The input is a file of captured bytes, the standard input or a serial port (--port, needs pyserial).
+
+usage: telemetry_decode.py [--f-cpu 8000000] [--port /dev/ttyUSB0 [--baud 250000]] [-o samples.csv] [capture.bin]
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = b"\xaa\x55"
+FRAME_SIZE = 16
+STATUS_NAMES = {0: "ok", 1: "no_target"}
+
+# ICU clock divider of ICU_Prescaler in icu.h, the external clocks have no known rate
+PRESCALER_DIV = {1: 1, 2: 8, 3: 64, 4: 256, 5: 1024}
+
+
+def crc_xmodem(data):
+    """CRC-16/XMODEM, the _crc_xmodem_update of avr-libc."""
+    crc = 0
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+class Decoder:
+    """Find the frames in the received bytes and count the CRC errors and the missing sequence numbers."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.frames = 0
+        self.crc_errors = 0
+        self.missing = 0
+        self.sequence = {}  # Last sequence number of every sensor
+
+    def feed(self, data):
+        """Return the frames completed by the new bytes as tuples of the fields."""
+        self.buffer += data
+        frames = []
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                del self.buffer[:max(len(self.buffer) - 1, 0)]  # Keep a last 0xAA, it may be the first sync byte
+                return frames
+            del self.buffer[:start]
+            if len(self.buffer) < FRAME_SIZE:
+                return frames
+
+            frame = bytes(self.buffer[:FRAME_SIZE])
+            sequence, flags, timestamp, ticks, distance, crc = struct.unpack_from("<BBIIHH", frame, 2)
+            if crc != crc_xmodem(frame[2:FRAME_SIZE - 2]):
+                self.crc_errors += 1
+                del self.buffer[:1]  # A false sync in the data of a frame, search again after it
+                continue
+            del self.buffer[:FRAME_SIZE]
+
+            sensor = flags >> 4
+            if sensor in self.sequence:
+                self.missing += (sequence - self.sequence[sensor] - 1) & 0xFF
+            self.sequence[sensor] = sequence
+            self.frames += 1
+            frames.append((sequence, sensor, (flags >> 1) & 0x07, flags & 0x01, timestamp, ticks, distance))
+
+
+def write_csv(output, frames, f_cpu):
+    for sequence, sensor, prescaler, status, timestamp, ticks, distance in frames:
+        div = PRESCALER_DIV.get(prescaler)
+        if div is None:
+            time_s = echo_us = ""
+        else:
+            time_s = "%.6f" % (timestamp * div / f_cpu)
+            echo_us = "%.1f" % (ticks * div * 1e6 / f_cpu)
+        output.write("%d,%d,%s,%s,%d,%s,%d\n" % (sequence, sensor, STATUS_NAMES.get(status, status), time_s, ticks,
+                                                   echo_us, distance))
+
+
+def read_chunks(args):
+    """Yield the received bytes from the serial port, the file or the standard input."""
+    if args.port:
+        import serial  # pyserial, only needed for a live port
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            while True:
+                yield port.read(4096)
+    else:
+        source = open(args.capture, "rb") if args.capture else sys.stdin.buffer
+        with source:
+            while True:
+                chunk = source.read(4096)
+                if not chunk:
+                    return
+                yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", help="captured TXD bytes, standard input if not given")
+    parser.add_argument("--port", help="serial port to read live, instead of a capture")
+    parser.add_argument("--baud", type=int, default=250000, help="baud rate of --port (ULTRASONIC_TELEMETRY_BAUD)")
+    parser.add_argument("--f-cpu", type=float, default=8e6, help="F_CPU of the board, for the times (default 8 MHz)")
+    parser.add_argument("-o", "--output", help="CSV file, standard output if not given")
+    args = parser.parse_args()
+
+    output = open(args.output, "w") if args.output else sys.stdout
+    output.write("sequence,sensor,status,time_s,ticks,echo_us,distance\n")
+    decoder = Decoder()
+    try:
+        for chunk in read_chunks(args):
+            write_csv(output, decoder.feed(chunk), args.f_cpu)
+            output.flush()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if output is not sys.stdout:
+            output.close()
+        print("%d frames, %d missing, %d CRC errors" % (decoder.frames, decoder.missing, decoder.crc_errors),
+              file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
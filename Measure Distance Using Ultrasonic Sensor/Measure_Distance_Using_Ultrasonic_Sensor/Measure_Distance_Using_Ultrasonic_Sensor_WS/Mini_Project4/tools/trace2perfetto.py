@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Decode the trace dumps of trace.c into a Chrome trace JSON for ui.perfetto.dev or chrome://tracing.
+
+A dump is the text Trace_dump sends:
+    TRACE CC LLLL
+    EE TTTT AAAA      (one line per record: hex event, TCNT1 time, argument)
+    END
+Other lines (the application output on the same serial port) are skipped. Every dump in the input
+becomes one process of the timeline, since the time is not continuous from one dump to the next.
+
+The 16-bit times are unwrapped by their differences. Timer1 overflows are in the trace, so two
+records are never more than one Timer1 period apart and the difference is always right.
+
+usage: trace2perfetto.py [--tick-us 1.0] [-o trace.json] [dump.txt]
+"""
+
+import argparse
+import json
+import sys
+
+# Event values of Trace_EventType in trace.h
+TRIGGER = 1
+RISING_EDGE = 2
+FALLING_EDGE = 3
+TIMEOUT = 4
+CONVERSION = 5
+LCD_FLUSH_START = 6
+LCD_FLUSH_END = 7
+TIMER1_OVERFLOW = 8
+
+# Tracks of one dump
+TRACK_PING = 1
+TRACK_ECHO = 2
+TRACK_LCD = 3
+TRACK_TIMER = 4
+TRACK_NAMES = {TRACK_PING: "ping", TRACK_ECHO: "echo", TRACK_LCD: "lcd", TRACK_TIMER: "timer1"}
+
+
+def read_dumps(lines):
+    """Return the dumps as lists of (event, time, arg) and the number of records lost before each."""
+    dumps = []
+    records = None
+    lost = 0
+    for line in lines:
+        fields = line.split()
+        if len(fields) == 3 and fields[0] == "TRACE":
+            records = []
+            lost = int(fields[2], 16)
+        elif records is not None and fields == ["END"]:
+            dumps.append((records, lost))
+            records = None
+        elif records is not None and len(fields) == 3:
+            try:
+                records.append(tuple(int(field, 16) for field in fields))
+            except ValueError:
+                records = None  # Broken dump, wait for the next one
+    return dumps
+
+
+def unwrap(records):
+    """Return the records with the times in ticks from the first record, and the 16-bit arguments that are ICR1/OCR1B
+    values converted to the same time base."""
+    result = []
+    now = 0
+    last = None
+    for event, stamp, arg in records:
+        if last is not None:
+            now += (stamp - last) & 0xFFFF
+        last = stamp
+        edge = None
+        if event in (RISING_EDGE, FALLING_EDGE, TIMEOUT):
+            edge = now - ((stamp - arg) & 0xFFFF)  # The edge was captured before the ISR wrote the record
+        result.append((event, now, arg, edge))
+    return result
+
+
+def convert(dumps, tick_us):
+    events = []
+    for pid, (records, lost) in enumerate(dumps, start=1):
+        events.append({"ph": "M", "pid": pid, "name": "process_name",
+                       "args": {"name": "dump %d (%d records, %d lost before)" % (pid, len(records), lost)}})
+        for tid, name in TRACK_NAMES.items():
+            events.append({"ph": "M", "pid": pid, "tid": tid, "name": "thread_name", "args": {"name": name}})
+
+        ping = None
+        rise = None
+        flush = None
+        for event, ticks, arg, edge in unwrap(records):
+            us = ticks * tick_us
+            if event == TRIGGER:
+                ping = (us, arg & 0xFF, arg >> 8)
+                rise = None
+            elif event == RISING_EDGE:
+                rise = edge
+                events.append({"ph": "i", "s": "t", "pid": pid, "tid": TRACK_ECHO, "ts": edge * tick_us,
+                               "name": "rising edge", "args": {"isr_latency_us": us - edge * tick_us}})
+            elif event == FALLING_EDGE:
+                if rise is not None:
+                    events.append({"ph": "X", "pid": pid, "tid": TRACK_ECHO, "ts": rise * tick_us,
+                                   "dur": (edge - rise) * tick_us, "name": "echo",
+                                   "args": {"width_ticks": edge - rise, "isr_latency_us": us - edge * tick_us}})
+                rise = None
+            elif event == TIMEOUT:
+                events.append({"ph": "i", "s": "t", "pid": pid, "tid": TRACK_ECHO, "ts": us, "name": "timeout"})
+            elif event == CONVERSION:
+                if ping is not None:
+                    start, sensor, sequence = ping
+                    events.append({"ph": "X", "pid": pid, "tid": TRACK_PING, "ts": start, "dur": us - start,
+                                   "name": "ping sensor %d" % sensor,
+                                   "args": {"sequence": sequence, "distance": arg}})
+                events.append({"ph": "C", "pid": pid, "ts": us, "name": "distance", "args": {"distance": arg}})
+                ping = None
+            elif event == LCD_FLUSH_START:
+                flush = us
+            elif event == LCD_FLUSH_END:
+                if flush is not None:
+                    events.append({"ph": "X", "pid": pid, "tid": TRACK_LCD, "ts": flush, "dur": us - flush,
+                                   "name": "LCD_flush"})
+                flush = None
+            elif event == TIMER1_OVERFLOW:
+                events.append({"ph": "i", "s": "t", "pid": pid, "tid": TRACK_TIMER, "ts": us, "name": "overflow",
+                               "args": {"count": arg}})
+            else:
+                events.append({"ph": "i", "s": "t", "pid": pid, "tid": TRACK_TIMER, "ts": us,
+                               "name": "event %d" % event, "args": {"arg": arg}})
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", nargs="?", help="captured serial output, standard input if not given")
+    parser.add_argument("--tick-us", type=float, default=1.0,
+                        help="microseconds of one Timer1 tick, prescaler / F_CPU in MHz (default 1.0: 8 at 8 MHz)")
+    parser.add_argument("-o", "--output", help="JSON file, standard output if not given")
+    args = parser.parse_args()
+
+    source = open(args.dump, errors="replace") if args.dump else sys.stdin
+    with source:
+        dumps = read_dumps(source)
+    if not dumps:
+        sys.exit("no trace dump found")
+
+    trace = convert(dumps, args.tick_us)
+    if args.output:
+        with open(args.output, "w") as output:
+            json.dump(trace, output, indent=1)
+    else:
+        json.dump(trace, sys.stdout, indent=1)
+    print("%d dumps, %d records" % (len(dumps), sum(len(records) for records, _ in dumps)), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,139 @@
+/****************************************************************************************
+ *
+ * Module: TRACE
+ *
+ * File Name: trace.c
+ *
+ * Discretion: Source file for the event trace ring buffer
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "trace.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if (TRACE_ENABLE == TRUE)
+
+/*******************************************************************************
+ *                         	  Global variables                                 *
+ *******************************************************************************/
+static volatile Trace_RecordType g_traceBuffer[TRACE_BUFFER_SIZE];
+static volatile uint8 g_traceHead = 0;   /* Next record to write */
+static volatile uint8 g_traceCount = 0;  /* Records in the ring */
+static volatile uint16 g_traceLost = 0;  /* Records overwritten since the last dump */
+static volatile boolean g_traceRunning = TRUE;
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+static void Trace_sendHex(void(*a_ptr)(uint8 byte), uint16 value, uint8 digits)
+{
+	uint8 digit;
+
+	while(digits != 0)
+	{
+		digits--;
+		digit = (value >> (4 * digits)) & 0x0F;
+		a_ptr((digit < 10) ? ('0' + digit) : ('A' + digit - 10));
+	}
+}
+
+static void Trace_sendString(void(*a_ptr)(uint8 byte), const char * string)
+{
+	while(*string != '\0')
+	{
+		a_ptr(*string);
+		string++;
+	}
+}
+
+/*******************************************************************************
+ *                         	Function Declaration                                *
+ *******************************************************************************/
+/*
+ * Description:
+ * Function to write one record in the ring, the oldest record is overwritten when the ring is full.
+ * It can be called from the ISRs and from the application.
+ */
+void Trace_write(Trace_EventType event, uint16 arg)
+{
+	uint8 sreg = SREG;
+	uint8 head;
+
+	cli(); /* The ISRs write records too, and TCNT1 is read in two bytes */
+	if(g_traceRunning == TRUE)
+	{
+		head = g_traceHead;
+		g_traceBuffer[head].event = event;
+		g_traceBuffer[head].timestamp = TCNT1;
+		g_traceBuffer[head].arg = arg;
+		g_traceHead = (head + 1) & (TRACE_BUFFER_SIZE - 1);
+
+		if(g_traceCount < TRACE_BUFFER_SIZE)
+		{
+			g_traceCount++;
+		}
+		else if(g_traceLost != 0xFFFF)
+		{
+			g_traceLost++;
+		}
+	}
+	SREG = sreg;
+}
+
+/*
+ * Description:
+ * Function to send the records from the oldest to the newest by the required byte output function, e.g. of a UART.
+ * The trace is stopped while the records are sent and starts again empty.
+ */
+void Trace_dump(void(*a_ptr)(uint8 byte))
+{
+	uint8 index;
+	uint8 i;
+
+	g_traceRunning = FALSE; /* The ring does not change while it is sent */
+
+	Trace_sendString(a_ptr, "TRACE ");
+	Trace_sendHex(a_ptr, g_traceCount, 2);
+	a_ptr(' ');
+	Trace_sendHex(a_ptr, g_traceLost, 4);
+	a_ptr('\n');
+
+	index = (g_traceHead - g_traceCount) & (TRACE_BUFFER_SIZE - 1);
+	for(i = 0; i < g_traceCount; i++)
+	{
+		Trace_sendHex(a_ptr, g_traceBuffer[index].event, 2);
+		a_ptr(' ');
+		Trace_sendHex(a_ptr, g_traceBuffer[index].timestamp, 4);
+		a_ptr(' ');
+		Trace_sendHex(a_ptr, g_traceBuffer[index].arg, 4);
+		a_ptr('\n');
+		index = (index + 1) & (TRACE_BUFFER_SIZE - 1);
+	}
+	Trace_sendString(a_ptr, "END\n");
+
+	Trace_clear();
+}
+
+/*
+ * Description:
+ * Function to remove all the records.
+ */
+void Trace_clear(void)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	g_traceHead = 0;
+	g_traceCount = 0;
+	g_traceLost = 0;
+	g_traceRunning = TRUE;
+	SREG = sreg;
+}
+
+#endif /* TRACE_ENABLE */
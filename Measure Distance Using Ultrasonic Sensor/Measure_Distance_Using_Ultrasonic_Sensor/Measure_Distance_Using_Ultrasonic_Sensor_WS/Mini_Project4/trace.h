@@ -0,0 +1,97 @@
+/****************************************************************************************
+ *
+ * Module: TRACE
+ *
+ * File Name: trace.h
+ *
+ * Discretion: Header file for the event trace ring buffer
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "std_types.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/*
+ * If TRACE_ENABLE is TRUE the drivers write a record (event, Timer1 time, argument) in a RAM ring
+ * at every trigger, echo edge, timeout, conversion and LCD flush. The ring keeps the last
+ * TRACE_BUFFER_SIZE records, Trace_dump sends them as text lines that tools/trace2perfetto.py decodes.
+ * If it is FALSE the TRACE macro is empty and the module adds no code and no RAM.
+ * The time is TCNT1, the free running timer of the ICU driver. Timer1 overflows are traced too,
+ * so the decoder can rebuild the full time from the 16-bit values.
+ */
+#define TRACE_ENABLE				FALSE
+
+/* Number of records in the ring (power of 2), 5 bytes of RAM each */
+#define TRACE_BUFFER_SIZE			32
+
+#if (TRACE_ENABLE == TRUE)
+#if ((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) != 0) || (TRACE_BUFFER_SIZE > 128)
+#error "TRACE_BUFFER_SIZE should be a power of 2 not bigger than 128"
+#endif
+#define TRACE(event, arg)			Trace_write((event), (uint16)(arg))
+#elif (TRACE_ENABLE == FALSE)
+#define TRACE(event, arg)
+#else
+#error "TRACE_ENABLE should be equal to TRUE or FALSE"
+#endif
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+/* Events of the trace, the values are decoded by tools/trace2perfetto.py and should not change */
+typedef enum{
+	TRACE_TRIGGER = 1,       /* Measurement armed for a ping, argument: sequence << 8 | sensor */
+	TRACE_RISING_EDGE = 2,   /* Capture ISR, argument: ICR1 of the edge */
+	TRACE_FALLING_EDGE = 3,  /* Capture ISR, argument: ICR1 of the edge */
+	TRACE_TIMEOUT = 4,       /* Echo timeout ISR, argument: OCR1B */
+	TRACE_CONVERSION = 5,    /* Result published, argument: distance, 0 without a target */
+	TRACE_LCD_FLUSH_START = 6,
+	TRACE_LCD_FLUSH_END = 7,
+	TRACE_TIMER1_OVERFLOW = 8 /* Argument: low 16 bits of the overflow count */
+}Trace_EventType;
+
+/* One record of the ring */
+typedef struct{
+	uint8 event;
+	uint16 timestamp; /* TCNT1 when the record was written */
+	uint16 arg;
+}Trace_RecordType;
+
+/*******************************************************************************
+ *                         	Function Prototypes                                *
+ *******************************************************************************/
+#if (TRACE_ENABLE == TRUE)
+/*
+ * Description:
+ * Function to write one record in the ring, the oldest record is overwritten when the ring is full.
+ * It can be called from the ISRs and from the application.
+ */
+void Trace_write(Trace_EventType event, uint16 arg);
+
+/*
+ * Description:
+ * Function to send the records from the oldest to the newest by the required byte output function, e.g. of a UART.
+ * The trace is stopped while the records are sent and starts again empty.
+ * Format: "TRACE CC LLLL" then one "EE TTTT AAAA" line per record (hex event, time, argument)
+ * then "END". CC is the number of records and LLLL the number of records overwritten before the dump.
+ */
+void Trace_dump(void(*a_ptr)(uint8 byte));
+
+/*
+ * Description:
+ * Function to remove all the records.
+ */
+void Trace_clear(void);
+#endif
+
+#endif /* TRACE_H_ */
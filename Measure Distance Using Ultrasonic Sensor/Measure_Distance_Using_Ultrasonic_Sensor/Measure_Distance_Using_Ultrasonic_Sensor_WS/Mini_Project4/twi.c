@@ -0,0 +1,192 @@
+/****************************************************************************************
+ *
+ * Module: TWI(I2C)
+ *
+ * File Name: twi.c
+ *
+ * Discretion: Source file for the AVR TWI(I2C) master transmitter driver
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "twi.h"
+#include "common_macros.h"
+#include <avr/io.h>
+#include <avr/interrupt.h> /* For TWI ISR */
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+/* Status codes of the master transmitter in TWSR (prescaler bits masked) */
+#define TWI_STATUS_MASK			0xF8
+#define TWI_START				0x08
+#define TWI_REPEATED_START		0x10
+#define TWI_MT_SLA_W_ACK		0x18
+#define TWI_MT_DATA_ACK			0x28
+
+/* TWCR values, TWINT is written with one to clear it and start the next action */
+#define TWI_CONTROL_NEXT		((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+#define TWI_CONTROL_START		((1<<TWINT) | (1<<TWSTA) | (1<<TWEN) | (1<<TWIE))
+#define TWI_CONTROL_RESTART		((1<<TWINT) | (1<<TWSTA) | (1<<TWSTO) | (1<<TWEN) | (1<<TWIE))
+#define TWI_CONTROL_STOP		((1<<TWINT) | (1<<TWSTO) | (1<<TWEN))
+
+/* Single producer (application) single consumer (TWI ISR) queue of the bytes to send */
+static volatile uint8 g_queue[TWI_QUEUE_SIZE];
+static volatile uint8 g_queueHead = 0; /* Written by the application only */
+static volatile uint8 g_queueTail = 0; /* Written by the ISR only */
+
+static volatile boolean g_busy = FALSE;  /* A transfer runs, set by the application and cleared by the ISR */
+static volatile uint8 g_address = 0;     /* Slave of the queued bytes, changed only while the bus is idle */
+static volatile uint8 g_retries = 0;
+static volatile uint16 g_errorCount = 0;
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+ISR(TWI_vect)
+{
+	uint8 tail = g_queueTail;
+
+	switch(TWSR & TWI_STATUS_MASK)
+	{
+	case TWI_START:
+	case TWI_REPEATED_START:
+		TWDR = (uint8)(g_address << 1); /* SLA+W */
+		TWCR = TWI_CONTROL_NEXT;
+		break;
+
+	case TWI_MT_DATA_ACK:
+		tail = (tail + 1) & (TWI_QUEUE_SIZE - 1); /* Free the slot only after the slave took the byte */
+		g_queueTail = tail;
+		g_retries = 0;
+		/* Send the next byte as after the SLA+W */
+	case TWI_MT_SLA_W_ACK:
+		if(tail != g_queueHead)
+		{
+			TWDR = g_queue[tail];
+			TWCR = TWI_CONTROL_NEXT;
+		}
+		else
+		{
+			TWCR = TWI_CONTROL_STOP; /* Queue is empty, end the transfer and disable the interrupt */
+			g_busy = FALSE;
+		}
+		break;
+
+	default:
+		/* NACK of the address or the data, lost arbitration or bus error */
+		g_errorCount++;
+		g_retries++;
+		if(g_retries > TWI_MAX_RETRIES)
+		{
+			g_retries = 0;
+			g_queueTail = g_queueHead; /* The slave does not answer, drop the queued bytes */
+			TWCR = TWI_CONTROL_STOP;
+			g_busy = FALSE;
+		}
+		else
+		{
+			TWCR = TWI_CONTROL_RESTART; /* STOP then START again, the byte that failed is sent again */
+		}
+		break;
+	}
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description : Function to initialize the TWI driver
+ * 	1. Set the SCL frequency by the bit rate and the prescaler.
+ * 	2. Enable the TWI module, the interrupt is enabled only while a transfer runs.
+ * 	3. Empty the queue.
+ */
+void TWI_init(const TWI_ConfigType * Config_Ptr)
+{
+	TWCR = 0;
+
+	g_queueHead = 0;
+	g_queueTail = 0;
+	g_busy = FALSE;
+	g_retries = 0;
+	g_errorCount = 0;
+
+	TWBR = Config_Ptr->bit_rate;
+	TWSR = (TWSR & 0xFC) | (Config_Ptr->prescaler & 0x03);
+
+	/* Enable the TWI module, it drives SCL (PC0) and SDA (PC1) */
+	TWCR = (1<<TWEN);
+}
+
+/*
+ * Description: Function to send one byte to the slave with the 7-bit address.
+ * The byte is queued and sent by the TWI interrupt, a transfer is started if the bus is idle.
+ * If the address differs from the address of the queued bytes the function waits until they are sent.
+ */
+void TWI_writeByte(uint8 address, uint8 data)
+{
+	uint8 head = g_queueHead;
+	uint8 next = (head + 1) & (TWI_QUEUE_SIZE - 1);
+	uint8 sreg;
+
+	if(address != g_address)
+	{
+		while(g_busy == TRUE)
+		{
+			POLL_WAIT(); /* The queued bytes belong to the old slave */
+		}
+		g_address = address;
+	}
+
+	while(next == g_queueTail)
+	{
+		POLL_WAIT(); /* Queue is full, wait for the ISR to send one byte */
+	}
+
+	g_queue[head] = data;
+	g_queueHead = next;
+
+	sreg = SREG;
+	cli(); /* The ISR clears g_busy */
+	if(g_busy == FALSE)
+	{
+		g_busy = TRUE;
+		while(BIT_IS_SET(TWCR, TWSTO)); /* The STOP of the last transfer is still on the bus */
+		TWCR = TWI_CONTROL_START;
+	}
+	SREG = sreg;
+}
+
+/*
+ * Description: Function to get the number of bytes waiting in the queue.
+ */
+uint8 TWI_getQueueDepth(void)
+{
+	return (g_queueHead - g_queueTail) & (TWI_QUEUE_SIZE - 1);
+}
+
+/*
+ * Description: Function to check if all the queued bytes are sent and the STOP condition is given.
+ */
+boolean TWI_isIdle(void)
+{
+	return ((g_busy == FALSE) && BIT_IS_CLEAR(TWCR, TWSTO));
+}
+
+/*
+ * Description: Function to get the number of NACKs, lost arbitrations and bus errors since TWI_init.
+ */
+uint16 TWI_getErrorCount(void)
+{
+	uint16 count;
+	uint8 sreg = SREG;
+
+	cli(); /* 16-bit variable written by the ISR */
+	count = g_errorCount;
+	SREG = sreg;
+	return count;
+}
@@ -0,0 +1,91 @@
+/****************************************************************************************
+ *
+ * Module: TWI(I2C)
+ *
+ * File Name: twi.h
+ *
+ * Discretion: Header file for the AVR TWI(I2C) master transmitter driver
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef TWI_H_
+#define TWI_H_
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "std_types.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/*
+ * TWI_writeByte puts the byte in a queue of TWI_QUEUE_SIZE bytes and the TWI interrupt sends the queue
+ * in one transfer (START, SLA+W, the bytes, STOP), so the caller waits only when the queue is full.
+ * The global interrupt should be enabled before the first TWI_writeByte.
+ */
+#define TWI_QUEUE_SIZE				64 /* Power of 2 */
+
+/* Number of times a transfer is started again after a NACK or a lost arbitration before its bytes are dropped */
+#define TWI_MAX_RETRIES				3
+
+#if ((TWI_QUEUE_SIZE & (TWI_QUEUE_SIZE - 1)) != 0) || (TWI_QUEUE_SIZE > 128)
+#error "TWI_QUEUE_SIZE should be a power of 2 not bigger than 128"
+#endif
+
+#ifndef F_CPU
+#error "F_CPU is not defined, pass it on the compiler command line (-DF_CPU=8000000UL)"
+#endif
+
+/* TWBR value of the required SCL frequency with TWI_PRESCALER_1: SCL = F_CPU / (16 + 2 * TWBR) */
+#define TWI_BIT_RATE(scl_hz)		((((F_CPU) / (scl_hz)) - 16UL) / 2UL)
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+typedef enum{
+	TWI_PRESCALER_1, TWI_PRESCALER_4, TWI_PRESCALER_16, TWI_PRESCALER_64
+}TWI_Prescaler;
+
+typedef struct{
+	uint8 bit_rate;          /* TWBR, use TWI_BIT_RATE */
+	TWI_Prescaler prescaler; /* TWPS1:0 */
+}TWI_ConfigType;
+
+/*******************************************************************************
+ *                         	Function Prototypes                                *
+ *******************************************************************************/
+
+/*
+ * Description : Function to initialize the TWI driver
+ * 	1. Set the SCL frequency by the bit rate and the prescaler.
+ * 	2. Enable the TWI module, the interrupt is enabled only while a transfer runs.
+ * 	3. Empty the queue.
+ */
+void TWI_init(const TWI_ConfigType * Config_Ptr);
+
+/*
+ * Description: Function to send one byte to the slave with the 7-bit address.
+ * The byte is queued and sent by the TWI interrupt, a transfer is started if the bus is idle.
+ * If the address differs from the address of the queued bytes the function waits until they are sent.
+ */
+void TWI_writeByte(uint8 address, uint8 data);
+
+/*
+ * Description: Function to get the number of bytes waiting in the queue.
+ */
+uint8 TWI_getQueueDepth(void);
+
+/*
+ * Description: Function to check if all the queued bytes are sent and the STOP condition is given.
+ */
+boolean TWI_isIdle(void);
+
+/*
+ * Description: Function to get the number of NACKs, lost arbitrations and bus errors since TWI_init.
+ */
+uint16 TWI_getErrorCount(void);
+
+#endif /* TWI_H_ */
@@ -0,0 +1,165 @@
+/****************************************************************************************
+ *
+ * Module: UART
+ *
+ * File Name: uart.c
+ *
+ * Discretion: Source file for the AVR USART transmitter driver
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "uart.h"
+#include "common_macros.h"
+#include <avr/io.h>
+#include <avr/interrupt.h> /* For USART ISR */
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+/* Queue of the bytes to send, the producers add whole blocks with the interrupts disabled and the ISR sends them */
+static volatile uint8 g_queue[UART_TX_QUEUE_SIZE];
+static volatile uint8 g_queueHead = 0; /* Written by the producers only */
+static volatile uint8 g_queueTail = 0; /* Written by the ISR only */
+
+static volatile uint16 g_dropCount = 0;
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+ISR(USART_UDRE_vect)
+{
+	uint8 tail = g_queueTail;
+
+	if(tail != g_queueHead)
+	{
+		UDR = g_queue[tail];
+		g_queueTail = (tail + 1) & (UART_TX_QUEUE_SIZE - 1);
+	}
+	else
+	{
+		CLEAR_BIT(UCSRB, UDRIE); /* Queue is empty, UDRE stays set and would call the ISR again */
+	}
+}
+
+/*******************************************************************************
+ *                      	Private Functions                                  *
+ *******************************************************************************/
+/*
+ * Description: Put the block in the queue if it fits and start the ISR, the caller disables the interrupts.
+ */
+static boolean UART_enqueue(const uint8 * data, uint8 size)
+{
+	uint8 head = g_queueHead;
+
+	if((uint8)((g_queueTail - head - 1) & (UART_TX_QUEUE_SIZE - 1)) < size)
+	{
+		return FALSE;
+	}
+
+	while(size != 0)
+	{
+		g_queue[head] = *data;
+		head = (head + 1) & (UART_TX_QUEUE_SIZE - 1);
+		data++;
+		size--;
+	}
+	g_queueHead = head;
+
+	SET_BIT(UCSRB, UDRIE); /* The ISR comes as soon as the data register is empty */
+	return TRUE;
+}
+
+/*******************************************************************************
+ *                      	Function Definitions                               *
+ *******************************************************************************/
+/*
+ * Description : Function to initialize the UART driver
+ * 	1. Set the baud rate in the double speed mode.
+ * 	2. Set the frame format to 8 data bits, no parity and 1 stop bit.
+ * 	3. Enable the transmitter, it drives TXD (PD1). The interrupt is enabled only while the queue has bytes.
+ * 	4. Empty the queue.
+ */
+void UART_init(const UART_ConfigType * Config_Ptr)
+{
+	UCSRB = 0;
+
+	g_queueHead = 0;
+	g_queueTail = 0;
+	g_dropCount = 0;
+
+	/* U2X = 1 for double transmission speed, the baud rate error is smaller with the 8 MHz clock */
+	UCSRA = (1<<U2X);
+
+	/* URSEL = 1 to write UCSRC, UCSZ1:0 = 11 for 8-bit data, asynchronous, no parity and 1 stop bit */
+	UCSRC = (1<<URSEL) | (1<<UCSZ1) | (1<<UCSZ0);
+
+	/* UBRRH is written first, writing UBRRL updates the prescaler */
+	UBRRH = (uint8)((Config_Ptr->baud_prescale >> 8) & 0x0F);
+	UBRRL = (uint8)Config_Ptr->baud_prescale;
+
+	UCSRB = (1<<TXEN);
+}
+
+/*
+ * Description: Function to queue a block of bytes, it can be called from an ISR.
+ * Return FALSE and count a dropped block if the free space of the queue is smaller than the block.
+ */
+boolean UART_send(const uint8 * data, uint8 size)
+{
+	boolean queued;
+	uint8 sreg = SREG;
+
+	cli(); /* The block is queued as a whole even if an ISR sends another block */
+	queued = UART_enqueue(data, size);
+	if(queued == FALSE)
+	{
+		g_dropCount++;
+	}
+	SREG = sreg;
+	return queued;
+}
+
+/*
+ * Description: Function to queue one byte, it waits while the queue is full.
+ * It should not be called with the interrupts disabled.
+ */
+void UART_sendByte(uint8 data)
+{
+	boolean queued;
+	uint8 sreg;
+
+	do
+	{
+		sreg = SREG;
+		cli();
+		queued = UART_enqueue(&data, 1);
+		SREG = sreg; /* The ISR sends one byte of a full queue here */
+	}while(queued == FALSE);
+}
+
+/*
+ * Description: Function to get the number of bytes waiting in the queue.
+ */
+uint8 UART_getQueueDepth(void)
+{
+	return (g_queueHead - g_queueTail) & (UART_TX_QUEUE_SIZE - 1);
+}
+
+/*
+ * Description: Function to get the number of blocks UART_send dropped since UART_init.
+ */
+uint16 UART_getDropCount(void)
+{
+	uint16 count;
+	uint8 sreg = SREG;
+
+	cli(); /* 16-bit variable written from the ISRs of the producers */
+	count = g_dropCount;
+	SREG = sreg;
+	return count;
+}
@@ -0,0 +1,88 @@
+/****************************************************************************************
+ *
+ * Module: UART
+ *
+ * File Name: uart.h
+ *
+ * Discretion: Header file for the AVR USART transmitter driver
+ *
+ * Author: Abdelrahman Ehab
+ *
+ ****************************************************************************************/
+
+#ifndef UART_H_
+#define UART_H_
+
+/*******************************************************************************
+ *                    	     	Include Header	                               *
+ *******************************************************************************/
+#include "std_types.h"
+
+/*******************************************************************************
+ *                      		Definitions 	                               *
+ *******************************************************************************/
+/*
+ * UART_send puts the bytes in a queue of UART_TX_QUEUE_SIZE bytes and the data register empty interrupt
+ * sends them, so the caller never waits for the line. A block that does not fit in the free space is
+ * dropped as a whole and counted, a receiver never sees a part of it.
+ * The frame is 8 data bits, no parity and 1 stop bit, the receiver is not enabled.
+ */
+#define UART_TX_QUEUE_SIZE			64 /* Power of 2 */
+
+#if ((UART_TX_QUEUE_SIZE & (UART_TX_QUEUE_SIZE - 1)) != 0) || (UART_TX_QUEUE_SIZE > 128)
+#error "UART_TX_QUEUE_SIZE should be a power of 2 not bigger than 128"
+#endif
+
+#ifndef F_CPU
+#error "F_CPU is not defined, pass it on the compiler command line (-DF_CPU=8000000UL)"
+#endif
+
+/* UBRR value of the required baud rate in the double speed mode (U2X): baud = F_CPU / (8 * (UBRR + 1)) */
+#define UART_BAUD_PRESCALE(baud)	((((F_CPU) + (4UL * (baud))) / (8UL * (baud))) - 1UL)
+
+/* Baud rate the UBRR value really gives, to check the error against the required one at compile time */
+#define UART_ACTUAL_BAUD(baud)		((F_CPU) / (8UL * (UART_BAUD_PRESCALE(baud) + 1UL)))
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+typedef struct{
+	uint16 baud_prescale; /* UBRR, use UART_BAUD_PRESCALE */
+}UART_ConfigType;
+
+/*******************************************************************************
+ *                         	Function Prototypes                                *
+ *******************************************************************************/
+
+/*
+ * Description : Function to initialize the UART driver
+ * 	1. Set the baud rate in the double speed mode.
+ * 	2. Set the frame format to 8 data bits, no parity and 1 stop bit.
+ * 	3. Enable the transmitter, it drives TXD (PD1). The interrupt is enabled only while the queue has bytes.
+ * 	4. Empty the queue.
+ */
+void UART_init(const UART_ConfigType * Config_Ptr);
+
+/*
+ * Description: Function to queue a block of bytes, it can be called from an ISR.
+ * Return FALSE and count a dropped block if the free space of the queue is smaller than the block.
+ */
+boolean UART_send(const uint8 * data, uint8 size);
+
+/*
+ * Description: Function to queue one byte, it waits while the queue is full.
+ * It should not be called with the interrupts disabled.
+ */
+void UART_sendByte(uint8 data);
+
+/*
+ * Description: Function to get the number of bytes waiting in the queue.
+ */
+uint8 UART_getQueueDepth(void);
+
+/*
+ * Description: Function to get the number of blocks UART_send dropped since UART_init.
+ */
+uint16 UART_getDropCount(void);
+
+#endif /* UART_H_ */
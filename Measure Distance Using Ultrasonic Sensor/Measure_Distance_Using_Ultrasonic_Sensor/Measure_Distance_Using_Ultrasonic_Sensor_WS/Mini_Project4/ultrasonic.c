@@ -14,85 +14,913 @@
  *                      		Include Header	                               *
  *******************************************************************************/
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 #include "ultrasonic.h"
+#include "common_macros.h"
 #include "icu.h"
 #include "gpio.h"
+#include "perf.h"
+#include "trace.h"
+#if (ULTRASONIC_TELEMETRY == TRUE)
+#include <util/crc16.h>
+#include "uart.h"
+#endif
 
 /*******************************************************************************
  *                         	  Global variables                                 *
  *******************************************************************************/
-uint8  g_edgeCount = 0; /* to count number of edge */
-static uint16 g_timeLow = 0; /* To get the time to reach required falling edge from echo pin */
-static uint16 g_distance = 0; /* variable to save the sensed distance value in it */
+static uint32 g_riseTimestamp = 0; /* Free running ICU time of the rising edge of the echo */
+static boolean g_echoStarted = FALSE; /* TRUE after the rising edge of the current ping */
+static volatile Ultrasonic_StateType g_state = ULTRASONIC_IDLE; /* State of the current measurement */
+static volatile uint8 g_sequence[ULTRASONIC_SENSOR_COUNT]; /* Sequence number of the last started measurement of every sensor */
+static uint8 g_readSequence[ULTRASONIC_SENSOR_COUNT]; /* Sequence number of the last result read of every sensor */
+static uint8 g_readSensor = 0; /* Sensor of the last result read by Ultrasonic_getResult */
+
+/* Sensors given to Ultrasonic_init and the weighted round robin scheduler */
+static const Ultrasonic_SensorConfigType * g_sensorConfig = NULL_PTR;
+static volatile uint8 g_sensor = 0; /* Sensor of the current ping */
+static sint16 g_sensorWeight[ULTRASONIC_SENSOR_COUNT]; /* Credit of every sensor, the biggest one is pinged next */
+static uint16 g_priorityTotal = 0; /* Sum of the sensor priorities */
+#define ULTRASONIC_WEIGHT_LIMIT		8192 /* Bound of the credits, 4 rounds of 8 sensors of priority 255 */
+static volatile boolean g_periodic = FALSE; /* TRUE while Timer1 pings the sensor at a fixed rate */
+
+#if (ULTRASONIC_SENSOR_COUNT == 1)
+/* With one sensor the trigger pin is known at compile time from board_config.h */
+#define ULTRASONIC_TRIGGER_ON(trigger_port, trigger_pin, echo_select, priority) \
+	GPIO_WRITE_PIN_STATIC(trigger_port, trigger_pin, LOGIC_HIGH);
+#define ULTRASONIC_TRIGGER_OFF(trigger_port, trigger_pin, echo_select, priority) \
+	GPIO_WRITE_PIN_STATIC(trigger_port, trigger_pin, LOGIC_LOW);
+#endif
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+static uint32 g_pingPeriod = ULTRASONIC_US_TO_TICKS(ULTRASONIC_PING_PERIOD_US); /* Period in ICU ticks */
+static uint32 g_nextPing = 0; /* Start time of the next periodic trigger pulse */
+static uint32 g_echoGuard = ULTRASONIC_US_TO_TICKS(ULTRASONIC_ECHO_GUARD_US); /* Echo decay time in ICU ticks */
+#endif
+
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+/* ICU clock and conversion constants of one range of the automatic ranging */
+typedef struct{
+	ICU_Prescaler prescaler;
+	uint32 distancePerTickQ; /* Distance of one tick in ULTRASONIC_DISTANCE_UNIT, Q16 */
+	uint32 maxEchoTicks;     /* Echo of ULTRASONIC_MAX_DISTANCE_MM */
+	uint32 timeoutTicks;     /* Timeout of the echo measured from the trigger */
+	uint32 rateWindowTicks;  /* Sample rate window */
+}Ultrasonic_RangeType;
+
+#define ULTRASONIC_RANGE_ENTRY(prescaler, div)	{prescaler, ULTRASONIC_DISTANCE_PER_TICK_Q_DIV(div), \
+	ULTRASONIC_MAX_ECHO_TICKS_DIV(div), ULTRASONIC_ECHO_TIMEOUT_TICKS_DIV(div), ULTRASONIC_US_TO_TICKS_DIV(1000000UL, div)}
+
+/* Ranges from the finest clock to the coarsest one, neighbours differ by ULTRASONIC_RANGE_RATIO */
+static const Ultrasonic_RangeType g_rangeTable[ULTRASONIC_RANGE_COUNT] = {
+	ULTRASONIC_RANGE_ENTRY(F_CPU_1, 1),
+#if (ULTRASONIC_RANGE_COUNT > 1)
+	ULTRASONIC_RANGE_ENTRY(F_CPU_8, 8),
+#endif
+#if (ULTRASONIC_RANGE_COUNT > 2)
+	ULTRASONIC_RANGE_ENTRY(F_CPU_64, 64),
+#endif
+};
+static uint8 g_range = ULTRASONIC_RANGE_COUNT - 1; /* Range Timer1 runs at */
+static uint8 g_sensorRange[ULTRASONIC_SENSOR_COUNT]; /* Range chosen for the next ping of every sensor */
+#endif
+
+/* Achieved sample rate: measurements counted since the start of the current window */
+static uint16 g_sampleCount = 0;
+static uint32 g_rateWindowStart = 0;
+static volatile uint16 g_sampleRate = 0;
+/*
+ * Result of the last completed measurement of every sensor, each one is protected by a sequence counter (seqlock):
+ * g_resultVersion is odd while the record is written, so a reader that sees the same even version
+ * before and after copying the record has a consistent copy without disabling interrupts.
+ */
+static volatile Ultrasonic_ResultType g_result[ULTRASONIC_SENSOR_COUNT];
+static volatile uint8 g_resultVersion[ULTRASONIC_SENSOR_COUNT];
+/* Global variables to hold the address of the call back function in the application */
+static void (*g_resultCallBackPtr)(const Ultrasonic_ResultType * Result_Ptr) = NULL_PTR;
+
+#if (ULTRASONIC_TELEMETRY == TRUE)
+#if (UART_TX_QUEUE_SIZE <= ULTRASONIC_FRAME_SIZE)
+#error "UART_TX_QUEUE_SIZE can not hold one telemetry frame"
+#endif
+#if ((UART_ACTUAL_BAUD(ULTRASONIC_TELEMETRY_BAUD) * 100UL) > (ULTRASONIC_TELEMETRY_BAUD * 102UL)) || \
+	((UART_ACTUAL_BAUD(ULTRASONIC_TELEMETRY_BAUD) * 100UL) < (ULTRASONIC_TELEMETRY_BAUD * 98UL))
+#error "ULTRASONIC_TELEMETRY_BAUD has more than 2% error at this F_CPU"
+#endif
+#endif
 /*******************************************************************************
  *                         	Function Declaration                                *
  *******************************************************************************/
 /*
  * Description:
- * This is the call back function called by the ICU driver.
+ * Convert the width of the echo pulse from ICU ticks into ULTRASONIC_DISTANCE_UNIT.
+ * The Q16 factor is a compile time constant so only one integer multiplication is done at run time.
+ */
+static uint16 Ultrasonic_ticksToDistance(uint32 ticks)
+{
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+	/* The factor of the range the echo was measured with */
+	if(ticks > g_rangeTable[g_range].maxEchoTicks)
+	{
+		ticks = g_rangeTable[g_range].maxEchoTicks; /* Out of range echo, clamp it to the maximum distance */
+	}
+	return (uint16)((ticks * g_rangeTable[g_range].distancePerTickQ + (1UL << (ULTRASONIC_Q_SHIFT - 1))) >> ULTRASONIC_Q_SHIFT);
+#else
+	if(ticks > ULTRASONIC_MAX_ECHO_TICKS)
+	{
+		ticks = ULTRASONIC_MAX_ECHO_TICKS; /* Out of range echo, clamp it to the maximum distance */
+	}
+	return (uint16)((ticks * (uint32)ULTRASONIC_DISTANCE_PER_TICK_Q + (1UL << (ULTRASONIC_Q_SHIFT - 1))) >> ULTRASONIC_Q_SHIFT);
+#endif
+}
+
+#if (ULTRASONIC_TELEMETRY == TRUE)
+/*
+ * Description:
+ * Queue the telemetry frame of a result in the UART driver (see ultrasonic.h), the frame is dropped if the queue is full.
+ */
+static void Ultrasonic_sendFrame(const Ultrasonic_ResultType * Result_Ptr)
+{
+	uint8 frame[ULTRASONIC_FRAME_SIZE];
+	uint16 crc = 0;
+	uint8 i;
+
+	frame[0] = ULTRASONIC_FRAME_SYNC1;
+	frame[1] = ULTRASONIC_FRAME_SYNC2;
+	frame[2] = Result_Ptr->sequence;
+	frame[3] = (uint8)((Result_Ptr->sensor << 4) | ((Result_Ptr->prescaler & 0x07) << 1) | (Result_Ptr->status & 0x01));
+	frame[4] = (uint8)Result_Ptr->timestamp;
+	frame[5] = (uint8)(Result_Ptr->timestamp >> 8);
+	frame[6] = (uint8)(Result_Ptr->timestamp >> 16);
+	frame[7] = (uint8)(Result_Ptr->timestamp >> 24);
+	frame[8] = (uint8)Result_Ptr->ticks;
+	frame[9] = (uint8)(Result_Ptr->ticks >> 8);
+	frame[10] = (uint8)(Result_Ptr->ticks >> 16);
+	frame[11] = (uint8)(Result_Ptr->ticks >> 24);
+	frame[12] = (uint8)Result_Ptr->distance;
+	frame[13] = (uint8)(Result_Ptr->distance >> 8);
+
+	/* The sync bytes are not in the CRC, the receiver searches for them */
+	for(i = 2; i < (ULTRASONIC_FRAME_SIZE - 2); i++)
+	{
+		crc = _crc_xmodem_update(crc, frame[i]);
+	}
+	frame[14] = (uint8)crc;
+	frame[15] = (uint8)(crc >> 8);
+
+	(void)UART_send(frame, ULTRASONIC_FRAME_SIZE);
+}
+#endif
+
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+/*
+ * Description:
+ * Choose the ICU clock of the next ping of the current sensor from the echo of its last one.
+ */
+static void Ultrasonic_selectRange(Ultrasonic_StatusType status, uint32 ticks)
+{
+	uint8 range = g_range;
+
+	if(status == ULTRASONIC_NO_TARGET)
+	{
+		range = ULTRASONIC_RANGE_COUNT - 1; /* Nothing found, look again over the whole distance */
+	}
+	else if((ticks > ULTRASONIC_RANGE_UP_TICKS) && (range < (ULTRASONIC_RANGE_COUNT - 1)))
+	{
+		range++; /* The echo is close to the end of the 16-bit period, use a slower clock */
+	}
+	else if((ticks < (ULTRASONIC_RANGE_DOWN_TICKS / ULTRASONIC_RANGE_RATIO)) && (range > 0))
+	{
+		range--; /* The echo still fits with a faster clock, use it for a finer tick */
+	}
+
+	g_sensorRange[g_sensor] = range;
+}
+
+/*
+ * Description:
+ * Run Timer1 at the clock of the required range.
+ * The time passed in the sample rate window is converted to the new clock, so the window goes on.
+ */
+static void Ultrasonic_setRange(uint8 range)
+{
+	uint32 elapsed = ICU_getTimerValue() - g_rateWindowStart;
+
+	ICU_setPrescaler(g_rangeTable[range].prescaler);
+	elapsed = (uint32)(((uint64)elapsed * g_rangeTable[range].rateWindowTicks) / g_rangeTable[g_range].rateWindowTicks);
+	g_rateWindowStart = ICU_getTimerValue() - elapsed;
+	g_range = range;
+}
+#endif
+
+/*
+ * Description:
+ * Choose the sensor of the next ping by a smooth weighted round robin: every sensor earns its priority
+ * as credit, the sensor with the biggest credit is pinged and pays the sum of all priorities.
+ * The first pass takes only the sensors with credit that are not the last pinged one or its neighbours,
+ * so the late echoes of one sensor do not reach the next one. A neighbour owed a whole round (credit of at
+ * least the sum of the priorities) is taken anyway, or it would starve between two other sensors.
+ * The second pass is the plain weighted choice, the last sensor wins only with more credit than all the others.
+ */
+static uint8 Ultrasonic_nextSensor(void)
+{
+	uint8 last = g_sensor;
+	uint8 best = last;
+	boolean found = FALSE;
+	uint8 i;
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		g_sensorWeight[i] += g_sensorConfig[i].priority;
+	}
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		if((g_sensorConfig[i].priority == 0) || (i == last) || (g_sensorWeight[i] <= 0))
+		{
+			continue; /* Disabled, just pinged or without credit */
+		}
+		if((((i + 1) == last) || (i == (last + 1))) && (g_sensorWeight[i] < (sint16)g_priorityTotal))
+		{
+			continue; /* Neighbour of the last pinged sensor, it can wait */
+		}
+		if((found == FALSE) || (g_sensorWeight[i] > g_sensorWeight[best]))
+		{
+			best = i;
+			found = TRUE;
+		}
+	}
+
+	if(found == FALSE)
+	{
+		for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+		{
+			if(g_sensorConfig[i].priority == 0)
+			{
+				continue; /* Disabled sensor */
+			}
+			if((g_sensorWeight[i] > g_sensorWeight[best]) ||
+				((g_sensorWeight[i] == g_sensorWeight[best]) && (best == last)))
+			{
+				best = i; /* A tie goes to another sensor than the last one */
+			}
+		}
+	}
+
+	g_sensorWeight[best] -= g_priorityTotal;
+
+	/* The credits stay within a few rounds, the clamp only keeps them in sint16 whatever the priorities are */
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		if(g_sensorWeight[i] > ULTRASONIC_WEIGHT_LIMIT)
+		{
+			g_sensorWeight[i] = ULTRASONIC_WEIGHT_LIMIT;
+		}
+		else if(g_sensorWeight[i] < -ULTRASONIC_WEIGHT_LIMIT)
+		{
+			g_sensorWeight[i] = -ULTRASONIC_WEIGHT_LIMIT;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Description:
+ * Route the echo (and the hardware trigger) of the required sensor through the multiplexer,
+ * the next ping belongs to this sensor. Called between two pings only.
+ */
+static void Ultrasonic_selectSensor(uint8 sensor)
+{
+#if (ULTRASONIC_MUX_SELECT_BITS > 0)
+	uint8 bit;
+
+	for(bit = 0; bit < ULTRASONIC_MUX_SELECT_BITS; bit++)
+	{
+		GPIO_writePin(ULTRASONIC_MUX_PORT_ID, ULTRASONIC_MUX_FIRST_PIN_ID + bit,
+				(g_sensorConfig[sensor].echo_select >> bit) & 0x01);
+	}
+#endif
+
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+	if(g_sensorRange[sensor] != g_range)
+	{
+		Ultrasonic_setRange(g_sensorRange[sensor]); /* Every sensor is measured at the clock its last echo needs */
+	}
+#endif
+
+	g_sensor = sensor;
+	ICU_setCaptureTag(sensor); /* The records of other sensors are ignored */
+}
+
+#if (ULTRASONIC_SCHEDULE == ULTRASONIC_SCHEDULE_ADAPTIVE)
+/*
+ * Description:
+ * Schedule the next trigger pulse as soon as the echo of the last ping settles:
+ * after the echo end, one more echo width for the second reflection and the echo guard time,
+ * but not earlier than the minimum cycle after the previous trigger: ULTRASONIC_MIN_CYCLE_TICKS,
+ * or ULTRASONIC_NO_ECHO_CYCLE_TICKS if the sensor pinged again is still holding the echo of a timeout.
+ */
+static void Ultrasonic_scheduleNextPing(uint32 echoEnd, uint32 echoTicks, boolean echoHeld)
+{
+	uint32 next = echoEnd + echoTicks + g_echoGuard;
+	uint32 minCycle = (echoHeld == TRUE) ? ULTRASONIC_NO_ECHO_CYCLE_TICKS : ULTRASONIC_MIN_CYCLE_TICKS;
+
+	if((sint32)(next - (g_nextPing + minCycle)) < 0)
+	{
+		next = g_nextPing + minCycle; /* Respect the minimum cycle of the sensor */
+	}
+
+	g_nextPing = next;
+	ICU_schedulePulse(g_nextPing, ULTRASONIC_TRIGGER_PULSE_TICKS);
+}
+#elif (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+/*
+ * Description:
+ * The sensor pinged again is still holding the echo of a timeout: move the next fixed rate trigger pulse
+ * by whole periods until it is ULTRASONIC_NO_ECHO_CYCLE_TICKS after the trigger that timed out.
+ */
+static void Ultrasonic_delayNextPing(void)
+{
+	uint32 earliest = (g_nextPing - g_pingPeriod) + ULTRASONIC_NO_ECHO_CYCLE_TICKS; /* g_nextPing is one period ahead */
+
+	if((sint32)(g_nextPing - earliest) < 0)
+	{
+		while((sint32)(g_nextPing - earliest) < 0)
+		{
+			g_nextPing += g_pingPeriod;
+		}
+		ICU_schedulePulse(g_nextPing, ULTRASONIC_TRIGGER_PULSE_TICKS);
+	}
+}
+#endif
+
+/*
+ * Description:
+ * Wait while the selected sensor still holds the echo of a ping that timed out, a trigger is ignored until
+ * the echo falls. The wait is bounded by ULTRASONIC_NO_ECHO_CYCLE_US for a stuck or missing sensor.
+ */
+static void Ultrasonic_waitEchoEnd(void)
+{
+	uint16 polls = ULTRASONIC_NO_ECHO_CYCLE_US / ULTRASONIC_ECHO_POLL_US;
+
+	while((ICU_getInputLevel() == LOGIC_HIGH) && (polls != 0))
+	{
+		_delay_us(ULTRASONIC_ECHO_POLL_US);
+		polls--;
+	}
+}
+
+/*
+ * Description:
+ * Publish the result of the last started ping and call the application call back function.
+ */
+static void Ultrasonic_completeMeasurement(Ultrasonic_StatusType status, uint32 ticks, uint32 timestamp)
+{
+	Ultrasonic_ResultType result;
+
+	result.ticks = ticks;
+	result.timestamp = timestamp;
+	result.distance = (status == ULTRASONIC_OK) ? Ultrasonic_ticksToDistance(ticks) : 0; /* Distance equation */
+	result.sequence = g_sequence[g_sensor]; /* This result belongs to the last started ping of this sensor */
+	result.sensor = g_sensor;
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+	result.prescaler = g_rangeTable[g_range].prescaler;
+#else
+	result.prescaler = ULTRASONIC_ICU_PRESCALER;
+#endif
+	result.status = status;
+	g_echoStarted = FALSE; /* A falling edge before the next rising edge is not an echo of the next ping */
+
+	g_resultVersion[g_sensor]++; /* Odd version: the record is being written */
+	g_result[g_sensor] = result;
+	g_resultVersion[g_sensor]++; /* Even version: the record is consistent again */
+
+	g_state = ULTRASONIC_READY;
+	TRACE(TRACE_CONVERSION, result.distance);
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	Ultrasonic_sendFrame(&result);
+#endif
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+	if(g_periodic == TRUE)
+	{
+		/* The echo of this ping is over, route the next sensor before its trigger pulse */
+		Ultrasonic_selectSensor(Ultrasonic_nextSensor());
+#if (ULTRASONIC_SCHEDULE == ULTRASONIC_SCHEDULE_ADAPTIVE)
+		/* The echo ends at timestamp + ticks, timeouts have no echo width */
+		Ultrasonic_scheduleNextPing(timestamp + ticks, ticks, (status == ULTRASONIC_NO_TARGET) && (g_sensor == result.sensor));
+#else
+		if((status == ULTRASONIC_NO_TARGET) && (g_sensor == result.sensor))
+		{
+			Ultrasonic_delayNextPing();
+		}
+#endif
+	}
+#endif
+
+	/* Count the measurements and update the sample rate once every window */
+	g_sampleCount++;
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+	if((timestamp - g_rateWindowStart) >= g_rangeTable[g_range].rateWindowTicks)
+	{
+		g_sampleRate = (uint16)(((uint64)g_sampleCount * g_rangeTable[g_range].rateWindowTicks) / (timestamp - g_rateWindowStart));
+		g_sampleCount = 0;
+		g_rateWindowStart = timestamp;
+	}
+
+	Ultrasonic_selectRange(status, ticks); /* The next ping is measured with the clock that suits this echo */
+#else
+	if((timestamp - g_rateWindowStart) >= ULTRASONIC_RATE_WINDOW_TICKS)
+	{
+		g_sampleRate = (uint16)(((uint64)g_sampleCount * ULTRASONIC_RATE_WINDOW_TICKS) / (timestamp - g_rateWindowStart));
+		g_sampleCount = 0;
+		g_rateWindowStart = timestamp;
+	}
+#endif
+
+	if(g_resultCallBackPtr != NULL_PTR)
+	{
+		/* Call the Call Back function in the application after the measurement is completed */
+		(*g_resultCallBackPtr)(&result);
+	}
+}
+
+/*
+ * Description:
+ * Prepare the driver for the echo of a new ping.
+ */
+static void Ultrasonic_armMeasurement(void)
+{
+	g_echoStarted = FALSE;
+
+	ICU_setEdgeDetectionType(RISING); /* The next edge is the rising edge of this ping */
+	g_sequence[g_sensor]++;
+	g_state = ULTRASONIC_BUSY; /* Ultrasonic_edgeProcessing will complete the measurement */
+	TRACE(TRACE_TRIGGER, ((uint16)g_sequence[g_sensor] << 8) | g_sensor);
+
+	/* The whole echo must end within the sensor range measured from the trigger */
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+	ICU_startTimeout(g_rangeTable[g_range].timeoutTicks);
+#else
+	ICU_startTimeout(ULTRASONIC_ECHO_TIMEOUT_TICKS);
+#endif
+}
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+/*
+ * Description:
+ * This is the pulse call back function called by the ICU driver when the trigger pulse ends.
+ * Arm the measurement of this ping and schedule the next trigger pulse in ULTRASONIC_SCHEDULE_FIXED,
+ * in ULTRASONIC_SCHEDULE_ADAPTIVE it is scheduled when the measurement is completed.
+ */
+static void Ultrasonic_pulseProcessing(void)
+{
+	Ultrasonic_edgeProcessing(); /* Finish the previous ping before the records of this one arrive */
+	Ultrasonic_armMeasurement();
+
+#if (ULTRASONIC_SCHEDULE == ULTRASONIC_SCHEDULE_FIXED)
+	if(g_periodic == TRUE)
+	{
+		g_nextPing += g_pingPeriod; /* Fixed rate: the period is counted from the previous pulse */
+		ICU_schedulePulse(g_nextPing, ULTRASONIC_TRIGGER_PULSE_TICKS);
+	}
+#endif
+}
+#endif
+
+/*
+ * Description:
+ * Process the edges queued by the ICU driver, it is called by the driver API and can be called by the application.
+ * In ULTRASONIC_TRIGGER_HARDWARE mode it is called from the ICU interrupts only.
  * This is used to calculate the high time (pulse time) generated by the ultrasonic sensor.
  */
  void Ultrasonic_edgeProcessing(void)
  {
-	 g_edgeCount++; /* To call back this function two times to get the value of ECHO puls */
-	 if(g_edgeCount == 1)
-	 {
-		 ICU_clearTimerValue(); /* Clear timer to start count from zero second */
+	 ICU_CaptureType capture;
+	 PERF_START(PERF_ULTRASONIC_EDGE_PROCESSING);
 
-		 ICU_setEdgeDetectionType(FALLING); /* change edge detection edge to get time required to reach the falling edge */
-	 }
-	 else if(g_edgeCount == 2)
+	 /* The ICU ISR only queues the edges, the measurement itself is done here outside the interrupt */
+	 while(ICU_readCapture(&capture) == TRUE)
 	 {
-		 g_timeLow = ICU_getInputCaptureValue(); /* Get the time required to reach falling edge in a variable */
+		 if((g_state != ULTRASONIC_BUSY) || (capture.tag != g_sensor))
+		 {
+			 /* No measurement is waiting for an echo or the record belongs to another sensor, ignore it */
+			 PERF_COUNT(PERF_STRAY_EDGE);
+		 }
+		 else if(capture.event == ICU_EVENT_RISING_EDGE)
+		 {
+			 g_riseTimestamp = capture.timestamp; /* Start of the echo pulse */
+			 g_echoStarted = TRUE;
+		 }
+		 else if(capture.event == ICU_EVENT_FALLING_EDGE)
+		 {
+			 if(g_echoStarted == TRUE) /* Otherwise it is the end of an older echo */
+			 {
+				 ICU_stopTimeout();
 
-		 ICU_clearTimerValue(); /* clear timer again */
-		 ICU_setEdgeDetectionType(RISING); /* return edge detection to rising edge for next process */
-		 g_edgeCount = 0; /* clear counter to start from beginning */
+				 /* The echo width is the difference of the two timestamps, Timer1 keeps running for other users */
+				 Ultrasonic_completeMeasurement(ULTRASONIC_OK, capture.timestamp - g_riseTimestamp, g_riseTimestamp);
+			 }
+		 }
+		 else /* ICU_EVENT_TIMEOUT: the echo did not arrive in time */
+		 {
+			 PERF_COUNT(PERF_MISSED_ECHO);
+			 Ultrasonic_completeMeasurement(ULTRASONIC_NO_TARGET, 0, capture.timestamp);
+		 }
 	 }
+
+	 PERF_STOP(PERF_ULTRASONIC_EDGE_PROCESSING);
  }
 
 /*
  * Description:
  * Initialize the ICU driver as required.
- * Setup the ICU call back function.
- * Setup the direction for the trigger pin as output pin through the GPIO driver.
+ * Setup the direction for the trigger pins and the multiplexer select pins as output pins through the GPIO driver.
+ * Config_Ptr points to an array of ULTRASONIC_SENSOR_COUNT sensors, it must stay valid while the driver is used.
  */
-void Ultrasonic_init(void)
+void Ultrasonic_init(const Ultrasonic_SensorConfigType * Config_Ptr)
 {
+	uint8 i;
+
 	/*
-	 * ICU frequency = F_CPU/8, and detect the raising edge as the first edge.
-	 * the ICU will call back Ultrasonic_edgeProcessing function when it detect an edge.
+	 * ICU frequency = F_CPU/ULTRASONIC_PRESCALER_DIV, and detect the raising edge as the first edge.
+	 * the ICU queues every edge and Ultrasonic_edgeProcessing reads them from the queue.
+	 * With ULTRASONIC_AUTO_RANGE the first ping uses the coarsest range, which covers the whole distance.
 	 */
-	ICU_ConfigType config = {F_CPU_8,RISING};
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+	ICU_ConfigType config = {g_rangeTable[ULTRASONIC_RANGE_COUNT - 1].prescaler,RISING};
+
+	g_range = ULTRASONIC_RANGE_COUNT - 1;
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		g_sensorRange[i] = ULTRASONIC_RANGE_COUNT - 1;
+	}
+#else
+	ICU_ConfigType config = {ULTRASONIC_ICU_PRESCALER,RISING};
+#endif
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	UART_ConfigType uart_config = {UART_BAUD_PRESCALE(ULTRASONIC_TELEMETRY_BAUD)};
+#endif
 	ICU_init(&config);
+#if (ULTRASONIC_TELEMETRY == TRUE)
+	UART_init(&uart_config); /* The frames of the results are sent on TXD */
+#endif
 
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+	/* Every echo is measured in the ICU interrupts and the next ping is armed when the trigger pulse ends */
+#if (ICU_CAPTURE_BINDING == ICU_CAPTURE_BINDING_RUNTIME)
 	ICU_setCallBack(Ultrasonic_edgeProcessing);
-	/*	Make trigger pin as output pin	*/
-	GPIO_setupPinDirection(TRIGGER_PORT_ID, TRIGGER_PIN_ID, PIN_OUTPUT);
+#endif
+	ICU_setTimeoutCallBack(Ultrasonic_edgeProcessing);
+	ICU_setPulseCallBack(Ultrasonic_pulseProcessing);
+#endif
+
+	g_sensorConfig = Config_Ptr;
+	g_priorityTotal = 0;
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		g_priorityTotal += Config_Ptr[i].priority;
+		g_sensorWeight[i] = 0;
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+		/*	Make trigger pin as output pin	*/
+		GPIO_setupPinDirection(Config_Ptr[i].trigger_port, Config_Ptr[i].trigger_pin, PIN_OUTPUT);
+#endif
+	}
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+	/*	Make OC1A as output pin, it drives the triggers of all sensors	*/
+	GPIO_SETUP_PIN_DIRECTION_STATIC(TRIGGER_PORT_ID, TRIGGER_PIN_ID, PIN_OUTPUT);
+#endif
+
+#if (ULTRASONIC_MUX_SELECT_BITS > 0)
+	for(i = 0; i < ULTRASONIC_MUX_SELECT_BITS; i++)
+	{
+		GPIO_setupPinDirection(ULTRASONIC_MUX_PORT_ID, ULTRASONIC_MUX_FIRST_PIN_ID + i, PIN_OUTPUT);
+	}
+#endif
+
+	Ultrasonic_selectSensor(0);
 }
 
 /*
  * Description:
- * Send the Trigger pulse to the ultrasonic.
- *
+ * Send the Trigger pulse to the sensor selected for the current ping.
+ * In ULTRASONIC_TRIGGER_HARDWARE mode the pulse is generated by Timer1 and this function does not wait for it.
+ * With one sensor in ULTRASONIC_TRIGGER_SOFTWARE mode the trigger pin of board_config.h is written by sbi/cbi.
  */
 void Ultrasonic_Trigger(void)
 {
-	GPIO_writePin(TRIGGER_PORT_ID, TRIGGER_PIN_ID, LOGIC_HIGH); /* Trigger pin on */
-	_delay_us(20); /*When a pulse of (at least) 10secs given to the Triggerg pin, 8 pulses of 40 kHz are generated.*/
-	GPIO_writePin(TRIGGER_PORT_ID, TRIGGER_PIN_ID, LOGIC_LOW); /* Trigger pin off */
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+	ICU_schedulePulse(ICU_getTimerValue(), ULTRASONIC_TRIGGER_PULSE_TICKS); /* Start the pulse now */
+#elif (ULTRASONIC_SENSOR_COUNT == 1)
+	BOARD_ULTRASONIC_SENSORS(ULTRASONIC_TRIGGER_ON) /* Trigger pin on, one sbi */
+	_delay_us(ULTRASONIC_TRIGGER_PULSE_US);
+	BOARD_ULTRASONIC_SENSORS(ULTRASONIC_TRIGGER_OFF) /* Trigger pin off, one cbi */
+#else
+	GPIO_writePin(g_sensorConfig[g_sensor].trigger_port, g_sensorConfig[g_sensor].trigger_pin, LOGIC_HIGH); /* Trigger pin on */
+	_delay_us(ULTRASONIC_TRIGGER_PULSE_US); /*When a pulse of (at least) 10secs given to the Triggerg pin, 8 pulses of 40 kHz are generated.*/
+	GPIO_writePin(g_sensorConfig[g_sensor].trigger_port, g_sensorConfig[g_sensor].trigger_pin, LOGIC_LOW); /* Trigger pin off */
+#endif
+}
+
+/*
+ * Description:
+ * Send the trigger pulse to the required sensor and wait for the echo of this ping.
+ * If the periodic pinging is running, wait for the next result of this sensor instead.
+ * Return the distance measured by this ping in ULTRASONIC_DISTANCE_UNIT,
+ * or 0 if the periodic pinging does not ping this sensor (priority 0) or stops before it does.
+ */
+uint16 Ultrasonic_readDistance(uint8 sensor)
+{
+	Ultrasonic_ResultType result;
+
+	if(sensor >= ULTRASONIC_SENSOR_COUNT)
+	{
+		return 0;
+	}
+
+	if(g_periodic == FALSE)
+	{
+		/* Wait for any measurement that is already running then start a new one */
+		while(Ultrasonic_startSensorMeasurement(sensor) == FALSE);
+
+		/* Wait for the echo of this ping */
+		do
+		{
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+			Ultrasonic_edgeProcessing();
+#else
+			POLL_WAIT(); /* The ICU interrupts complete the measurement */
+#endif
+		}while(g_state == ULTRASONIC_BUSY);
+	}
+	else if(g_sensorConfig[sensor].priority == 0)
+	{
+		return 0; /* The scheduler never pings this sensor */
+	}
+	else
+	{
+		g_readSequence[sensor] = g_result[sensor].sequence; /* Skip the results of the pings sent before this call */
+	}
+
+	while(Ultrasonic_getSensorResult(sensor, &result) == FALSE)
+	{
+		if((g_periodic == FALSE) && (g_state != ULTRASONIC_BUSY))
+		{
+			return 0; /* The periodic pinging stopped before this sensor was pinged */
+		}
+		POLL_WAIT(); /* The ICU interrupts complete the measurements */
+	}
+
+	return result.distance; /* return distance value */
+}
+
+/*
+ * Description:
+ * Start a new measurement of the next sensor chosen by the scheduler without waiting for its echo.
+ * The sensors are pinged in a weighted round robin by their priority, skipping the neighbour of the last pinged sensor.
+ * Each measurement gets the next sequence number of its sensor which is reported back with its result.
+ * Return FALSE if the previous measurement is still waiting for its echo or the periodic pinging is running.
+ */
+boolean Ultrasonic_startMeasurement(void)
+{
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+	Ultrasonic_edgeProcessing(); /* Finish the previous ping and empty the capture queue */
+#endif
+
+	if((g_state == ULTRASONIC_BUSY) || (g_periodic == TRUE))
+	{
+		return FALSE;
+	}
+
+	return Ultrasonic_startSensorMeasurement(Ultrasonic_nextSensor());
+}
+
+/*
+ * Description:
+ * Start a new measurement of the required sensor without waiting for its echo.
+ * Return FALSE if the previous measurement is still waiting for its echo, the periodic pinging is running
+ * or the sensor does not exist.
+ */
+boolean Ultrasonic_startSensorMeasurement(uint8 sensor)
+{
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+	Ultrasonic_edgeProcessing(); /* Finish the previous ping and empty the capture queue */
+#endif
+
+	if((g_state == ULTRASONIC_BUSY) || (g_periodic == TRUE) || (sensor >= ULTRASONIC_SENSOR_COUNT))
+	{
+		return FALSE;
+	}
+
+	Ultrasonic_selectSensor(sensor);
+
+	if(g_result[sensor].status == ULTRASONIC_NO_TARGET)
+	{
+		Ultrasonic_waitEchoEnd(); /* The last ping of this sensor timed out, its echo may still be high */
+	}
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+	Ultrasonic_armMeasurement();
+#else
+	g_echoStarted = FALSE;
+	g_state = ULTRASONIC_BUSY; /* Ultrasonic_pulseProcessing arms the measurement when the pulse ends */
+#endif
+
+	Ultrasonic_Trigger();
+	return TRUE;
+}
+
+/*
+ * Description:
+ * Return TRUE if a completed measurement of any sensor is not read yet.
+ */
+boolean Ultrasonic_isReady(void)
+{
+	uint8 i;
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+	Ultrasonic_edgeProcessing();
+#endif
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		if(g_result[i].sequence != g_readSequence[i])
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description:
+ * Copy the oldest unread result among the sensors into Result_Ptr and mark it as read,
+ * the sensors are visited in turn so a fast sensor does not hide the others.
+ * Return FALSE if there is no new completed measurement.
+ */
+boolean Ultrasonic_getResult(Ultrasonic_ResultType * Result_Ptr)
+{
+	uint8 sensor = g_readSensor;
+	uint8 i;
+
+	for(i = 0; i < ULTRASONIC_SENSOR_COUNT; i++)
+	{
+		sensor = (sensor + 1 < ULTRASONIC_SENSOR_COUNT) ? (sensor + 1) : 0; /* Start after the last sensor read */
+		if(Ultrasonic_getSensorResult(sensor, Result_Ptr) == TRUE)
+		{
+			g_readSensor = sensor;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description:
+ * Copy the result of the last completed measurement of the required sensor into Result_Ptr and mark it as read.
+ * Return FALSE if there is no new completed measurement of this sensor.
+ */
+boolean Ultrasonic_getSensorResult(uint8 sensor, Ultrasonic_ResultType * Result_Ptr)
+{
+	Ultrasonic_ResultType result;
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_SOFTWARE)
+	Ultrasonic_edgeProcessing();
+#endif
+
+	if((Ultrasonic_getSnapshot(sensor, &result) == FALSE) || (result.sequence == g_readSequence[sensor]))
+	{
+		return FALSE;
+	}
+
+	g_readSequence[sensor] = result.sequence;
+	*Result_Ptr = result;
+	return TRUE;
+}
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+/*
+ * Description:
+ * Start pinging the sensors as configured by ULTRASONIC_SCHEDULE, one sensor per ping in the order of the scheduler.
+ * The trigger pulse is generated by Timer1
+ * and every echo is measured in the ICU interrupts. The results are read by Ultrasonic_getResult or Ultrasonic_getSnapshot.
+ */
+void Ultrasonic_startPeriodic(void)
+{
+	uint8 sreg = SREG;
+
+	cli(); /* The pulse interrupt uses g_nextPing */
+	g_periodic = TRUE;
+	Ultrasonic_selectSensor(Ultrasonic_nextSensor());
+	g_nextPing = ICU_getTimerValue();
+	ICU_schedulePulse(g_nextPing, ULTRASONIC_TRIGGER_PULSE_TICKS);
+	SREG = sreg;
+}
+
+/*
+ * Description:
+ * Stop the periodic pinging after the current ping.
+ */
+void Ultrasonic_stopPeriodic(void)
+{
+	g_periodic = FALSE;
+}
+
+/*
+ * Description:
+ * Set the period of the periodic pinging in micro seconds.
+ * Periods shorter than the longest echo are extended to it.
+ */
+void Ultrasonic_setPingPeriod(uint32 period_us)
+{
+	uint8 sreg = SREG;
+	uint32 period = (uint32)(((uint64)period_us * ULTRASONIC_TICKS_PER_US_Q) >> ULTRASONIC_Q_SHIFT);
+
+	if(period < (ULTRASONIC_ECHO_TIMEOUT_TICKS + ULTRASONIC_TRIGGER_PULSE_TICKS))
+	{
+		period = ULTRASONIC_ECHO_TIMEOUT_TICKS + ULTRASONIC_TRIGGER_PULSE_TICKS;
+	}
+
+	cli(); /* The pulse interrupt uses g_pingPeriod */
+	g_pingPeriod = period;
+	SREG = sreg;
+}
+
+/*
+ * Description:
+ * Set the time in micro seconds the echoes need to decay before the next ping in ULTRASONIC_SCHEDULE_ADAPTIVE.
+ */
+void Ultrasonic_setEchoGuard(uint32 guard_us)
+{
+	uint8 sreg = SREG;
+	uint32 guard = (uint32)(((uint64)guard_us * ULTRASONIC_TICKS_PER_US_Q) >> ULTRASONIC_Q_SHIFT);
+
+	cli(); /* The ICU interrupts use g_echoGuard */
+	g_echoGuard = guard;
+	SREG = sreg;
 }
+#endif
 
 /*
  * Description:
- * Send the trigger pulse by using Ultrasonic_Trigger function.
- * Start the measurements by the ICU from this moment.
+ * Return the number of completed measurements per second, updated every ULTRASONIC_RATE_WINDOW_TICKS.
  */
-uint16 Ultrasonic_readDistance(void)
+uint16 Ultrasonic_getSampleRate(void)
 {
-	Ultrasonic_Trigger(); /* Trigger ultrasonic once to measure only one value */
+	uint8 sreg = SREG;
+	uint16 rate;
+
+	cli(); /* The rate may be updated by the ICU interrupts */
+	rate = g_sampleRate;
+	SREG = sreg;
 
-	g_distance = (g_timeLow * 0.0173); /* Distance equation */
-	return g_distance; /* return distance value */
+	return rate;
+}
+
+/*
+ * Description:
+ * Copy the last completed measurement of the required sensor into Result_Ptr without releasing the driver.
+ * It never disables interrupts, so it can be called at any time and from any context.
+ * Return FALSE if the record was being written during ULTRASONIC_SNAPSHOT_RETRIES tries,
+ * which only happens when it is called from an interrupt that stopped the writer.
+ */
+boolean Ultrasonic_getSnapshot(uint8 sensor, Ultrasonic_ResultType * Result_Ptr)
+{
+	uint8 version;
+	uint8 try;
+
+	if(sensor >= ULTRASONIC_SENSOR_COUNT)
+	{
+		return FALSE;
+	}
+
+	for(try = 0; try < ULTRASONIC_SNAPSHOT_RETRIES; try++)
+	{
+		version = g_resultVersion[sensor];
+		if((version & 0x01) == 0) /* No writer is in the middle of the record */
+		{
+			*Result_Ptr = g_result[sensor];
+			if(version == g_resultVersion[sensor]) /* The record did not change while it was copied */
+			{
+				return TRUE;
+			}
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description:
+ * Set the function that will be called when a measurement is completed.
+ * The call back function is called from Ultrasonic_edgeProcessing: in ULTRASONIC_TRIGGER_SOFTWARE mode from the
+ * driver API in the application context, in ULTRASONIC_TRIGGER_HARDWARE mode from the ICU interrupts,
+ * so there it must be short and use only data that is safe to share with an interrupt.
+ */
+void Ultrasonic_setCallBack(void(*a_ptr)(const Ultrasonic_ResultType * Result_Ptr))
+{
+	/* Save the address of the Call back function in a global variable */
+	g_resultCallBackPtr = a_ptr;
 }
@@ -17,19 +17,333 @@
  *                      		Include Header	                               *
  *******************************************************************************/
 #include "std_types.h"
+#include "icu.h"
+#include "gpio.h"
+#include "board_config.h"
 
 /*******************************************************************************
  *                      		Definitions 	                               *
  *******************************************************************************/
-#define TRIGGER_PORT_ID		PORTB_ID
-#define TRIGGER_PIN_ID		PIN5_ID
+/*
+ * Trigger mode:
+ * ULTRASONIC_TRIGGER_SOFTWARE: the CPU writes the trigger pulse on the trigger pin of the sensor with a busy wait.
+ * ULTRASONIC_TRIGGER_HARDWARE: Timer1 generates the trigger pulse on OC1A/PD5 and the echo is measured
+ * in the ICU interrupts, so the sensor can be pinged at a fixed rate without any CPU time in the main loop.
+ */
+#define ULTRASONIC_TRIGGER_SOFTWARE		0
+#define ULTRASONIC_TRIGGER_HARDWARE		1
+
+#ifndef ULTRASONIC_TRIGGER_MODE
+#define ULTRASONIC_TRIGGER_MODE			ULTRASONIC_TRIGGER_SOFTWARE
+#endif
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+#define TRIGGER_PORT_ID		BOARD_PORT_ID(BOARD_ICU_OC1A)
+#define TRIGGER_PIN_ID		BOARD_PIN_ID(BOARD_ICU_OC1A)
+#elif (ULTRASONIC_TRIGGER_MODE != ULTRASONIC_TRIGGER_SOFTWARE)
+#error "ULTRASONIC_TRIGGER_MODE should be equal to ULTRASONIC_TRIGGER_SOFTWARE or ULTRASONIC_TRIGGER_HARDWARE"
+#endif
+
+/* In the software mode the main loop reads the capture queue, the ISR must not read it at the same time */
+#if (ICU_CAPTURE_BINDING == ICU_CAPTURE_BINDING_STATIC) && (ULTRASONIC_TRIGGER_MODE != ULTRASONIC_TRIGGER_HARDWARE)
+#error "ICU_CAPTURE_BINDING_STATIC calls Ultrasonic_edgeProcessing from the capture ISR, it needs ULTRASONIC_TRIGGER_HARDWARE"
+#endif
+
+/*
+ * Number of sensors sharing the ICU, one for every line of BOARD_ULTRASONIC_SENSORS in board_config.h.
+ * They are described by the Ultrasonic_SensorConfigType array given to Ultrasonic_init, which
+ * ULTRASONIC_SENSOR_CONFIG builds from the same lines.
+ * The echo outputs are connected to ICP1/PD6 through a multiplexer (4051 type) whose select lines are
+ * ULTRASONIC_MUX_SELECT_BITS pins of ULTRASONIC_MUX_PORT_ID starting at ULTRASONIC_MUX_FIRST_PIN_ID,
+ * so one sensor is measured at a time. In ULTRASONIC_TRIGGER_HARDWARE mode OC1A/PD5 is routed to the trigger
+ * inputs by a demultiplexer on the same select lines, in ULTRASONIC_TRIGGER_SOFTWARE mode every sensor has its own trigger pin.
+ */
+#define ULTRASONIC_SENSOR_COUNT			BOARD_ULTRASONIC_SENSOR_COUNT
+
+#define ULTRASONIC_MUX_PORT_ID			BOARD_ULTRASONIC_MUX_PORT_ID
+#define ULTRASONIC_MUX_FIRST_PIN_ID		BOARD_ULTRASONIC_MUX_FIRST_PIN_ID
+
+/* Initializer of one Ultrasonic_SensorConfigType from a line of BOARD_ULTRASONIC_SENSORS */
+#define ULTRASONIC_SENSOR_CONFIG(trigger_port, trigger_pin, echo_select, priority) \
+	{trigger_port, trigger_pin, echo_select, priority},
+
+#if (ULTRASONIC_SENSOR_COUNT == 1)
+#define ULTRASONIC_MUX_SELECT_BITS		0 /* No multiplexer */
+#elif (ULTRASONIC_SENSOR_COUNT == 2)
+#define ULTRASONIC_MUX_SELECT_BITS		1
+#elif (ULTRASONIC_SENSOR_COUNT <= 4)
+#define ULTRASONIC_MUX_SELECT_BITS		2
+#elif (ULTRASONIC_SENSOR_COUNT <= 8)
+#define ULTRASONIC_MUX_SELECT_BITS		3
+#else
+#error "ULTRASONIC_SENSOR_COUNT should be from 1 to 8"
+#endif
+
+#if ((ULTRASONIC_MUX_FIRST_PIN_ID + ULTRASONIC_MUX_SELECT_BITS) > NUM_OF_PINS_PER_PORT)
+#error "The multiplexer select lines do not fit in ULTRASONIC_MUX_PORT_ID"
+#endif
+
+/* CPU clock of the board, every module has to be compiled with the same F_CPU */
+#define ULTRASONIC_F_CPU	8000000UL
+
+#ifndef F_CPU
+#error "F_CPU is not defined, pass it on the compiler command line (-DF_CPU=8000000UL)"
+#elif (F_CPU != ULTRASONIC_F_CPU)
+#error "F_CPU does not match ULTRASONIC_F_CPU, the distance conversion would use the wrong clock"
+#endif
+
+/* ICU clock divider used to measure the echo pulse (1, 8, 64, 256 or 1024) */
+#define ULTRASONIC_PRESCALER_DIV	8
+
+#if (ULTRASONIC_PRESCALER_DIV == 1)
+#define ULTRASONIC_ICU_PRESCALER	F_CPU_1
+#elif (ULTRASONIC_PRESCALER_DIV == 8)
+#define ULTRASONIC_ICU_PRESCALER	F_CPU_8
+#elif (ULTRASONIC_PRESCALER_DIV == 64)
+#define ULTRASONIC_ICU_PRESCALER	F_CPU_64
+#elif (ULTRASONIC_PRESCALER_DIV == 256)
+#define ULTRASONIC_ICU_PRESCALER	F_CPU_256
+#elif (ULTRASONIC_PRESCALER_DIV == 1024)
+#define ULTRASONIC_ICU_PRESCALER	F_CPU_1024
+#else
+#error "ULTRASONIC_PRESCALER_DIV should be equal to 1, 8, 64, 256 or 1024"
+#endif
+
+/* Unit of the distance returned by the driver */
+#define ULTRASONIC_UNIT_CM			0
+#define ULTRASONIC_UNIT_MM			1
+
+#define ULTRASONIC_DISTANCE_UNIT	ULTRASONIC_UNIT_CM
+
+/* Maximum distance the sensor can measure, longer echoes are clamped to it */
+#define ULTRASONIC_MAX_DISTANCE_MM	4000UL
+
+/*
+ * The echo covers the distance twice: distance[mm] = echo time[s] * 343000 / 2.
+ * The distance of one ICU tick is derived here from F_CPU and the prescaler as a Q16 fixed-point
+ * number, so the driver converts the echo with one integer multiplication and a shift.
+ */
+#define ULTRASONIC_HALF_SOUND_SPEED	171500ULL /* mm per second */
+#define ULTRASONIC_Q_SHIFT			16
+
+#define ULTRASONIC_MM_PER_TICK_Q_DIV(div)	((((ULTRASONIC_HALF_SOUND_SPEED * (div)) << ULTRASONIC_Q_SHIFT) \
+											+ (F_CPU / 2)) / F_CPU)
+#define ULTRASONIC_CM_PER_TICK_Q_DIV(div)	((((ULTRASONIC_HALF_SOUND_SPEED * (div)) << ULTRASONIC_Q_SHIFT) \
+											+ (F_CPU * 5)) / (F_CPU * 10))
+#define ULTRASONIC_MM_PER_TICK_Q	ULTRASONIC_MM_PER_TICK_Q_DIV(ULTRASONIC_PRESCALER_DIV)
+#define ULTRASONIC_CM_PER_TICK_Q	ULTRASONIC_CM_PER_TICK_Q_DIV(ULTRASONIC_PRESCALER_DIV)
+
+#if (ULTRASONIC_DISTANCE_UNIT == ULTRASONIC_UNIT_MM)
+#define ULTRASONIC_DISTANCE_PER_TICK_Q_DIV(div)	ULTRASONIC_MM_PER_TICK_Q_DIV(div)
+#elif (ULTRASONIC_DISTANCE_UNIT == ULTRASONIC_UNIT_CM)
+#define ULTRASONIC_DISTANCE_PER_TICK_Q_DIV(div)	ULTRASONIC_CM_PER_TICK_Q_DIV(div)
+#else
+#error "ULTRASONIC_DISTANCE_UNIT should be equal to ULTRASONIC_UNIT_CM or ULTRASONIC_UNIT_MM"
+#endif
+#define ULTRASONIC_DISTANCE_PER_TICK_Q	ULTRASONIC_DISTANCE_PER_TICK_Q_DIV(ULTRASONIC_PRESCALER_DIV)
+
+#if (ULTRASONIC_DISTANCE_PER_TICK_Q == 0)
+#error "ULTRASONIC_PRESCALER_DIV gives a tick that can not be represented in Q16, choose a bigger prescaler"
+#endif
+
+#if ((ULTRASONIC_MAX_DISTANCE_MM << ULTRASONIC_Q_SHIFT) > 0xFFFFFFFFULL)
+#error "ULTRASONIC_MAX_DISTANCE_MM is too big for the Q16 conversion"
+#endif
+
+/* Longest echo that still fits the conversion without overflowing 32-bit arithmetic */
+#define ULTRASONIC_MAX_ECHO_TICKS_DIV(div)	((ULTRASONIC_MAX_DISTANCE_MM << ULTRASONIC_Q_SHIFT) / ULTRASONIC_MM_PER_TICK_Q_DIV(div))
+#define ULTRASONIC_MAX_ECHO_TICKS	ULTRASONIC_MAX_ECHO_TICKS_DIV(ULTRASONIC_PRESCALER_DIV)
+
+/* Convert a time in micro seconds into ICU ticks */
+#define ULTRASONIC_US_TO_TICKS_DIV(us, div)	(((us) * 1ULL * F_CPU) / (1000000ULL * (div)))
+#define ULTRASONIC_US_TO_TICKS(us)	ULTRASONIC_US_TO_TICKS_DIV(us, ULTRASONIC_PRESCALER_DIV)
+
+/* ICU ticks per micro second in Q16, to convert times given at run time without a division */
+#define ULTRASONIC_TICKS_PER_US_Q	((F_CPU * (1ULL << ULTRASONIC_Q_SHIFT)) / (1000000ULL * ULTRASONIC_PRESCALER_DIV))
+
+/* Longest time from the trigger pulse to the rising edge of the echo */
+#define ULTRASONIC_ECHO_START_US	2000UL
+
+/* A ping whose falling edge does not come within ULTRASONIC_ECHO_START_TICKS + ULTRASONIC_MAX_ECHO_TICKS
+ * from the trigger is reported as ULTRASONIC_NO_TARGET */
+#define ULTRASONIC_ECHO_TIMEOUT_TICKS_DIV(div)	(ULTRASONIC_US_TO_TICKS_DIV(ULTRASONIC_ECHO_START_US, div) \
+												+ ULTRASONIC_MAX_ECHO_TICKS_DIV(div))
+#define ULTRASONIC_ECHO_START_TICKS	ULTRASONIC_US_TO_TICKS(ULTRASONIC_ECHO_START_US)
+#define ULTRASONIC_ECHO_TIMEOUT_TICKS	ULTRASONIC_ECHO_TIMEOUT_TICKS_DIV(ULTRASONIC_PRESCALER_DIV)
+
+/* Width of the trigger pulse, the sensor needs at least 10us */
+#define ULTRASONIC_TRIGGER_PULSE_US	20UL
+#define ULTRASONIC_TRIGGER_PULSE_TICKS	ULTRASONIC_US_TO_TICKS(ULTRASONIC_TRIGGER_PULSE_US)
+
+/* Default period of the fixed rate pinging in ULTRASONIC_TRIGGER_HARDWARE mode */
+#define ULTRASONIC_PING_PERIOD_US	60000UL
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+#if ((ULTRASONIC_TRIGGER_PULSE_TICKS == 0) || (ULTRASONIC_TRIGGER_PULSE_TICKS > 0xFFFF))
+#error "ULTRASONIC_TRIGGER_PULSE_US can not be generated with ULTRASONIC_PRESCALER_DIV"
+#endif
+#if (ULTRASONIC_US_TO_TICKS(ULTRASONIC_PING_PERIOD_US) < (ULTRASONIC_ECHO_TIMEOUT_TICKS + ULTRASONIC_TRIGGER_PULSE_TICKS))
+#error "ULTRASONIC_PING_PERIOD_US is shorter than the longest echo"
+#endif
+#endif
+
+/*
+ * Ping scheduling of Ultrasonic_startPeriodic in ULTRASONIC_TRIGGER_HARDWARE mode:
+ * ULTRASONIC_SCHEDULE_FIXED: ping every ping period.
+ * ULTRASONIC_SCHEDULE_ADAPTIVE: ping again as soon as the echo settles, which is the falling edge plus
+ * one more echo width (second reflection of the same target) plus the echo guard time,
+ * but never faster than ULTRASONIC_MIN_CYCLE_US from the previous trigger.
+ * Near targets are sampled at hundreds of Hz and far targets at the rate their echoes allow.
+ */
+#define ULTRASONIC_SCHEDULE_FIXED		0
+#define ULTRASONIC_SCHEDULE_ADAPTIVE	1
+
+#ifndef ULTRASONIC_SCHEDULE
+#define ULTRASONIC_SCHEDULE				ULTRASONIC_SCHEDULE_FIXED
+#endif
+
+/* Default time for the echoes of a ping to decay before the next ping in ULTRASONIC_SCHEDULE_ADAPTIVE */
+#define ULTRASONIC_ECHO_GUARD_US		1000UL
+
+/* Shortest time between two triggers in ULTRASONIC_SCHEDULE_ADAPTIVE */
+#define ULTRASONIC_MIN_CYCLE_US			2000UL
+#define ULTRASONIC_MIN_CYCLE_TICKS		ULTRASONIC_US_TO_TICKS(ULTRASONIC_MIN_CYCLE_US)
+
+/*
+ * Without a target the HC-SR04 holds its echo high for about 38 ms, longer than the echo timeout, and ignores
+ * a trigger until the echo is low. So after a timeout the periodic pinging triggers the same sensor again
+ * ULTRASONIC_NO_ECHO_CYCLE_US after the trigger that timed out at the earliest, the cycle the datasheet recommends.
+ * A single measurement of a sensor that timed out polls the routed echo every ULTRASONIC_ECHO_POLL_US and
+ * triggers when it is low, waiting ULTRASONIC_NO_ECHO_CYCLE_US at most.
+ */
+#define ULTRASONIC_NO_ECHO_CYCLE_US		60000UL
+#define ULTRASONIC_NO_ECHO_CYCLE_TICKS	ULTRASONIC_US_TO_TICKS(ULTRASONIC_NO_ECHO_CYCLE_US)
+#define ULTRASONIC_ECHO_POLL_US			10
+
+#if (ULTRASONIC_SCHEDULE == ULTRASONIC_SCHEDULE_ADAPTIVE)
+#if (ULTRASONIC_TRIGGER_MODE != ULTRASONIC_TRIGGER_HARDWARE)
+#error "ULTRASONIC_SCHEDULE_ADAPTIVE needs ULTRASONIC_TRIGGER_HARDWARE"
+#endif
+#elif (ULTRASONIC_SCHEDULE != ULTRASONIC_SCHEDULE_FIXED)
+#error "ULTRASONIC_SCHEDULE should be equal to ULTRASONIC_SCHEDULE_FIXED or ULTRASONIC_SCHEDULE_ADAPTIVE"
+#endif
+
+/* Time window of the achieved sample rate reported by Ultrasonic_getSampleRate */
+#define ULTRASONIC_RATE_WINDOW_TICKS	ULTRASONIC_US_TO_TICKS(1000000UL)
+
+/*
+ * Automatic ranging: if ULTRASONIC_AUTO_RANGE is TRUE the ICU clock is chosen again after every measurement
+ * among F_CPU/1, F_CPU/8 and F_CPU/64 instead of ULTRASONIC_PRESCALER_DIV.
+ * Each range is used for echoes that fit in one 16-bit period of Timer1: the driver moves to the next
+ * coarser range when an echo passes ULTRASONIC_RANGE_UP_TICKS and to the next finer range when the echo
+ * would be shorter than ULTRASONIC_RANGE_DOWN_TICKS there. A timeout moves to the coarsest range,
+ * which is the first one that holds the whole echo timeout, so the maximum distance is never lost.
+ * The ticks and the timestamp of a result are counted at the ICU clock of its range.
+ */
+#define ULTRASONIC_AUTO_RANGE			FALSE
+
+#define ULTRASONIC_RANGE_RATIO			8 /* Clock ratio of two neighbour ranges */
+#define ULTRASONIC_RANGE_UP_TICKS		0xC000UL
+#define ULTRASONIC_RANGE_DOWN_TICKS		0x6000UL
+
+#if (ULTRASONIC_AUTO_RANGE == TRUE)
+#if (ULTRASONIC_TRIGGER_MODE != ULTRASONIC_TRIGGER_SOFTWARE)
+#error "ULTRASONIC_AUTO_RANGE needs ULTRASONIC_TRIGGER_SOFTWARE, the ping scheduler needs a fixed tick rate"
+#endif
+#if (ULTRASONIC_DISTANCE_PER_TICK_Q_DIV(1) == 0)
+#error "The F_CPU/1 range gives a tick that can not be represented in Q16"
+#endif
+#if (ULTRASONIC_ECHO_TIMEOUT_TICKS_DIV(1) <= 0xFFFF)
+#define ULTRASONIC_RANGE_COUNT			1
+#elif (ULTRASONIC_ECHO_TIMEOUT_TICKS_DIV(8) <= 0xFFFF)
+#define ULTRASONIC_RANGE_COUNT			2
+#elif (ULTRASONIC_ECHO_TIMEOUT_TICKS_DIV(64) <= 0xFFFF)
+#define ULTRASONIC_RANGE_COUNT			3
+#else
+#error "ULTRASONIC_MAX_DISTANCE_MM does not fit in the F_CPU/64 range"
+#endif
+#elif (ULTRASONIC_AUTO_RANGE != FALSE)
+#error "ULTRASONIC_AUTO_RANGE should be equal to TRUE or FALSE"
+#endif
+
+/* Number of tries Ultrasonic_getSnapshot does while the result record is being written */
+#define ULTRASONIC_SNAPSHOT_RETRIES	3
+
+/*
+ * Telemetry: if ULTRASONIC_TELEMETRY is TRUE every completed measurement is also queued in the UART driver
+ * as one frame of ULTRASONIC_FRAME_SIZE bytes, the fields are little endian:
+ * 	0	sync 0xAA
+ * 	1	sync 0x55
+ * 	2	sequence number of the ping, counted per sensor
+ * 	3	sensor (bits 7:4), ICU prescaler of the ticks (bits 3:1), status (bit 0)
+ * 	4	timestamp of the rising edge of the echo in ICU ticks, 32 bits
+ * 	8	width of the echo in ICU ticks, 32 bits
+ * 	12	distance in ULTRASONIC_DISTANCE_UNIT, 16 bits
+ * 	14	CRC-16/XMODEM of the bytes 2 to 13
+ * The measurement never waits for the line: a frame that does not fit in the UART queue is dropped,
+ * UART_getDropCount counts it and the receiver sees the gap in the sequence numbers of the sensor.
+ * tools/telemetry_decode.py reads the stream.
+ */
+#define ULTRASONIC_TELEMETRY			FALSE
+
+/* 250 kbaud is exact at 8 MHz in the double speed mode and sends 1500 frames per second */
+#define ULTRASONIC_TELEMETRY_BAUD		250000UL
+
+#define ULTRASONIC_FRAME_SYNC1			0xAA
+#define ULTRASONIC_FRAME_SYNC2			0x55
+#define ULTRASONIC_FRAME_SIZE			16
+
+/* Time the UART needs for one frame, 10 bits per byte */
+#define ULTRASONIC_FRAME_US				((ULTRASONIC_FRAME_SIZE * 10UL * 1000000UL) / ULTRASONIC_TELEMETRY_BAUD)
+
+#if (ULTRASONIC_TELEMETRY == TRUE)
+#if (ULTRASONIC_SCHEDULE == ULTRASONIC_SCHEDULE_ADAPTIVE) && (ULTRASONIC_FRAME_US > ULTRASONIC_MIN_CYCLE_US)
+#error "ULTRASONIC_TELEMETRY_BAUD is too slow for one frame every ULTRASONIC_MIN_CYCLE_US"
+#endif
+#elif (ULTRASONIC_TELEMETRY != FALSE)
+#error "ULTRASONIC_TELEMETRY should be equal to TRUE or FALSE"
+#endif
+
+/*******************************************************************************
+ *                         	Types Declaration                                  *
+ *******************************************************************************/
+/*
+ * Description of one sensor. The sensors are listed in their mounting order:
+ * the scheduler does not ping two neighbour sensors one after the other, so the echo
+ * of one sensor is not taken by the next one.
+ */
+typedef struct{
+	uint8 trigger_port; /* Trigger pin in ULTRASONIC_TRIGGER_SOFTWARE mode */
+	uint8 trigger_pin;
+	uint8 echo_select;  /* Multiplexer channel of the echo (and of the trigger in ULTRASONIC_TRIGGER_HARDWARE mode) */
+	uint8 priority;     /* Share of the pings given to this sensor, 0 disables it */
+}Ultrasonic_SensorConfigType;
+
+typedef enum{
+	ULTRASONIC_IDLE, ULTRASONIC_BUSY, ULTRASONIC_READY
+}Ultrasonic_StateType;
+
+typedef enum{
+	ULTRASONIC_OK, ULTRASONIC_NO_TARGET
+}Ultrasonic_StatusType;
+
+typedef struct{
+	uint16 distance; /* Measured distance in ULTRASONIC_DISTANCE_UNIT */
+	uint32 ticks;    /* Width of the echo pulse in ICU ticks */
+	uint32 timestamp; /* Free running ICU time of the rising edge of the echo */
+	uint8 sequence;  /* Sequence number of the ping that produced this result, counted per sensor */
+	uint8 sensor;    /* Index of the sensor in the configuration array */
+	ICU_Prescaler prescaler; /* ICU clock the ticks and the timestamp are counted at */
+	Ultrasonic_StatusType status; /* ULTRASONIC_NO_TARGET if the echo did not arrive in time */
+}Ultrasonic_ResultType;
 
 /*******************************************************************************
  *                         	Function Prototypes                                *
  *******************************************************************************/
 /*
  * Description:
- * This is the call back function called by the ICU driver.
+ * Process the edges queued by the ICU driver, it is called by the driver API and can be called by the application.
+ * In ULTRASONIC_TRIGGER_HARDWARE mode it is called from the ICU interrupts only.
  * This is used to calculate the high time (pulse time) generated by the ultrasonic sensor.
  */
  void Ultrasonic_edgeProcessing(void);
@@ -37,22 +351,117 @@
 /*
  * Description:
  * Initialize the ICU driver as required.
- * Setup the ICU call back function.
- * Setup the direction for the trigger pin as output pin through the GPIO driver.
+ * Setup the direction for the trigger pins and the multiplexer select pins as output pins through the GPIO driver.
+ * Config_Ptr points to an array of ULTRASONIC_SENSOR_COUNT sensors, it must stay valid while the driver is used.
+ * With ULTRASONIC_TELEMETRY the UART driver is initialized at ULTRASONIC_TELEMETRY_BAUD for the frames of the results.
  */
-void Ultrasonic_init(void);
+void Ultrasonic_init(const Ultrasonic_SensorConfigType * Config_Ptr);
 
 /*
  * Description:
- * Send the Trigger pulse to the ultrasonic.
+ * Send the Trigger pulse to the sensor selected for the current ping.
+ * In ULTRASONIC_TRIGGER_HARDWARE mode the pulse is generated by Timer1 and this function does not wait for it.
  */
 void Ultrasonic_Trigger(void);
 
 /*
  * Description:
- * Send the trigger pulse by using Ultrasonic_Trigger function.
- * Start the measurements by the ICU from this moment.
+ * Send the trigger pulse to the required sensor and wait for the echo of this ping.
+ * If the periodic pinging is running, wait for the next result of this sensor instead.
+ * Return the distance measured by this ping in ULTRASONIC_DISTANCE_UNIT,
+ * or 0 if the periodic pinging does not ping this sensor (priority 0) or stops before it does.
+ */
+uint16 Ultrasonic_readDistance(uint8 sensor);
+
+/*
+ * Description:
+ * Start a new measurement of the next sensor chosen by the scheduler without waiting for its echo.
+ * The sensors are pinged in a weighted round robin by their priority, skipping the neighbour of the last pinged sensor.
+ * Each measurement gets the next sequence number of its sensor which is reported back with its result.
+ * Return FALSE if the previous measurement is still waiting for its echo or the periodic pinging is running.
+ */
+boolean Ultrasonic_startMeasurement(void);
+
+/*
+ * Description:
+ * Start a new measurement of the required sensor without waiting for its echo.
+ * Return FALSE if the previous measurement is still waiting for its echo, the periodic pinging is running
+ * or the sensor does not exist.
+ */
+boolean Ultrasonic_startSensorMeasurement(uint8 sensor);
+
+/*
+ * Description:
+ * Return TRUE if a completed measurement of any sensor is not read yet.
+ */
+boolean Ultrasonic_isReady(void);
+
+/*
+ * Description:
+ * Copy the oldest unread result among the sensors into Result_Ptr and mark it as read,
+ * the sensors are visited in turn so a fast sensor does not hide the others.
+ * Return FALSE if there is no new completed measurement.
+ */
+boolean Ultrasonic_getResult(Ultrasonic_ResultType * Result_Ptr);
+
+/*
+ * Description:
+ * Copy the result of the last completed measurement of the required sensor into Result_Ptr and mark it as read.
+ * Return FALSE if there is no new completed measurement of this sensor.
+ */
+boolean Ultrasonic_getSensorResult(uint8 sensor, Ultrasonic_ResultType * Result_Ptr);
+
+#if (ULTRASONIC_TRIGGER_MODE == ULTRASONIC_TRIGGER_HARDWARE)
+/*
+ * Description:
+ * Start pinging the sensors as configured by ULTRASONIC_SCHEDULE, one sensor per ping in the order of the scheduler.
+ * The trigger pulse is generated by Timer1
+ * and every echo is measured in the ICU interrupts. The results are read by Ultrasonic_getResult or Ultrasonic_getSnapshot.
+ */
+void Ultrasonic_startPeriodic(void);
+
+/*
+ * Description:
+ * Stop the periodic pinging after the current ping.
+ */
+void Ultrasonic_stopPeriodic(void);
+
+/*
+ * Description:
+ * Set the period of the periodic pinging in micro seconds.
+ * Periods shorter than the longest echo are extended to it.
+ */
+void Ultrasonic_setPingPeriod(uint32 period_us);
+
+/*
+ * Description:
+ * Set the time in micro seconds the echoes need to decay before the next ping in ULTRASONIC_SCHEDULE_ADAPTIVE.
+ */
+void Ultrasonic_setEchoGuard(uint32 guard_us);
+#endif
+
+/*
+ * Description:
+ * Return the number of completed measurements per second, updated every ULTRASONIC_RATE_WINDOW_TICKS.
+ */
+uint16 Ultrasonic_getSampleRate(void);
+
+/*
+ * Description:
+ * Copy the last completed measurement of the required sensor into Result_Ptr without releasing the driver.
+ * It never disables interrupts, so it can be called at any time and from any context.
+ * Return FALSE if the record was being written during ULTRASONIC_SNAPSHOT_RETRIES tries,
+ * which only happens when it is called from an interrupt that stopped the writer.
+ */
+boolean Ultrasonic_getSnapshot(uint8 sensor, Ultrasonic_ResultType * Result_Ptr);
+
+/*
+ * Description:
+ * Set the function that will be called when a measurement is completed.
+ * The call back function is called from Ultrasonic_edgeProcessing: in ULTRASONIC_TRIGGER_SOFTWARE mode from the
+ * driver API in the application context, in ULTRASONIC_TRIGGER_HARDWARE mode from the ICU interrupts,
+ * so there it must be short and use only data that is safe to share with an interrupt.
  */
-uint16 Ultrasonic_readDistance(void);
+void Ultrasonic_setCallBack(void(*a_ptr)(const Ultrasonic_ResultType * Result_Ptr));
 
 #endif /* ULTRASONIC_H_ */